@@ -7,6 +7,7 @@ public class GameWindow : ModuleRules
 	public GameWindow(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+		CppStandard = CppStandardVersion.Cpp20; // The bots are coroutines
 		
 		PublicIncludePaths.AddRange(
 			new string[] {
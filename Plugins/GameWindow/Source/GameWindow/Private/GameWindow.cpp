@@ -3,7 +3,12 @@
 #include "GameWindow.h"
 #include "GameWindowStyle.h"
 #include "GameWindowCommands.h"
+#include "MineSweeperSweep.h"
+#include "MineSweeperServer.h"
+#include "MineSweeperBot.h"
+#include "MineSweeperNativeGenerator.h"
 #include "LevelEditor.h"
+#include "Misc/MessageDialog.h"
 #include "Widgets/Docking/SDockTab.h"
 #include "Widgets/Layout/SBox.h"
 #include "Widgets/Text/STextBlock.h"
@@ -18,6 +23,10 @@ void FGameWindowModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
 	
+	// Sweep workers are this same binary started with -MineSweeperShard, and they exit once their shard is done
+	MineSweeperSweepRunner::RunWorkerIfRequested();
+	MineSweeperServer::StartIfRequested();
+
 	FGameWindowStyle::Initialize();
 	FGameWindowStyle::ReloadTextures();
 
@@ -47,7 +56,14 @@ void FGameWindowModule::ShutdownModule()
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
 	
-	Board->StopGameTimer();
+	if (Board.IsValid())
+	{
+		Board->StopGameTimer();
+	}
+	StopPerfPanel();
+	MineSweeperSweepRunner::ShutdownActiveSweep();
+	MineSweeperServer::StopRunning();
+	MineSweeperBotScheduler::StopAll();
 	UToolMenus::UnRegisterStartupCallback(this);
 
 	UToolMenus::UnregisterOwner(this);
@@ -66,7 +82,14 @@ void FGameWindowModule::PreUnloadCallback()
 TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& SpawnTabArgs)
 {
 
+	StopPerfPanel(); // It was reading the board this tab is about to replace
 	Board = MakeShared<MineSweeperBoard>();
+	if (!BoardPool.IsValid())
+	{
+		BoardPool = MakeShared<MineSweeperBoardPool, ESPMode::ThreadSafe>();
+	}
+	// Start generating for the default settings while the player is still reading the tab
+	BoardPool->SetSettings(MineSweeperBoardSettings());
 
 	TSharedRef <SEditableTextBox> WidthText = SNew(SEditableTextBox)
 		.Text(FText::FromString(TEXT("5")))
@@ -167,6 +190,18 @@ TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& Sp
 		.ColorAndOpacity(FLinearColor::White)
 		.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12));
 	Board->GameTimeText = GameTime;
+	TSharedRef<SButton> PauseButton = SNew(SButton)
+		.HAlign(HAlign_Center)
+		.VAlign(VAlign_Center)
+		.OnClicked_Lambda([this]() -> FReply
+			{
+				Board->SetPaused(!Board->IsPaused());
+				return FReply::Handled();
+			})
+		[
+			SNew(STextBlock)
+			.Text_Lambda([this]() { return FText::FromString(Board->IsPaused() ? TEXT("Resume") : TEXT("Pause")); })
+		];
 	TSharedRef<SHorizontalBox> Line2 = SNew(SHorizontalBox)
 		+ SHorizontalBox::Slot()
 		.FillWidth(1.0f)
@@ -179,6 +214,12 @@ TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& Sp
 		.HAlign(HAlign_Center)
 		[
 			GameTime
+		]
+		+ SHorizontalBox::Slot()
+		.AutoWidth()
+		.HAlign(HAlign_Right)
+		[
+			PauseButton
 		];
 	TSharedRef <SEditableTextBox> SeedText = SNew(SEditableTextBox)
 		.Text(FText::FromString(TEXT("0")))
@@ -243,20 +284,229 @@ TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& Sp
 			SeedBox
 		]
 		;
+	// One box per shape, which behave like radio buttons: ticking one picks it, and the ticked one can't be unticked
+	TSharedRef<SHorizontalBox> ShapeBox = SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.AutoWidth()
+		.VAlign(VAlign_Center)
+		.Padding(0.0f, 0.0f, 10.0f, 0.0f)
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("Shape:")))
+		];
+	const TPair<EMineSweeperTopology, const TCHAR*> Shapes[] = {
+		{ EMineSweeperTopology::Square, TEXT("Square") },
+		{ EMineSweeperTopology::Hex, TEXT("Hex") },
+		{ EMineSweeperTopology::Triangle, TEXT("Triangle") },
+		{ EMineSweeperTopology::Cube, TEXT("Cube") },
+	};
+	for (const TPair<EMineSweeperTopology, const TCHAR*>& Shape : Shapes)
+	{
+		ShapeBox->AddSlot()
+			.AutoWidth()
+			.Padding(0.0f, 0.0f, 10.0f, 0.0f)
+			[
+				SNew(SCheckBox)
+				.IsChecked_Lambda([this, Shape = Shape.Key]() { return Topology == Shape ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+				.OnCheckStateChanged_Lambda([this, Shape = Shape.Key](ECheckBoxState) -> void
+					{
+						Topology = Shape;
+					})
+				[
+					SNew(STextBlock)
+					.Text(FText::FromString(Shape.Value))
+					.ColorAndOpacity(FLinearColor::White)
+					.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+				]
+			];
+	}
+	TSharedRef<SEditableTextBox> DepthText = SNew(SEditableTextBox)
+		.Text(FText::AsNumber(Depth))
+		.HintText(FText::AsNumber(Depth))
+		.IsEnabled_Lambda([this]() { return Topology == EMineSweeperTopology::Cube; })
+		.MinDesiredWidth(60.0f);
+	TSharedRef<SHorizontalBox> LineShape = SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.HAlign(HAlign_Left)
+		[
+			ShapeBox
+		]
+		+ SHorizontalBox::Slot()
+		.HAlign(HAlign_Center)
+		[
+			MakeTextEntry(FText::FromString(TEXT("Layers:")), DepthText)
+		];
+	TSharedRef<SCheckBox> SafeFirstClick = SNew(SCheckBox)
+		.IsChecked_Lambda([this]() { return FirstClickSafety != EFirstClickSafety::None ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+		.OnCheckStateChanged_Lambda([this](ECheckBoxState NewState) -> void
+			{
+				FirstClickSafety = NewState == ECheckBoxState::Checked ? EFirstClickSafety::SafeTile : EFirstClickSafety::None;
+				Board->FirstClickSafety = FirstClickSafety;
+			})
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("Safe First Click")))
+			.ColorAndOpacity(FLinearColor::White)
+			.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+		];
+	TSharedRef<SCheckBox> OpenFirstClick = SNew(SCheckBox)
+		.IsChecked_Lambda([this]() { return FirstClickSafety == EFirstClickSafety::Opening ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+		.OnCheckStateChanged_Lambda([this](ECheckBoxState NewState) -> void
+			{
+				// An opening is only possible if the first click is safe, so this turns that on too
+				FirstClickSafety = NewState == ECheckBoxState::Checked ? EFirstClickSafety::Opening : EFirstClickSafety::SafeTile;
+				Board->FirstClickSafety = FirstClickSafety;
+			})
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("First Click Opens An Area")))
+			.ColorAndOpacity(FLinearColor::White)
+			.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+		];
+	Board->FirstClickSafety = FirstClickSafety;
+	TSharedRef<SHorizontalBox> Line4 = SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.HAlign(HAlign_Left)
+		[
+			SafeFirstClick
+		]
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.HAlign(HAlign_Left)
+		[
+			OpenFirstClick
+		];
+	TSharedRef<SCheckBox> AutoFlag = SNew(SCheckBox)
+		.IsChecked_Lambda([this]() { return Board->bAutoFlag ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+		.OnCheckStateChanged_Lambda([this](ECheckBoxState NewState) -> void
+			{
+				Board->bAutoFlag = NewState == ECheckBoxState::Checked;
+			})
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("Auto Flag")))
+			.ColorAndOpacity(FLinearColor::White)
+			.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+		];
+	TSharedRef<SCheckBox> AutoReveal = SNew(SCheckBox)
+		.IsChecked_Lambda([this]() { return Board->bAutoReveal ? ECheckBoxState::Checked : ECheckBoxState::Unchecked; })
+		.OnCheckStateChanged_Lambda([this](ECheckBoxState NewState) -> void
+			{
+				Board->bAutoReveal = NewState == ECheckBoxState::Checked;
+			})
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("Auto Reveal")))
+			.ColorAndOpacity(FLinearColor::White)
+			.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+		];
+	TSharedRef<SHorizontalBox> Line5 = SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.HAlign(HAlign_Left)
+		[
+			AutoFlag
+		]
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.HAlign(HAlign_Left)
+		[
+			AutoReveal
+		];
 	TSharedRef<SButton> GenerateBoard = SNew(SButton)
 		.Text(FText::FromString(TEXT("Generate New Grid")))
 		.HAlign(HAlign_Center)
 		.VAlign(VAlign_Center)
 		.OnClicked_Lambda([=, this]() -> FReply
 			{
+				const auto ReportRefused = [](const MineSweeperBoardSettings& Refused)
+					{
+						const MineSweeperDimensions Dims = Refused.GetDimensions();
+						const SIZE_T Needed = MineSweeperBoard::EstimateMemory(Refused.Topology, Dims, false).GetTotal();
+						FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(FString::Printf(
+							TEXT("A %dx%dx%d board needs at least %.1f MB, which is more than MineSweeper.Memory.BudgetMB allows."),
+							Dims.Width, Dims.Height, Dims.Depth, Needed / (1024.0 * 1024.0))));
+					};
 				Seed = ToIntValue(SeedText->GetText(), 0);
-				Board->RefreshBoard(ToIntValue(WidthText.Get().GetText(), 5)
-					, ToIntValue(HeightText.Get().GetText(), 5)
-					, ToIntValue(MineText.Get().GetText(), 5)
-					, MakeShared<RandomBoardGenerator>(bUseSeed, Seed));
+				// A seeded game should move first click mines to the same places every time too
+				const int32 FirstClickSeed = bUseSeed ? Seed : FMath::Rand();
+				MineSweeperBoardSettings Settings;
+				Settings.Width = ToIntValue(WidthText.Get().GetText(), 5);
+				Settings.Height = ToIntValue(HeightText.Get().GetText(), 5);
+				Settings.NumMines = ToIntValue(MineText.Get().GetText(), 5);
+				Depth = FMath::Max(1, ToIntValue(DepthText->GetText(), Depth));
+				Settings.Topology = Topology;
+				Settings.Depth = Depth;
+				Settings.bUseSeed = bUseSeed;
+				Settings.Seed = Seed;
+				// A generator library, if one's configured, replaces the built in generator, for the pool as well
+				TSharedPtr<NativeBoardGenerator> NativeGenerator = NativeBoardGenerator::GetConfigured();
+				if (NativeGenerator.IsValid())
+				{
+					NativeGenerator->SetSeed(bUseSeed, Seed);
+					Settings.GeneratorLibrary = NativeGenerator->GetLibraryPath();
+				}
+				// The pool usually has one ready, we only generate here when the settings have just changed
+				if (TSharedPtr<MineSweeperGrid> ReadyGrid = BoardPool->Pop(Settings))
+				{
+					if (!Board->RefreshBoard(ReadyGrid.ToSharedRef(), FirstClickSeed))
+					{
+						ReportRefused(Settings);
+					}
+					return FReply::Handled();
+				}
+				TSharedPtr<GenerateBoard> Generator = NativeGenerator;
+				if (!Generator.IsValid())
+				{
+					Generator = MakeShared<RandomBoardGenerator>(bUseSeed, Seed);
+				}
+				const bool bRefreshed = Board->RefreshBoard(Settings.Topology
+					, Settings.GetDimensions()
+					, Settings.NumMines
+					, Generator
+					, FirstClickSeed);
 				//, MakeShared<EmptyBoardGenerator>()); // For testing purposes, you can use EmptyBoardGenerator to generate a board without mines
+				if (!bRefreshed)
+				{
+					ReportRefused(Settings);
+				}
+				return FReply::Handled();
+			});
+	TSharedRef<SButton> HintButton = SNew(SButton)
+		.Text(FText::FromString(TEXT("Hint")))
+		.HAlign(HAlign_Center)
+		.VAlign(VAlign_Center)
+		.OnClicked_Lambda([this]() -> FReply
+			{
+				Board->RequestHint();
 				return FReply::Handled();
 			});
+	TSharedRef<STextBlock> PerfText = SNew(STextBlock)
+		.Visibility(EVisibility::Collapsed)
+		.ColorAndOpacity(FLinearColor::White)
+		.Font(FCoreStyle::GetDefaultFontStyle("Mono", 10));
+	TSharedRef<SCheckBox> ShowPerf = SNew(SCheckBox)
+		.IsChecked(ECheckBoxState::Unchecked)
+		.OnCheckStateChanged_Lambda([this, PerfText](ECheckBoxState NewState) -> void
+			{
+				if (NewState == ECheckBoxState::Checked)
+				{
+					StartPerfPanel(PerfText);
+				}
+				else
+				{
+					StopPerfPanel();
+				}
+				PerfText->SetVisibility(NewState == ECheckBoxState::Checked ? EVisibility::Visible : EVisibility::Collapsed);
+			})
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString(TEXT("Show Performance")))
+			.ColorAndOpacity(FLinearColor::White)
+			.Font(FCoreStyle::GetDefaultFontStyle("Regular", 12))
+		];
 	TSharedRef<SVerticalBox> MainPanel = SNew(SVerticalBox)
 		+ SVerticalBox::Slot()
 		.AutoHeight()
@@ -287,6 +537,30 @@ TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& Sp
 		.HAlign(HAlign_Left)
 		.VAlign(VAlign_Top)
 		.Padding(10.0f)
+		[
+			LineShape
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
+		[
+			Line4
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
+		[
+			Line5
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
 		[
 			GenerateBoard
 		]
@@ -295,12 +569,42 @@ TSharedRef<SDockTab> FGameWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& Sp
 		.HAlign(HAlign_Left)
 		.VAlign(VAlign_Top)
 		.Padding(10.0f)
+		[
+			HintButton
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
+		[
+			ShowPerf
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
+		[
+			PerfText
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Left)
+		.VAlign(VAlign_Top)
+		.Padding(10.0f)
 		[
 			Board->GetVerticalBox()
 		]
 		;
 	return SNew(SDockTab)
 		.TabRole(ETabRole::NomadTab)
+		.OnTabClosed_Lambda([this, Board = Board](TSharedRef<SDockTab>)
+			{
+				// Nothing to count once the window's gone, and this takes the board's clock off the shared ticker
+				Board->StopGameTimer();
+				StopPerfPanel();
+			})
 		[
 			SNew(SScrollBox)
 				+ SScrollBox::Slot()
@@ -335,6 +639,78 @@ TSharedRef<class SHorizontalBox> FGameWindowModule::MakeTextEntry(FText Label, T
 	return HBox;
 }
 
+void FGameWindowModule::StartPerfPanel(TSharedRef<STextBlock> PerfText)
+{
+	StopPerfPanel();
+	PerfText->SetText(GetPerfText());
+	// Four times a second is plenty for a person to read, and setting the text every frame would put the panel in its own numbers
+	PerfPanelTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda(
+		[this, WeakText = TWeakPtr<STextBlock>(PerfText)](float) -> bool
+		{
+			TSharedPtr<STextBlock> Text = WeakText.Pin();
+			if (!Text.IsValid())
+			{
+				PerfPanelTicker.Reset();
+				return false;
+			}
+			Text->SetText(GetPerfText());
+			return true;
+		}), 0.25f);
+}
+
+void FGameWindowModule::StopPerfPanel()
+{
+	if (PerfPanelTicker.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(PerfPanelTicker);
+		PerfPanelTicker.Reset();
+	}
+}
+
+FText FGameWindowModule::GetPerfText() const
+{
+	if (!Board.IsValid())
+	{
+		return FText::GetEmpty();
+	}
+	const MineSweeperPerfCounters& Perf = Board->GetPerf();
+	auto ToMB = [](SIZE_T Bytes) { return double(Bytes) / (1024.0 * 1024.0); };
+	auto PhaseMs = [&Perf](EMineSweeperGenerationPhase Phase) { return Perf.GetGenerationMs(Phase); };
+
+	FString Text;
+	const MineSweeperPerfMove LastMove = Perf.GetLastMove();
+	if (Perf.GetNumMoves() > 0)
+	{
+		const TCHAR* Kind = LastMove.Kind == MineSweeperPerfMove::EKind::Flag ? TEXT("Flag")
+			: LastMove.Kind == MineSweeperPerfMove::EKind::Chord ? TEXT("Chord") : TEXT("Reveal");
+		Text += FString::Printf(TEXT("Last move:     %s tile %d, %d tiles, %.1f us to apply, %d widgets\n"),
+			Kind, LastMove.Tile, LastMove.Cascade, LastMove.RevealUs, LastMove.Widgets);
+	}
+	else
+	{
+		Text += TEXT("Last move:     none yet\n");
+	}
+	Text += FString::Printf(TEXT("Input->paint:  p50 %.2f ms, p99 %.2f ms over %d paints\n"),
+		Perf.GetPaintPercentileMs(0.5), Perf.GetPaintPercentileMs(0.99), Perf.GetNumPaints());
+	if (PhaseMs(EMineSweeperGenerationPhase::Mines) == 0.0 && PhaseMs(EMineSweeperGenerationPhase::Counts) == 0.0)
+	{
+		// Pooled boards got their mines and counts on a worker before anyone asked for them
+		Text += FString::Printf(TEXT("Generation:    pre-generated, caches %.2f ms, widgets %.2f ms\n"),
+			PhaseMs(EMineSweeperGenerationPhase::Caches), PhaseMs(EMineSweeperGenerationPhase::Widgets));
+	}
+	else
+	{
+		Text += FString::Printf(TEXT("Generation:    mines %.2f ms, counts %.2f ms, caches %.2f ms, widgets %.2f ms\n"),
+			PhaseMs(EMineSweeperGenerationPhase::Mines), PhaseMs(EMineSweeperGenerationPhase::Counts),
+			PhaseMs(EMineSweeperGenerationPhase::Caches), PhaseMs(EMineSweeperGenerationPhase::Widgets));
+	}
+	const MineSweeperMemoryReport Report = Board->GetMemoryReport();
+	Text += FString::Printf(TEXT("Memory:        %.2f MB (state %.2f, widgets %.2f, keys %.2f, caches %.2f)\n"),
+		ToMB(Report.GetTotal()), ToMB(Report.StateBytes), ToMB(Report.WidgetBytes), ToMB(Report.KeyBytes), ToMB(Report.CacheBytes));
+	Text += FString::Printf(TEXT("Widgets:       %d updated last frame"), Perf.GetWidgetsLastFrame());
+	return FText::FromString(Text);
+}
+
 void FGameWindowModule::PluginButtonClicked()
 {
 	FGlobalTabmanager::Get()->TryInvokeTab(GameWindowTabName);
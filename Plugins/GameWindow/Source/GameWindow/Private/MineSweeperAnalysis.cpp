@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperAnalysis.h"
+
+MineSweeperHint MineSweeperAnalysis::FindHint(const MineSweeperSnapshot& Snapshot)
+{
+	MineSweeperHint Hint;
+	Hint.Version = Snapshot.GetVersion();
+	Hint.GameId = Snapshot.GetGameId();
+	for (int32 Tile = 0; Tile < Snapshot.Num(); Tile++)
+	{
+		if ((Tile & 1023) == 0 && Snapshot.IsStale())
+		{
+			return Hint;
+		}
+		const int32 Mines = Snapshot.GetAdjacentMines(Tile);
+		if (Mines <= 0)
+		{
+			continue; // Hidden, or a zero that has already opened everything around it
+		}
+		int32 Flags = 0;
+		int32 Unknown = 0;
+		int32 FirstUnknown = INDEX_NONE;
+		Snapshot.ForEachNeighbor(Tile, [&Snapshot, &Flags, &Unknown, &FirstUnknown](int32 Neighbor)
+			{
+				if (Snapshot.IsFlagged(Neighbor))
+				{
+					Flags++;
+				}
+				else if (!Snapshot.IsRevealed(Neighbor))
+				{
+					Unknown++;
+					FirstUnknown = FirstUnknown == INDEX_NONE ? Neighbor : FirstUnknown;
+				}
+			});
+		if (Unknown > 0 && (Flags == Mines || Mines - Flags == Unknown))
+		{
+			Hint.Tile = FirstUnknown;
+			Hint.FromTile = Tile;
+			Hint.bIsMine = Flags != Mines;
+			return Hint;
+		}
+	}
+	return Hint;
+}
@@ -0,0 +1,418 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MineSweeperBoard.h"
+#include "MineSweeperGrid.h"
+#include "MineSweeperBitboard.h"
+#include "MineSweeperNativeGenerator.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+#include <atomic>
+
+/**
+* Console commands for timing the board code from inside the editor. Run them from the Output Log, e.g.
+* "MineSweeper.Benchmark.Grids 10000" and the results are written to MineSweeperLog.
+*/
+namespace MineSweeperBenchmarks
+{
+	/**
+	* Generates a board, counts the adjacency and then clicks every tile, which is the whole life of a game minus the widgets.
+	*/
+	static double TimeGrid(MineSweeperGrid& Grid, const TArray<std::vector<std::vector<bool>>>& Boards, int32 Iterations)
+	{
+		std::vector<int32> Revealed;
+		Revealed.reserve(Grid.Num());
+		int64 Checksum = 0;
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Grid.SetMines(Boards[Iteration % Boards.Num()]);
+			for (int32 Tile = 0; Tile < Grid.Num(); Tile++)
+			{
+				if (!Grid.IsMine(Tile))
+				{
+					Revealed.clear();
+					Checksum += Grid.Reveal(Tile, Revealed);
+				}
+			}
+		}
+		const double Elapsed = FPlatformTime::Seconds() - Start;
+		// Logged so the optimizer can't throw the whole loop away
+		UE_LOG(MineSweeperLog, Verbose, TEXT("Checksum %lld"), Checksum);
+		return Elapsed;
+	}
+
+	static void BenchmarkPreset(const TCHAR* Name, int32 Width, int32 Height, int32 NumMines, int32 Iterations)
+	{
+		TArray<std::vector<std::vector<bool>>> Boards;
+		for (int32 Seed = 0; Seed < 64; Seed++)
+		{
+			RandomBoardGenerator Generator(true, Seed);
+			Boards.Add(Generator.Generate(Width, Height, NumMines));
+		}
+
+		TSharedRef<MineSweeperGrid> Fixed = MakeMineSweeperGrid(Width, Height);
+		DynamicMineSweeperGrid Dynamic(Width, Height);
+		const double FixedTime = TimeGrid(*Fixed, Boards, Iterations);
+		const double DynamicTime = TimeGrid(Dynamic, Boards, Iterations);
+		UE_LOG(MineSweeperLog, Log, TEXT("%s (%dx%d, %d mines): fixed %.3f us/game, dynamic %.3f us/game, %.2fx"),
+			Name, Width, Height, NumMines,
+			FixedTime * 1e6 / Iterations, DynamicTime * 1e6 / Iterations, DynamicTime / FMath::Max(FixedTime, 1e-9));
+	}
+
+	static FAutoConsoleCommand BenchmarkGridsCommand(
+		TEXT("MineSweeper.Benchmark.Grids"),
+		TEXT("Times the compile time preset boards against the dynamic board. Optional argument: number of games."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+				BenchmarkPreset(TEXT("Beginner"), 9, 9, 10, Iterations);
+				BenchmarkPreset(TEXT("Intermediate"), 16, 16, 40, Iterations);
+				BenchmarkPreset(TEXT("Expert"), 30, 16, 99, Iterations);
+			}));
+
+	/**
+	* Checks the bitboard against the scalar grid tile for tile (counts, then the revealed set after a batch of clicks)
+	* and times both. The first click is always on a zero so there's at least one big opening to flood.
+	*/
+	static void BenchmarkBitboard(int32 Size, int32 MinePercent)
+	{
+		const int32 NumTiles = Size * Size;
+		RandomBoardGenerator Generator(true, Size);
+		const std::vector<bool> Tiles = Generator.GenerateTiles(NumTiles, NumTiles * MinePercent / 100);
+
+		DynamicMineSweeperGrid Scalar(Size, Size);
+		MineSweeperBitboard Bitboard(Size, Size);
+		double Start = FPlatformTime::Seconds();
+		Scalar.SetMines(Tiles);
+		const double ScalarCountTime = FPlatformTime::Seconds() - Start;
+		Start = FPlatformTime::Seconds();
+		Bitboard.SetMines(Tiles);
+		const double BitboardCountTime = FPlatformTime::Seconds() - Start;
+
+		for (int32 Tile = 0; Tile < NumTiles; Tile++)
+		{
+			if (Scalar.GetAdjacentMines(Tile) != Bitboard.GetAdjacentMines(Tile))
+			{
+				UE_LOG(MineSweeperLog, Error, TEXT("Bitboard count mismatch at tile %d: %d vs %d"), Tile, Bitboard.GetAdjacentMines(Tile), Scalar.GetAdjacentMines(Tile));
+				return;
+			}
+		}
+
+		TArray<int32> Clicks;
+		FRandomStream Stream(Size);
+		for (int32 Tile = 0; Tile < NumTiles && Clicks.Num() == 0; Tile++)
+		{
+			if (!Tiles[Tile] && Scalar.GetAdjacentMines(Tile) == 0)
+			{
+				Clicks.Add(Tile);
+			}
+		}
+		while (Clicks.Num() < 1000)
+		{
+			const int32 Tile = Stream.RandRange(0, NumTiles - 1);
+			if (!Tiles[Tile])
+			{
+				Clicks.Add(Tile);
+			}
+		}
+
+		std::vector<int32> Revealed;
+		Revealed.reserve(NumTiles);
+		double ScalarRevealTime = 0.0, BitboardRevealTime = 0.0, FirstOpeningTime = 0.0;
+		for (int32 Click : Clicks)
+		{
+			Revealed.clear();
+			Start = FPlatformTime::Seconds();
+			const int32 ScalarChanged = Scalar.Reveal(Click, Revealed);
+			ScalarRevealTime += FPlatformTime::Seconds() - Start;
+			Start = FPlatformTime::Seconds();
+			const int32 BitboardChanged = Bitboard.Reveal(Click);
+			const double Elapsed = FPlatformTime::Seconds() - Start;
+			BitboardRevealTime += Elapsed;
+			FirstOpeningTime = FirstOpeningTime == 0.0 ? Elapsed : FirstOpeningTime;
+			if (ScalarChanged != BitboardChanged)
+			{
+				UE_LOG(MineSweeperLog, Error, TEXT("Bitboard reveal mismatch at tile %d: %d vs %d tiles"), Click, BitboardChanged, ScalarChanged);
+				return;
+			}
+		}
+		for (int32 Tile = 0; Tile < NumTiles; Tile++)
+		{
+			if (Scalar.IsRevealed(Tile) != Bitboard.IsRevealed(Tile))
+			{
+				UE_LOG(MineSweeperLog, Error, TEXT("Bitboard revealed mismatch at tile %d"), Tile);
+				return;
+			}
+		}
+
+		UE_LOG(MineSweeperLog, Log, TEXT("Bitboard (%s) %dx%d, %d%% mines: matches scalar. Counts %.1f us vs %.1f us, first opening %.1f us, %d reveals %.1f us vs %.1f us"),
+			Bitboard.GetSimdName(), Size, Size, MinePercent,
+			BitboardCountTime * 1e6, ScalarCountTime * 1e6, FirstOpeningTime * 1e6,
+			Clicks.Num(), BitboardRevealTime * 1e6, ScalarRevealTime * 1e6);
+	}
+
+	static FAutoConsoleCommand BenchmarkBitboardCommand(
+		TEXT("MineSweeper.Benchmark.Bitboard"),
+		TEXT("Validates the bitboard engine against the scalar grid and times both. Optional arguments: board size (default 1000), mine percentage (default 1)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				const int32 Size = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+				const int32 MinePercent = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 0, 90) : 1;
+				BenchmarkBitboard(Size, MinePercent);
+			}));
+
+	/**
+	* Sits in front of GMalloc and counts what the game thread allocates while the interaction benchmark runs.
+	* Everything is passed straight through, and it's only counting between Begin and End.
+	*
+	* Other threads read GMalloc without any synchronisation, so once one is installed it's never taken out or freed:
+	* a thread that picked up the pointer just before the benchmark finished can still call through it safely.
+	*/
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+
+		void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Counted();
+			return Inner->Malloc(Count, Alignment);
+		}
+		void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Counted();
+			return Inner->TryMalloc(Count, Alignment);
+		}
+		void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			Counted();
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+		void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			Counted();
+			return Inner->TryRealloc(Original, Count, Alignment);
+		}
+		void Free(void* Original) override { Inner->Free(Original); }
+		bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		void UpdateStats() override { Inner->UpdateStats(); }
+		void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		const TCHAR* GetDescriptiveName() override { return TEXT("MineSweeperCountingMalloc"); }
+
+		/** Installs the proxy the first time it's asked for, and hands back the same one every time after */
+		static FCountingMalloc& Get()
+		{
+			check(IsInGameThread());
+			static FCountingMalloc* Installed = nullptr;
+			if (Installed == nullptr)
+			{
+				Installed = new FCountingMalloc(GMalloc);
+				GMalloc = Installed;
+			}
+			return *Installed;
+		}
+
+		void Begin() { bCounting.store(true, std::memory_order_relaxed); }
+		void End() { bCounting.store(false, std::memory_order_relaxed); }
+		int64 GetCount() const { return Count.load(std::memory_order_relaxed); }
+
+	private:
+		void Counted()
+		{
+			// Worker threads keep allocating while we measure, only the game thread is the interaction path
+			if (bCounting.load(std::memory_order_relaxed) && IsInGameThread())
+			{
+				Count.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		FMalloc* Inner;
+		std::atomic<int64> Count{ 0 };
+		std::atomic<bool> bCounting{ false };
+	};
+
+	/**
+	* Builds a real board (widgets and all, just never put in a window) and drives it the same way the buttons do:
+	* presses and releases on hidden safe tiles, and flags going on and off. Every interaction is checked for heap
+	* allocations and timed from the input to the widgets being updated. The time to the next paint is only known with
+	* the board on screen, so that's logged by the board itself as it's played (MineSweeperBoard::GetInputLatency).
+	*/
+	static void BenchmarkInteraction(int32 Size, int32 NumInteractions)
+	{
+		TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> Board = MakeShared<MineSweeperBoard, ESPMode::ThreadSafe>();
+		Board->FirstClickSafety = EFirstClickSafety::Opening;
+		// Few enough mines that a couple of hundred clicks won't win the game and open a dialog in the middle of it
+		if (!Board->RefreshBoard(Size, Size, Size * Size / 5, MakeShared<RandomBoardGenerator>(true, Size), Size))
+		{
+			return;
+		}
+		Board->StopGameTimer();
+		TSharedPtr<const MineSweeperGrid> Grid = Board->GetGrid();
+
+		// Warm up with the first click, which is where first click safety moves mines around
+		const int32 First = Grid->ToTile(Size / 2, Size / 2);
+		Board->PressTile(First);
+		Board->ReleaseTile(First);
+
+		FRandomStream Stream(Size);
+		TArray<int32> Clicks;
+		TArray<int32> Flags;
+		for (int32 Attempt = 0; Attempt < Grid->Num() * 4 && (Clicks.Num() < NumInteractions || Flags.Num() < NumInteractions); Attempt++)
+		{
+			const int32 Tile = Stream.RandRange(0, Grid->Num() - 1);
+			if (!Grid->IsRevealed(Tile))
+			{
+				(Grid->IsMine(Tile) ? Flags : Clicks).Add(Tile);
+			}
+		}
+		Clicks.SetNum(FMath::Min(Clicks.Num(), NumInteractions));
+		Flags.SetNum(FMath::Min(Flags.Num(), NumInteractions));
+
+		FCountingMalloc& CountingMalloc = FCountingMalloc::Get();
+		int64 WorstAllocations = 0;
+		int32 NumWithAllocations = 0;
+		double TotalMs = 0.0, MaxMs = 0.0;
+		int32 NumTimed = 0;
+		const auto Measure = [&](TFunctionRef<void()> Interaction)
+			{
+				const int64 Before = CountingMalloc.GetCount();
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				Interaction();
+				const double Ms = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+				const int64 Allocations = CountingMalloc.GetCount() - Before;
+				WorstAllocations = FMath::Max(WorstAllocations, Allocations);
+				NumWithAllocations += Allocations > 0;
+				TotalMs += Ms;
+				MaxMs = FMath::Max(MaxMs, Ms);
+				NumTimed++;
+			};
+
+		CountingMalloc.Begin();
+		for (int32 Tile : Clicks)
+		{
+			if (Grid->IsRevealed(Tile))
+			{
+				continue; // An earlier opening got here first
+			}
+			Measure([&]() { Board->PressTile(Tile); });
+			Measure([&]() { Board->ReleaseTile(Tile); });
+		}
+		for (int32 Tile : Flags)
+		{
+			Measure([&]() { Board->ToggleFlag(Tile); });
+			Measure([&]() { Board->ToggleFlag(Tile); });
+		}
+		CountingMalloc.End();
+
+		UE_LOG(MineSweeperLog, Log, TEXT("Interaction %dx%d: %d interactions, input to widgets avg %.3f ms, max %.3f ms"),
+			Size, Size, NumTimed, TotalMs / FMath::Max(NumTimed, 1), MaxMs);
+		if (NumWithAllocations > 0)
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Interaction allocations: FAILED, %d of %d interactions allocated (worst %lld)"), NumWithAllocations, NumTimed, WorstAllocations);
+		}
+		else
+		{
+			UE_LOG(MineSweeperLog, Log, TEXT("Interaction allocations: passed, no interaction allocated"));
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkInteractionCommand(
+		TEXT("MineSweeper.Benchmark.Interaction"),
+		TEXT("Checks that pressing, releasing, revealing and flagging never allocate, and times them. Optional arguments: board size (default 100), interactions of each kind (default 200)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				const int32 Size = Args.Num() > 0 ? FMath::Max(16, FCString::Atoi(*Args[0])) : 100;
+				const int32 NumInteractions = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 200;
+				BenchmarkInteraction(Size, NumInteractions);
+			}));
+
+	/**
+	* Checks a generator library gives the right number of mines and the same board for the same seed, then times batch
+	* generation through the C ABI against the built in generator making the same number of expert boards.
+	*/
+	static void BenchmarkNativeGenerator(const FString& LibraryPath, int32 NumBoards, int32 BatchSize)
+	{
+		TSharedPtr<NativeBoardGenerator> Generator = NativeBoardGenerator::Load(LibraryPath);
+		if (!Generator.IsValid())
+		{
+			return;
+		}
+		constexpr int32 Width = 30;
+		constexpr int32 Height = 16;
+		constexpr int32 NumMines = 99;
+		const uint64 WordsPerBoard = NativeBoardGenerator::GetWordsPerBoard(Width, Height);
+		std::vector<uint64> Bits(WordsPerBoard * BatchSize);
+		std::vector<uint64> Again(WordsPerBoard * BatchSize);
+
+		int32 NumWrongCounts = 0;
+		int32 NumWritten = Generator->GenerateBatch(Width, Height, NumMines, 0, BatchSize, Bits.data(), Bits.size());
+		const int32 NumWrittenAgain = Generator->GenerateBatch(Width, Height, NumMines, 0, BatchSize, Again.data(), Again.size());
+		for (int32 Board = 0; Board < NumWritten; Board++)
+		{
+			int32 Count = 0;
+			for (uint64 Word = 0; Word < WordsPerBoard; Word++)
+			{
+				Count += FMath::CountBits(Bits[Board * WordsPerBoard + Word]);
+			}
+			NumWrongCounts += Count != NumMines;
+		}
+		const bool bDeterministic = NumWrittenAgain == NumWritten && Bits == Again;
+		const bool bTooSmallRejected = Generator->GenerateBatch(Width, Height, NumMines, 0, BatchSize, Bits.data(), Bits.size() - 1) < 0;
+		if (NumWritten != BatchSize || NumWrongCounts > 0 || !bDeterministic || !bTooSmallRejected)
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Generator %s: FAILED, wrote %d of %d boards, %d with the wrong mine count, %s, %s"),
+				*Generator->GetName(), NumWritten, BatchSize, NumWrongCounts,
+				bDeterministic ? TEXT("deterministic") : TEXT("not deterministic"), bTooSmallRejected ? TEXT("rejects short buffers") : TEXT("overruns short buffers"));
+			return;
+		}
+
+		int64 Checksum = 0;
+		double Start = FPlatformTime::Seconds();
+		for (int32 First = 0; First < NumBoards; First += BatchSize)
+		{
+			const int32 NumInBatch = FMath::Min(BatchSize, NumBoards - First);
+			NumWritten = Generator->GenerateBatch(Width, Height, NumMines, uint64(First), NumInBatch, Bits.data(), Bits.size());
+			Checksum += NumWritten + int64(Bits[0] & 0xFF);
+		}
+		const double NativeTime = FPlatformTime::Seconds() - Start;
+
+		// The built in generator is a lot slower, so it gets a smaller run and the rate is compared
+		const int32 NumBuiltIn = FMath::Min(NumBoards, 100000);
+		RandomBoardGenerator BuiltIn(true, 0);
+		Start = FPlatformTime::Seconds();
+		for (int32 Board = 0; Board < NumBuiltIn; Board++)
+		{
+			Checksum += BuiltIn.Generate(Width, Height, NumMines)[0][0];
+		}
+		const double BuiltInTime = FPlatformTime::Seconds() - Start;
+		UE_LOG(MineSweeperLog, Verbose, TEXT("Checksum %lld"), Checksum);
+
+		const double NativeRate = NumBoards / FMath::Max(NativeTime, 1e-9);
+		const double BuiltInRate = NumBuiltIn / FMath::Max(BuiltInTime, 1e-9);
+		UE_LOG(MineSweeperLog, Log, TEXT("Generator %s: passed. %d expert boards in batches of %d at %.0f boards/s (%.1f MB/s of bitsets), built in generator %.0f boards/s, %.1fx"),
+			*Generator->GetName(), NumBoards, BatchSize, NativeRate, NativeRate * WordsPerBoard * sizeof(uint64) / (1024.0 * 1024.0), BuiltInRate, NativeRate / FMath::Max(BuiltInRate, 1e-9));
+	}
+
+	static FAutoConsoleCommand BenchmarkNativeGeneratorCommand(
+		TEXT("MineSweeper.Benchmark.NativeGenerator"),
+		TEXT("Validates a generator library and times batch generation through the C ABI. Arguments: library path, then optionally boards (default 1000000) and boards per batch (default 4096)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				if (Args.Num() == 0)
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("MineSweeper.Benchmark.NativeGenerator needs the path of a generator library"));
+					return;
+				}
+				const int32 NumBoards = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 1000000;
+				const int32 BatchSize = Args.Num() > 2 ? FMath::Clamp(FCString::Atoi(*Args[2]), 1, 1 << 20) : 4096;
+				BenchmarkNativeGenerator(Args[0], NumBoards, BatchSize);
+			}));
+}
@@ -0,0 +1,419 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperBitboard.h"
+
+#include "HAL/IConsoleManager.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <immintrin.h>
+#endif
+
+static TAutoConsoleVariable<int32> CVarBitboardSimd(
+	TEXT("MineSweeper.Bitboard.Simd"),
+	2,
+	TEXT("Widest vector path new bitboards may use: 0 scalar, 1 AVX2, 2 AVX-512. Anything the CPU can't run falls back to the next one down."));
+
+/**
+* The planes the kernels work on, as raw pointers so each instruction set's copy of the loops can be handed the same thing.
+*/
+struct MineSweeperBitboardPlanes
+{
+	const uint64* Mines;
+	const uint64* Valid;
+	uint64* Bits[4];
+	uint64* Zero;
+	uint64* Revealed;
+	uint64* Open;
+	int32 Stride;
+};
+
+/**
+* One set of loops per instruction set. The bitboard picks one when it's made, from what the CPU supports, so the same
+* binary runs the widest loops the machine has without the module having to be compiled for it.
+*/
+struct MineSweeperBitboardKernels
+{
+	const TCHAR* Name;
+	void (*Count)(const MineSweeperBitboardPlanes& Planes, int32 Begin, int32 End);
+	bool (*Seed)(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 FromStart, int32 NumWords);
+	int32 (*Reveal)(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 NumWords);
+};
+
+namespace
+{
+	/**
+	* The loops are written once against these, and each one decides how many words it handles per step.
+	*/
+	struct ScalarOps
+	{
+		using Vector = uint64;
+		static constexpr int32 Lanes = 1;
+		static FORCEINLINE Vector Zero() { return 0; }
+		static FORCEINLINE Vector Load(const uint64* Ptr) { return *Ptr; }
+		static FORCEINLINE void Store(uint64* Ptr, Vector Value) { *Ptr = Value; }
+		static FORCEINLINE Vector And(Vector A, Vector B) { return A & B; }
+		static FORCEINLINE Vector Or(Vector A, Vector B) { return A | B; }
+		static FORCEINLINE Vector Xor(Vector A, Vector B) { return A ^ B; }
+		static FORCEINLINE Vector AndNot(Vector A, Vector B) { return ~A & B; }
+		static FORCEINLINE Vector ShiftLeft1(Vector A) { return A << 1; }
+		static FORCEINLINE Vector ShiftRight1(Vector A) { return A >> 1; }
+		static FORCEINLINE Vector ShiftLeft63(Vector A) { return A << 63; }
+		static FORCEINLINE Vector ShiftRight63(Vector A) { return A >> 63; }
+		static FORCEINLINE bool IsZero(Vector A) { return A == 0; }
+		static FORCEINLINE int32 CountBits(Vector A) { return int32(FMath::CountBits(A)); }
+	};
+}
+
+namespace MineSweeperBitboardScalar
+{
+	using WideOps = ScalarOps;
+#include "MineSweeperBitboardKernels.inl"
+}
+
+/**
+* Clang and GCC only allow AVX intrinsics in functions compiled for AVX, so everything between these is, without
+* turning it on for the rest of the module. MSVC allows them anywhere and needs nothing.
+*/
+#if PLATFORM_CPU_X86_FAMILY && defined(__clang__)
+#define MINESWEEPER_BEGIN_TARGET(Target) _Pragma(PREPROCESSOR_TO_STRING(clang attribute push(__attribute__((target(Target))), apply_to = function)))
+#define MINESWEEPER_END_TARGET() _Pragma("clang attribute pop")
+#elif PLATFORM_CPU_X86_FAMILY && defined(__GNUC__)
+#define MINESWEEPER_BEGIN_TARGET(Target) _Pragma("GCC push_options") _Pragma(PREPROCESSOR_TO_STRING(GCC target(Target)))
+#define MINESWEEPER_END_TARGET() _Pragma("GCC pop_options")
+#else
+#define MINESWEEPER_BEGIN_TARGET(Target)
+#define MINESWEEPER_END_TARGET()
+#endif
+
+#if PLATFORM_CPU_X86_FAMILY
+MINESWEEPER_BEGIN_TARGET("avx2")
+namespace MineSweeperBitboardAvx2
+{
+	struct WideOps
+	{
+		using Vector = __m256i;
+		static constexpr int32 Lanes = 4;
+		static FORCEINLINE Vector Zero() { return _mm256_setzero_si256(); }
+		static FORCEINLINE Vector Load(const uint64* Ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Ptr)); }
+		static FORCEINLINE void Store(uint64* Ptr, Vector Value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(Ptr), Value); }
+		static FORCEINLINE Vector And(Vector A, Vector B) { return _mm256_and_si256(A, B); }
+		static FORCEINLINE Vector Or(Vector A, Vector B) { return _mm256_or_si256(A, B); }
+		static FORCEINLINE Vector Xor(Vector A, Vector B) { return _mm256_xor_si256(A, B); }
+		static FORCEINLINE Vector AndNot(Vector A, Vector B) { return _mm256_andnot_si256(A, B); }
+		static FORCEINLINE Vector ShiftLeft1(Vector A) { return _mm256_slli_epi64(A, 1); }
+		static FORCEINLINE Vector ShiftRight1(Vector A) { return _mm256_srli_epi64(A, 1); }
+		static FORCEINLINE Vector ShiftLeft63(Vector A) { return _mm256_slli_epi64(A, 63); }
+		static FORCEINLINE Vector ShiftRight63(Vector A) { return _mm256_srli_epi64(A, 63); }
+		static FORCEINLINE bool IsZero(Vector A) { return _mm256_testz_si256(A, A) != 0; }
+		static FORCEINLINE int32 CountBits(Vector A)
+		{
+			// No vector popcount before AVX-512, and a reveal is mostly memory bound anyway
+			return int32(FMath::CountBits(uint64(_mm256_extract_epi64(A, 0))) + FMath::CountBits(uint64(_mm256_extract_epi64(A, 1)))
+				+ FMath::CountBits(uint64(_mm256_extract_epi64(A, 2))) + FMath::CountBits(uint64(_mm256_extract_epi64(A, 3))));
+		}
+	};
+#include "MineSweeperBitboardKernels.inl"
+}
+MINESWEEPER_END_TARGET()
+
+MINESWEEPER_BEGIN_TARGET("avx512f")
+namespace MineSweeperBitboardAvx512
+{
+	struct WideOps
+	{
+		using Vector = __m512i;
+		static constexpr int32 Lanes = 8;
+		static FORCEINLINE Vector Zero() { return _mm512_setzero_si512(); }
+		static FORCEINLINE Vector Load(const uint64* Ptr) { return _mm512_loadu_si512(Ptr); }
+		static FORCEINLINE void Store(uint64* Ptr, Vector Value) { _mm512_storeu_si512(Ptr, Value); }
+		static FORCEINLINE Vector And(Vector A, Vector B) { return _mm512_and_si512(A, B); }
+		static FORCEINLINE Vector Or(Vector A, Vector B) { return _mm512_or_si512(A, B); }
+		static FORCEINLINE Vector Xor(Vector A, Vector B) { return _mm512_xor_si512(A, B); }
+		static FORCEINLINE Vector AndNot(Vector A, Vector B) { return _mm512_andnot_si512(A, B); }
+		static FORCEINLINE Vector ShiftLeft1(Vector A) { return _mm512_slli_epi64(A, 1); }
+		static FORCEINLINE Vector ShiftRight1(Vector A) { return _mm512_srli_epi64(A, 1); }
+		static FORCEINLINE Vector ShiftLeft63(Vector A) { return _mm512_slli_epi64(A, 63); }
+		static FORCEINLINE Vector ShiftRight63(Vector A) { return _mm512_srli_epi64(A, 63); }
+		static FORCEINLINE bool IsZero(Vector A) { return _mm512_test_epi64_mask(A, A) == 0; }
+		static FORCEINLINE int32 CountBits(Vector A)
+		{
+			alignas(64) uint64 Words[8];
+			_mm512_store_si512(Words, A);
+			int32 Total = 0;
+			for (uint64 Word : Words)
+			{
+				Total += int32(FMath::CountBits(Word));
+			}
+			return Total;
+		}
+	};
+#include "MineSweeperBitboardKernels.inl"
+}
+MINESWEEPER_END_TARGET()
+#endif
+
+namespace
+{
+	enum class EBitboardSimd : int32
+	{
+		Scalar,
+		Avx2,
+		Avx512,
+	};
+
+	/** What the CPU and the OS between them support, checked once */
+	EBitboardSimd DetectSimd()
+	{
+#if PLATFORM_CPU_X86_FAMILY && defined(_MSC_VER) && !defined(__clang__)
+		int32 Info[4];
+		__cpuid(Info, 0);
+		if (Info[0] < 7)
+		{
+			return EBitboardSimd::Scalar;
+		}
+		__cpuid(Info, 1);
+		const bool bOsSavesAvx = (Info[2] & (1 << 27)) != 0 && (Info[2] & (1 << 28)) != 0; // OSXSAVE and AVX
+		if (!bOsSavesAvx)
+		{
+			return EBitboardSimd::Scalar;
+		}
+		const uint64 EnabledState = _xgetbv(0);
+		__cpuidex(Info, 7, 0);
+		if ((Info[1] & (1 << 16)) != 0 && (EnabledState & 0xE6) == 0xE6) // AVX-512F, and the OS saves the zmm registers
+		{
+			return EBitboardSimd::Avx512;
+		}
+		if ((Info[1] & (1 << 5)) != 0 && (EnabledState & 0x6) == 0x6)
+		{
+			return EBitboardSimd::Avx2;
+		}
+#elif PLATFORM_CPU_X86_FAMILY
+		// These check the OS saves the wider registers too
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+		{
+			return EBitboardSimd::Avx512;
+		}
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return EBitboardSimd::Avx2;
+		}
+#endif
+		return EBitboardSimd::Scalar;
+	}
+
+	const MineSweeperBitboardKernels& GetKernels()
+	{
+		static const MineSweeperBitboardKernels Scalar = { TEXT("Scalar"), &MineSweeperBitboardScalar::Count, &MineSweeperBitboardScalar::Seed, &MineSweeperBitboardScalar::Reveal };
+#if PLATFORM_CPU_X86_FAMILY
+		static const MineSweeperBitboardKernels Avx2 = { TEXT("AVX2"), &MineSweeperBitboardAvx2::Count, &MineSweeperBitboardAvx2::Seed, &MineSweeperBitboardAvx2::Reveal };
+		static const MineSweeperBitboardKernels Avx512 = { TEXT("AVX-512"), &MineSweeperBitboardAvx512::Count, &MineSweeperBitboardAvx512::Seed, &MineSweeperBitboardAvx512::Reveal };
+		static const EBitboardSimd Supported = DetectSimd();
+		const EBitboardSimd Allowed = EBitboardSimd(FMath::Clamp(CVarBitboardSimd.GetValueOnAnyThread(), 0, 2));
+		switch (FMath::Min(Supported, Allowed))
+		{
+		case EBitboardSimd::Avx512:
+			return Avx512;
+		case EBitboardSimd::Avx2:
+			return Avx2;
+		default:
+			break;
+		}
+#endif
+		return Scalar;
+	}
+
+	/**
+	* Spreads every seed towards the high bits for as long as Through stays set, plus a carry in at bit 0.
+	* Adding a seed to a run of ones carries all the way to the top of the run, so the bits that changed are the fill.
+	* If the run reaches bit 63 the add overflows, which is exactly when the fill carries on into the next word.
+	*/
+	FORCEINLINE uint64 FillUp(uint64 Seeds, uint64 Through, uint64& InOutCarry)
+	{
+		const uint64 CarryIn = InOutCarry & Through & 1;
+		const uint64 In = Seeds & Through;
+		const uint64 Partial = Through + In;
+		const uint64 Sum = Partial + CarryIn;
+		InOutCarry = (Partial < Through) | (Sum < Partial);
+		return ((Sum ^ Through) | In | CarryIn) & Through;
+	}
+
+	/** The add trick only carries upwards, so the other direction is a shift-and-mask (Kogge-Stone) fill */
+	FORCEINLINE uint64 FillDown(uint64 Seeds, uint64 Through)
+	{
+		Seeds |= Through & (Seeds >> 1); Through &= Through >> 1;
+		Seeds |= Through & (Seeds >> 2); Through &= Through >> 2;
+		Seeds |= Through & (Seeds >> 4); Through &= Through >> 4;
+		Seeds |= Through & (Seeds >> 8); Through &= Through >> 8;
+		Seeds |= Through & (Seeds >> 16); Through &= Through >> 16;
+		Seeds |= Through & (Seeds >> 32);
+		return Seeds;
+	}
+}
+
+MineSweeperBitboard::MineSweeperBitboard(int32 InWidth, int32 InHeight)
+	: Width(InWidth), Height(InHeight), Kernels(&GetKernels())
+{
+	WordsPerRow = (Width + 63) / 64;
+	Stride = WordsPerRow + 1;
+	Base = Stride + 1;
+	const int32 NumWords = Base + (Height + 1) * Stride + 1;
+	for (std::vector<uint64>* Plane : { &Valid, &Mines, &Revealed, &Zero, &CountBits[0], &CountBits[1], &CountBits[2], &CountBits[3], &Open })
+	{
+		Plane->assign(NumWords, 0);
+	}
+	for (int32 Row = 0; Row < Height; Row++)
+	{
+		for (int32 Word = 0; Word < WordsPerRow; Word++)
+		{
+			const int32 Bits = FMath::Min(64, Width - Word * 64);
+			Valid[WordIndex(Row, Word)] = Bits == 64 ? ~uint64(0) : (uint64(1) << Bits) - 1;
+		}
+	}
+}
+
+const TCHAR* MineSweeperBitboard::GetSimdName() const
+{
+	return Kernels->Name;
+}
+
+MineSweeperBitboardPlanes MineSweeperBitboard::GetPlanes()
+{
+	return { Mines.data(), Valid.data(), { CountBits[0].data(), CountBits[1].data(), CountBits[2].data(), CountBits[3].data() }, Zero.data(), Revealed.data(), Open.data(), Stride };
+}
+
+void MineSweeperBitboard::SetMines(const std::vector<bool>& Tiles)
+{
+	std::fill(Mines.begin(), Mines.end(), 0);
+	std::fill(Revealed.begin(), Revealed.end(), 0);
+	NumMines = 0;
+	NumRevealedSafe = 0;
+	for (int32 Tile = 0; Tile < Num(); Tile++)
+	{
+		if (Tiles[Tile])
+		{
+			const int32 Column = Tile % Width;
+			Mines[WordIndex(Tile / Width, Column >> 6)] |= uint64(1) << (Column & 63);
+			NumMines++;
+		}
+	}
+	ComputeAdjacency();
+}
+
+void MineSweeperBitboard::ComputeAdjacency()
+{
+	Kernels->Count(GetPlanes(), Base, Base + Height * Stride);
+}
+
+int32 MineSweeperBitboard::GetAdjacentMines(int32 Tile) const
+{
+	return int32(TestBit(CountBits[0], Tile)) | (int32(TestBit(CountBits[1], Tile)) << 1)
+		| (int32(TestBit(CountBits[2], Tile)) << 2) | (int32(TestBit(CountBits[3], Tile)) << 3);
+}
+
+bool MineSweeperBitboard::FillRow(int32 Row, int32 FromRow)
+{
+	const int32 RowStart = WordIndex(Row, 0);
+	const int32 FromStart = WordIndex(FromRow, 0);
+
+	// Anything next to the opening in the row we came from, that's also a zero here, joins the opening. No word
+	// depends on another for that, so it goes through the vector kernel. Then it spreads along the row both ways,
+	// carrying the ends of each run into the next word, which is serial.
+	bool bChanged = Kernels->Seed(GetPlanes(), RowStart, FromStart, WordsPerRow);
+	uint64 Carry = 0;
+	for (int32 Word = 0; Word < WordsPerRow; Word++)
+	{
+		const uint64 Through = Zero[RowStart + Word];
+		const uint64 Current = Open[RowStart + Word];
+		const uint64 Filled = FillUp(Current, Through, Carry);
+		bChanged |= Filled != Current;
+		Open[RowStart + Word] = Filled;
+	}
+	Carry = 0;
+	for (int32 Word = WordsPerRow - 1; Word >= 0; Word--)
+	{
+		const uint64 Through = Zero[RowStart + Word];
+		uint64 Current = Open[RowStart + Word];
+		// Most words are already closed downwards (the row above handed us the whole run), so only fill when a zero
+		// directly below an open bit is still missing
+		const uint64 Missing = ((Current >> 1) | (Carry << 63)) & Through & ~Current;
+		if (Missing)
+		{
+			Current = FillDown(Current | Missing, Through);
+			bChanged = true;
+			Open[RowStart + Word] = Current;
+		}
+		Carry = Current & 1;
+	}
+	return bChanged;
+}
+
+int32 MineSweeperBitboard::Reveal(int32 Tile)
+{
+	if (IsRevealed(Tile))
+	{
+		return 0;
+	}
+	const int32 Row = Tile / Width;
+	const int32 Column = Tile % Width;
+	const int32 Index = WordIndex(Row, Column >> 6);
+	const uint64 Bit = uint64(1) << (Column & 63);
+	if (!(Zero[Index] & Bit))
+	{
+		Revealed[Index] |= Bit;
+		NumRevealedSafe += !(Mines[Index] & Bit);
+		return 1;
+	}
+
+	// Grow the opening until a full sweep down and back up changes nothing. Sweeping in both directions lets a row use
+	// the rows we've just filled, so ordinary openings settle in a couple of passes instead of one ring per pass.
+	// The padding row above and below is all zeros, which is what FromRow points at for the seed row.
+	Open[Index] |= Bit;
+	FillRow(Row, Row - 1);
+	int32 Lowest = Row;
+	int32 Highest = Row;
+	bool bChanged = true;
+	while (bChanged)
+	{
+		bChanged = false;
+		for (int32 Next = Lowest + 1; Next < Height; Next++)
+		{
+			if (FillRow(Next, Next - 1))
+			{
+				bChanged = true;
+				Highest = FMath::Max(Highest, Next);
+			}
+			else if (Next > Highest)
+			{
+				break; // Nothing crossed into this row, so nothing can get past it either
+			}
+		}
+		for (int32 Next = Highest - 1; Next >= 0; Next--)
+		{
+			if (FillRow(Next, Next + 1))
+			{
+				bChanged = true;
+				Lowest = FMath::Min(Lowest, Next);
+			}
+			else if (Next < Lowest)
+			{
+				break;
+			}
+		}
+	}
+
+	// The opening plus everything around it is revealed. None of those can be mines, they all border a zero.
+	const MineSweeperBitboardPlanes Planes = GetPlanes();
+	int32 NumChanged = 0;
+	for (int32 Next = FMath::Max(0, Lowest - 1); Next <= FMath::Min(Height - 1, Highest + 1); Next++)
+	{
+		NumChanged += Kernels->Reveal(Planes, WordIndex(Next, 0), WordsPerRow);
+	}
+	for (int32 Next = Lowest; Next <= Highest; Next++)
+	{
+		std::fill(Open.begin() + WordIndex(Next, 0), Open.begin() + WordIndex(Next, 0) + WordsPerRow, 0);
+	}
+	NumRevealedSafe += NumChanged;
+	return NumChanged;
+}
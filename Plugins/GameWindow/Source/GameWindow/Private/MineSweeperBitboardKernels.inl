@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+/**
+* The bitboard's word loops, written once against an ops struct. MineSweeperBitboard.cpp includes this once per
+* instruction set, each time inside its own namespace with WideOps defined, and with the compiler told it may use
+* that instruction set for everything in between. Nothing in here may be a lambda, since not every compiler carries
+* the target over to those.
+*/
+
+template<typename Ops>
+FORCEINLINE typename Ops::Vector FullAddSum(typename Ops::Vector A, typename Ops::Vector B, typename Ops::Vector C, typename Ops::Vector& OutCarry)
+{
+	const typename Ops::Vector Partial = Ops::Xor(A, B);
+	OutCarry = Ops::Or(Ops::And(A, B), Ops::And(Partial, C));
+	return Ops::Xor(Partial, C);
+}
+
+/** Bit c is the tile at column c - 1, carrying over from the word before */
+template<typename Ops>
+FORCEINLINE typename Ops::Vector LoadLeft(const uint64* Ptr)
+{
+	return Ops::Or(Ops::ShiftLeft1(Ops::Load(Ptr)), Ops::ShiftRight63(Ops::Load(Ptr - 1)));
+}
+
+/** Bit c is the tile at column c + 1, carrying over from the word after */
+template<typename Ops>
+FORCEINLINE typename Ops::Vector LoadRight(const uint64* Ptr)
+{
+	return Ops::Or(Ops::ShiftRight1(Ops::Load(Ptr)), Ops::ShiftLeft63(Ops::Load(Ptr + 1)));
+}
+
+/** The words themselves plus their left and right neighbors */
+template<typename Ops>
+FORCEINLINE typename Ops::Vector LoadDilated(const uint64* Ptr)
+{
+	return Ops::Or(Ops::Load(Ptr), Ops::Or(LoadLeft<Ops>(Ptr), LoadRight<Ops>(Ptr)));
+}
+
+/**
+* Adds the eight neighbor planes of every word in [Begin, End) and returns where it stopped, so a narrower set of
+* ops can pick up the tail.
+*
+* The eight inputs go through two full adders and a half adder, whose three sums go through another full adder for
+* the 1s bit. The four carries (all worth 2) are added the same way to give the 2s, 4s and 8s bits.
+*/
+template<typename Ops>
+int32 CountKernel(const MineSweeperBitboardPlanes& Planes, int32 Begin, int32 End)
+{
+	using Vector = typename Ops::Vector;
+	int32 Index = Begin;
+	for (; Index + Ops::Lanes <= End; Index += Ops::Lanes)
+	{
+		const uint64* Above = Planes.Mines + Index - Planes.Stride;
+		const uint64* Center = Planes.Mines + Index;
+		const uint64* Below = Planes.Mines + Index + Planes.Stride;
+
+		Vector CarryA, CarryB;
+		const Vector SumA = FullAddSum<Ops>(LoadLeft<Ops>(Above), Ops::Load(Above), LoadRight<Ops>(Above), CarryA);
+		const Vector SumB = FullAddSum<Ops>(LoadLeft<Ops>(Center), LoadRight<Ops>(Center), LoadLeft<Ops>(Below), CarryB);
+		const Vector Bottom = Ops::Load(Below);
+		const Vector BottomRight = LoadRight<Ops>(Below);
+		const Vector SumC = Ops::Xor(Bottom, BottomRight);
+		const Vector CarryC = Ops::And(Bottom, BottomRight);
+
+		Vector CarryOnes;
+		const Vector Ones = FullAddSum<Ops>(SumA, SumB, SumC, CarryOnes);
+
+		Vector CarryTwos;
+		const Vector TwosPartial = FullAddSum<Ops>(CarryA, CarryB, CarryC, CarryTwos);
+		const Vector Twos = Ops::Xor(TwosPartial, CarryOnes);
+		const Vector CarryTwosB = Ops::And(TwosPartial, CarryOnes);
+		const Vector Fours = Ops::Xor(CarryTwos, CarryTwosB);
+		const Vector Eights = Ops::And(CarryTwos, CarryTwosB);
+
+		const Vector Valid = Ops::Load(Planes.Valid + Index);
+		Ops::Store(Planes.Bits[0] + Index, Ops::And(Ones, Valid));
+		Ops::Store(Planes.Bits[1] + Index, Ops::And(Twos, Valid));
+		Ops::Store(Planes.Bits[2] + Index, Ops::And(Fours, Valid));
+		Ops::Store(Planes.Bits[3] + Index, Ops::And(Eights, Valid));
+		const Vector Any = Ops::Or(Ops::Or(Ones, Twos), Ops::Or(Fours, Eights));
+		Ops::Store(Planes.Zero + Index, Ops::AndNot(Ops::Or(Any, Ops::Load(Center)), Valid));
+	}
+	return Index;
+}
+
+/**
+* The first step of filling a row of the opening: every zero in Row that touches the opening in FromRow joins it.
+* Row and FromRow are different rows, so the words being written are never the ones being read. Returns where it
+* stopped, and ORs anything that joined into InOutAdded.
+*/
+template<typename Ops>
+int32 SeedKernel(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 FromStart, int32 Begin, int32 End, typename Ops::Vector& InOutAdded)
+{
+	using Vector = typename Ops::Vector;
+	int32 Word = Begin;
+	for (; Word + Ops::Lanes <= End; Word += Ops::Lanes)
+	{
+		uint64* Open = Planes.Open + RowStart + Word;
+		const Vector Current = Ops::Load(Open);
+		const Vector Seeds = Ops::And(LoadDilated<Ops>(Planes.Open + FromStart + Word), Ops::Load(Planes.Zero + RowStart + Word));
+		InOutAdded = Ops::Or(InOutAdded, Ops::AndNot(Current, Seeds));
+		Ops::Store(Open, Ops::Or(Current, Seeds));
+	}
+	return Word;
+}
+
+/**
+* The last step of a flood: everything in a row that touches the opening, from the row above, the row itself or the
+* row below, is revealed. Returns where it stopped, and adds the tiles it revealed to InOutRevealed.
+*/
+template<typename Ops>
+int32 RevealKernel(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 Begin, int32 End, int32& InOutRevealed)
+{
+	using Vector = typename Ops::Vector;
+	int32 Word = Begin;
+	for (; Word + Ops::Lanes <= End; Word += Ops::Lanes)
+	{
+		const int32 Index = RowStart + Word;
+		const Vector Area = Ops::Or(LoadDilated<Ops>(Planes.Open + Index - Planes.Stride),
+			Ops::Or(LoadDilated<Ops>(Planes.Open + Index), LoadDilated<Ops>(Planes.Open + Index + Planes.Stride)));
+		const Vector Revealed = Ops::Load(Planes.Revealed + Index);
+		const Vector NewlyRevealed = Ops::AndNot(Revealed, Ops::And(Area, Ops::Load(Planes.Valid + Index)));
+		Ops::Store(Planes.Revealed + Index, Ops::Or(Revealed, NewlyRevealed));
+		InOutRevealed += Ops::CountBits(NewlyRevealed);
+	}
+	return Word;
+}
+
+/** What the bitboard calls through its kernel table. The wide ops take as much as they can and scalar does the tail. */
+void Count(const MineSweeperBitboardPlanes& Planes, int32 Begin, int32 End)
+{
+	const int32 Tail = CountKernel<WideOps>(Planes, Begin, End);
+	CountKernel<ScalarOps>(Planes, Tail, End);
+}
+
+bool Seed(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 FromStart, int32 NumWords)
+{
+	WideOps::Vector WideAdded = WideOps::Zero();
+	uint64 Added = 0;
+	const int32 Tail = SeedKernel<WideOps>(Planes, RowStart, FromStart, 0, NumWords, WideAdded);
+	SeedKernel<ScalarOps>(Planes, RowStart, FromStart, Tail, NumWords, Added);
+	return !WideOps::IsZero(WideAdded) || Added != 0;
+}
+
+int32 Reveal(const MineSweeperBitboardPlanes& Planes, int32 RowStart, int32 NumWords)
+{
+	int32 NumRevealed = 0;
+	const int32 Tail = RevealKernel<WideOps>(Planes, RowStart, 0, NumWords, NumRevealed);
+	RevealKernel<ScalarOps>(Planes, RowStart, Tail, NumWords, NumRevealed);
+	return NumRevealed;
+}
@@ -2,45 +2,326 @@
 
 
 #include "MineSweeperBoard.h"
+#include "SMineSweeperBoardView.h"
 
-#include "Containers/Ticker.h"
+#include "Async/Async.h"
+#include "Framework/Application/SlateApplication.h"
+#include "HAL/IConsoleManager.h"
+#include "InputCoreTypes.h"
+#include "Rendering/SlateRenderer.h"
+#include "Widgets/Layout/SBorder.h"
+#include "Widgets/Layout/SSpacer.h"
 
 DEFINE_LOG_CATEGORY(MineSweeperLog);
 
+LLM_DEFINE_TAG(MineSweeper_State);
+LLM_DEFINE_TAG(MineSweeper_Widgets);
+LLM_DEFINE_TAG(MineSweeper_Keys);
+LLM_DEFINE_TAG(MineSweeper_Caches);
+
+static TAutoConsoleVariable<int32> CVarMemoryBudgetMB(
+	TEXT("MineSweeper.Memory.BudgetMB"),
+	1024,
+	TEXT("Most memory one board may use, in megabytes. Boards that would go over it with buttons are drawn by the board view instead, and boards that would go over it anyway are refused. 0 means no limit."));
+
+static TAutoConsoleVariable<int32> CVarViewMaxButtonTiles(
+	TEXT("MineSweeper.View.MaxButtonTiles"),
+	100 * 100,
+	TEXT("Boards with more tiles than this are drawn by a single zoomable view instead of a button per tile."));
+
+namespace
+{
+	/**
+	* Every label a tile can show, made once. Copying an FText only bumps a reference count, so setting one of these on a
+	* label doesn't allocate, where formatting a new one every reveal would.
+	*/
+	const FText& GetNumberText(int32 Count)
+	{
+		static const TArray<FText> Numbers = []()
+			{
+				TArray<FText> Result;
+				for (int32 Number = 0; Number <= MineSweeperGrid::MaxNeighbors; Number++)
+				{
+					Result.Add(FText::FromString(FString::FromInt(Number)));
+				}
+				return Result;
+			}();
+		return Numbers[Count];
+	}
+
+	// Half of a button with a one character label, near enough for the rows to interlock
+	constexpr float HexRowShift = 12.0f;
+
+	const FText& GetHiddenText()
+	{
+		static const FText Hidden = FText::FromString(TEXT("+"));
+		return Hidden;
+	}
+
+	const FText& GetFlagText()
+	{
+		static const FText Flag = FText::FromString(TEXT("F"));
+		return Flag;
+	}
+
+	/**
+	* The Slate side of one tile: the button, its label, the border that catches right clicks, the slot in its row and the
+	* four lambdas bound to them (a functor delegate instance is a vtable plus the captured this and tile, rounded up
+	* to the allocator's smallest bin), and the byte saying what it looks like.
+	*/
+	constexpr SIZE_T BytesPerBoundLambda = 48;
+	constexpr SIZE_T WidgetBytesPerTile = sizeof(SButton) + sizeof(STextBlock) + sizeof(SBorder) + sizeof(SHorizontalBox::FSlot) + 4 * BytesPerBoundLambda + 1;
+
+	SIZE_T GetBudgetBytes()
+	{
+		return SIZE_T(FMath::Max(0, CVarMemoryBudgetMB.GetValueOnGameThread())) * 1024 * 1024;
+	}
+
+	double ToMB(SIZE_T Bytes)
+	{
+		return Bytes / (1024.0 * 1024.0);
+	}
+
+	// The last board refreshed, see MineSweeperBoard::GetActiveBoard
+	TWeakPtr<MineSweeperBoard, ESPMode::ThreadSafe> LastRefreshedBoard;
+
+	void LogMemoryReport(const TCHAR* What, const MineSweeperMemoryReport& Report)
+	{
+		UE_LOG(MineSweeperLog, Display, TEXT("%s: %.2f MB, state %.2f, widgets %.2f, keys %.2f, caches %.2f"), What, ToMB(Report.GetTotal()),
+			ToMB(Report.StateBytes), ToMB(Report.WidgetBytes), ToMB(Report.KeyBytes), ToMB(Report.CacheBytes));
+	}
+
+	static FAutoConsoleCommand MemoryReportCommand(
+		TEXT("MineSweeper.Memory.Report"),
+		TEXT("Logs what the current board is using. With a width and height, logs what a board that size would use with buttons and with the board view instead."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				if (Args.Num() >= 2)
+				{
+					const int32 Width = FCString::Atoi(*Args[0]);
+					const int32 Height = FCString::Atoi(*Args[1]);
+					LogMemoryReport(*FString::Printf(TEXT("%dx%d with buttons"), Width, Height), MineSweeperBoard::EstimateMemory(Width, Height, true));
+					LogMemoryReport(*FString::Printf(TEXT("%dx%d with the board view"), Width, Height), MineSweeperBoard::EstimateMemory(Width, Height, false));
+					UE_LOG(MineSweeperLog, Display, TEXT("Budget: %.1f MB"), ToMB(GetBudgetBytes()));
+					return;
+				}
+				TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board = MineSweeperBoard::GetActiveBoard();
+				if (!Board.IsValid())
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("No board to report on"));
+					return;
+				}
+				LogMemoryReport(Board->UsesButtons() ? TEXT("Current board with buttons") : TEXT("Current board with the board view"), Board->GetMemoryReport());
+			}));
+}
+
+TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> MineSweeperBoard::GetActiveBoard()
+{
+	return LastRefreshedBoard.Pin();
+}
+
 MineSweeperBoard::~MineSweeperBoard()
 {
 	StopGameTimer();
+	if (WindowRenderedHandle.IsValid() && FSlateApplication::IsInitialized() && FSlateApplication::Get().GetRenderer())
+	{
+		FSlateApplication::Get().GetRenderer()->OnSlateWindowRendered().Remove(WindowRenderedHandle);
+	}
 }
 
-void MineSweeperBoard::RefreshBoard(int Width, int Height, int NumMines, TSharedPtr<GenerateBoard> Generator)
+bool MineSweeperBoard::RefreshBoard(int Width, int Height, int NumMines, TSharedPtr<GenerateBoard> Generator, int32 FirstClickSeed)
 {
-	VerticalBox->ClearChildren();
+	return RefreshBoard(EMineSweeperTopology::Square, { Width, Height, 1 }, NumMines, Generator, FirstClickSeed);
+}
+
+bool MineSweeperBoard::RefreshBoard(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims, int NumMines, TSharedPtr<GenerateBoard> Generator, int32 FirstClickSeed)
+{
+	// Checked before anything is generated, a board too big for the budget shouldn't get the chance to allocate at all
+	if (!FitsBudget(Topology, Dims))
+	{
+		return false;
+	}
+	Perf.Reset();
 
-	TileState.Empty(); // Clear the TileState for each new row
-	BoardWidth = Width;
-	BoardHeight = Height;
 	// Create a new board using the generator
-	std::vector<std::vector<bool>> Board = Generator->Generate(Width, Height, NumMines);
+	uint64 PhaseStart = FPlatformTime::Cycles64();
+	std::vector<std::vector<bool>> Board = Generator->Generate(Dims.Width, Dims.Height * Dims.Depth, NumMines);
+	Perf.RecordGeneration(EMineSweeperGenerationPhase::Mines, PhaseStart);
 	
 	// For testing purposes, you can set mines manually in the board,
 	//Board[2][2] = true; // Example: Set a mine at (2, 2) for testing purposes
 	//Board[2][0] = true; // Example: Set a mine at (0, 0) for testing purposes
 	//Board[2][4] = true; // Example: Set a mine at (4, 4) for testing purposes
 
+	TSharedPtr<MineSweeperGrid> NewGrid;
+	PhaseStart = FPlatformTime::Cycles64();
+	{
+		LLM_SCOPE_BYTAG(MineSweeper_State);
+		NewGrid = MakeMineSweeperGrid(Topology, Dims);
+		NewGrid->SetMines(Board);
+	}
+	Perf.RecordGeneration(EMineSweeperGenerationPhase::Counts, PhaseStart);
+	BuildBoard(NewGrid.ToSharedRef(), FirstClickSeed);
+	return true;
+}
+
+bool MineSweeperBoard::RefreshBoard(TSharedRef<MineSweeperGrid> ReadyGrid, int32 FirstClickSeed)
+{
+	if (!FitsBudget(ReadyGrid->GetTopology(), { ReadyGrid->GetWidth(), ReadyGrid->GetHeight(), ReadyGrid->GetDepth() }))
+	{
+		return false;
+	}
+	// The mines and counts were done on a worker before anyone asked, so those phases stay at 0
+	Perf.Reset();
+	BuildBoard(ReadyGrid, FirstClickSeed);
+	return true;
+}
 
-	for (int i = 0; i < Height; i++)
+bool MineSweeperBoard::FitsBudget(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims)
+{
+	const SIZE_T Budget = GetBudgetBytes();
+	const MineSweeperMemoryReport WithView = EstimateMemory(Topology, Dims, false);
+	if (Budget > 0 && WithView.GetTotal() > Budget)
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("Refusing a %dx%dx%d board, it needs at least %.1f MB and the budget is %.1f MB (MineSweeper.Memory.BudgetMB)"),
+			Dims.Width, Dims.Height, Dims.Depth, ToMB(WithView.GetTotal()), ToMB(Budget));
+		return false;
+	}
+	return true;
+}
+
+void MineSweeperBoard::BuildBoard(TSharedRef<MineSweeperGrid> ReadyGrid, int32 FirstClickSeed)
+{
+	const SIZE_T Budget = GetBudgetBytes();
+	const MineSweeperDimensions Dims = { ReadyGrid->GetWidth(), ReadyGrid->GetHeight(), ReadyGrid->GetDepth() };
+	const MineSweeperMemoryReport WithButtons = EstimateMemory(ReadyGrid->GetTopology(), Dims, true);
+	const MineSweeperMemoryReport WithView = EstimateMemory(ReadyGrid->GetTopology(), Dims, false);
+
+	VerticalBox->ClearChildren();
+
+	Grid = ReadyGrid;
+	bUseButtons = Grid->Num() <= CVarViewMaxButtonTiles.GetValueOnGameThread();
+	if (bUseButtons && Budget > 0 && WithButtons.GetTotal() > Budget)
+	{
+		// Still playable, just drawn by one widget instead of hundreds of thousands
+		UE_LOG(MineSweeperLog, Warning, TEXT("A %dx%d board with buttons needs about %.1f MB, over the %.1f MB budget, so it's drawn by the board view (%.1f MB)"),
+			Grid->GetWidth(), Grid->GetRows(), ToMB(WithButtons.GetTotal()), ToMB(Budget), ToMB(WithView.GetTotal()));
+		bUseButtons = false;
+	}
+	{
+		LLM_SCOPE_BYTAG(MineSweeper_Keys);
+		Tiles.Reset(bUseButtons ? Grid->Num() : 0);
+	}
+	{
+		LLM_SCOPE_BYTAG(MineSweeper_Widgets);
+		TileLooks.assign(bUseButtons ? Grid->Num() : 0, ETileLook::Hidden);
+		TileLooks.shrink_to_fit(); // A board view after a button board shouldn't keep paying for the buttons' looks
+	}
+	BoardWidth = Grid->GetWidth();
+	BoardHeight = Grid->GetRows();
+	MineNum = Grid->GetNumMines();
+	bFirstClick = true;
+	Phase = EMineSweeperPhase::Playing;
+	ShownHint = MineSweeperHint();
+	FirstClickStream.Initialize(FirstClickSeed);
+	uint64 PhaseStart = FPlatformTime::Cycles64();
+	{
+		LLM_SCOPE_BYTAG(MineSweeper_Caches);
+		Snapshots.Invalidate();
+		Pyramid.Build(*Grid);
+
+		// Sized for the worst case up front, so nothing on the interaction path ever has to grow
+		RevealedTiles.reserve(Grid->Num());
+		FlaggedTiles.reserve(Grid->Num());
+		ChangedTiles.reserve(Grid->Num());
+		PreviewTiles.reserve(Grid->Num());
+		RingTiles.reserve(Grid->Num());
+		VisitedTiles.assign(Grid->Num(), false);
+	}
+	Perf.RecordGeneration(EMineSweeperGenerationPhase::Caches, PhaseStart);
+
+	if (!WindowRenderedHandle.IsValid() && FSlateApplication::IsInitialized() && FSlateApplication::Get().GetRenderer())
+	{
+		WindowRenderedHandle = FSlateApplication::Get().GetRenderer()->OnSlateWindowRendered().AddSP(this, &MineSweeperBoard::OnWindowRendered);
+	}
+
+	PhaseStart = FPlatformTime::Cycles64();
+	LLM_SCOPE_BYTAG(MineSweeper_Widgets);
+	// Input for the whole board follows the phase, rather than every button being switched off when the game ends
+	VerticalBox->SetEnabled(TAttribute<bool>::CreateSP(this, &MineSweeperBoard::IsPlaying));
+	if (!bUseButtons)
+	{
+		TSharedRef<SMineSweeperBoardView> NewView = SNew(SMineSweeperBoardView, AsShared());
+		View = NewView;
+		VerticalBox->AddSlot()
+			.AutoHeight()
+			[
+				NewView
+			];
+	}
+	for (int i = 0; bUseButtons && i < BoardHeight; i++)
 	{
 		// Create a new row for each height
-		TSharedRef<SHorizontalBox> Row = CreateRow(Width, i, Board);
+		TSharedRef<SHorizontalBox> Row = CreateRow(BoardWidth, i);
+		// The layers of a 3D board are stacked with a gap between them, so it's clear where one ends
+		const bool bNewLayer = i > 0 && i % Grid->GetHeight() == 0;
 		VerticalBox->AddSlot()
 			.AutoHeight()
+			.Padding(0.0f, bNewLayer ? 8.0f : 0.0f, 0.0f, 0.0f)
 			[
 				Row
 			];
 	}
-	StopGameTimer();
+	VerticalBox->SetVisibility(EVisibility::Visible);
+	Perf.RecordGeneration(EMineSweeperGenerationPhase::Widgets, PhaseStart);
 	StartGameTimer();
+
+	LastRefreshedBoard = AsShared();
+	const MineSweeperMemoryReport Report = GetMemoryReport();
+	UE_LOG(MineSweeperLog, Log, TEXT("%dx%d board (%s): %.2f MB, state %.2f, widgets %.2f, keys %.2f, caches %.2f"),
+		BoardWidth, BoardHeight, bUseButtons ? TEXT("buttons") : TEXT("board view"), ToMB(Report.GetTotal()),
+		ToMB(Report.StateBytes), ToMB(Report.WidgetBytes), ToMB(Report.KeyBytes), ToMB(Report.CacheBytes));
+}
+
+MineSweeperMemoryReport MineSweeperBoard::GetMemoryReport() const
+{
+	MineSweeperMemoryReport Report;
+	if (!Grid.IsValid())
+	{
+		return Report;
+	}
+	// The fixed size grids keep their arrays inline, which sizeof already counts
+	Report.StateBytes = Grid->GetAllocatedSize();
+	Report.KeyBytes = Tiles.GetAllocatedSize();
+	Report.WidgetBytes = bUseButtons ? Tiles.Num() * (WidgetBytesPerTile - 1) + TileLooks.capacity() + BoardHeight * sizeof(SHorizontalBox) : sizeof(SMineSweeperBoardView);
+	// Neighbor tables are shared between boards of the same shape, so it's every live table, ours included
+	Report.CacheBytes = Pyramid.GetAllocatedSize() + Snapshots.GetAllocatedSize() + VisitedTiles.capacity() / 8 + sizeof(MineSweeperPerfCounters)
+		+ (RevealedTiles.capacity() + FlaggedTiles.capacity() + ChangedTiles.capacity() + PreviewTiles.capacity() + RingTiles.capacity()) * sizeof(int32)
+		+ MineSweeperNeighborTable::GetCachedSize();
+	return Report;
+}
+
+MineSweeperMemoryReport MineSweeperBoard::EstimateMemory(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims, bool bWithButtons)
+{
+	const MineSweeperDimensions Clamped = { FMath::Max(Dims.Width, 0), FMath::Max(Dims.Height, 0), FMath::Max(Dims.Depth, 1) };
+	const SIZE_T NumTiles = SIZE_T(Clamped.Num());
+	const SIZE_T Rows = SIZE_T(Clamped.Height) * Clamped.Depth;
+	MineSweeperMemoryReport Report;
+	// The grid's planes and counts plus its flood fill and auto play scratch, the same terms the grid reports
+	Report.StateBytes = EstimateMineSweeperGridSize(Topology, Clamped);
+	Report.KeyBytes = bWithButtons ? NumTiles * sizeof(MineSweeperTile) : 0;
+	Report.WidgetBytes = bWithButtons ? NumTiles * WidgetBytesPerTile + Rows * sizeof(SHorizontalBox) : sizeof(SMineSweeperBoardView);
+	// Five scratch lists of tile indices and the visited bits, the pyramid (a third more than its 8x8 base level), a
+	// snapshot's pages (two bitplanes, in whole pages) plus its copy of the counts, and the neighbor table if the
+	// topology needs one
+	const SIZE_T NumPages = (NumTiles + MineSweeperSnapshot::PageTiles - 1) / MineSweeperSnapshot::PageTiles;
+	Report.CacheBytes = NumTiles * 5 * sizeof(int32) + NumTiles / 8
+		+ (NumTiles / 64 + 1) * sizeof(MineSweeperPyramid::Block) * 4 / 3
+		+ NumPages * (sizeof(MineSweeperSnapshot::Page) + sizeof(TSharedPtr<const MineSweeperSnapshot::Page, ESPMode::ThreadSafe>)) + NumTiles
+		+ sizeof(MineSweeperPerfCounters) + MineSweeperNeighborTable::EstimateAllocatedSize(Topology, Clamped);
+	return Report;
 }
+
 TSharedRef<SBox> MineSweeperBoard::GetVerticalBox()
 {
 	TSharedRef<SBox> BoardBox = SNew(SBox)
@@ -54,63 +335,49 @@ TSharedRef<SBox> MineSweeperBoard::GetVerticalBox()
 
 void MineSweeperBoard::StartGameTimer()
 {
-	GameStartTime = FPlatformTime::Seconds();
-	FTickerDelegate Delegate = FTickerDelegate::CreateLambda([&](float DeltaTime)
-		{
-			if (!FGlobalTabmanager::Get()->FindExistingLiveTab(FName("GameWindow")).IsValid())
-			{
-				// The delegate dosn't shutdown when we close the window, so we need to check if the game window is still open
-				GameOver();
-				return false;
-			}
-			long TimeElapsed = FPlatformTime::Seconds() - GameStartTime;
-			FTimespan TimeSpan = FTimespan::FromSeconds(TimeElapsed);
-			//UE_LOG(MineSweeperLog, Log, TEXT("Time: %ld"), TimeElapsed);
-			GameTimeText->SetText(FText::FromString(FString::Printf(TEXT("Time: %02d:%02d:%02d"), TimeSpan.GetHours(), TimeSpan.GetMinutes(), TimeSpan.GetSeconds())));
-
-			return true;
-		});
-	Handle = FTSTicker::GetCoreTicker().AddTicker(Delegate, 1.0f); // Delay of 1 second for each tick
-	
+	Clock->Start(GameTimeText);
 }
 
 void MineSweeperBoard::StopGameTimer()
 {
-		if (Handle.IsValid())
-		{
-			UE_LOG(MineSweeperLog, Log, TEXT("Stopping game timer"));
-			FTSTicker::GetCoreTicker().RemoveTicker(Handle);
-		}
+	Clock->Stop();
+}
+
+void MineSweeperBoard::SetPaused(bool bPaused)
+{
+	bPaused ? Clock->Pause() : Clock->Resume();
+	VerticalBox->SetVisibility(IsPaused() ? EVisibility::Hidden : EVisibility::Visible);
 }
 
-TSharedRef<SHorizontalBox> MineSweeperBoard::CreateRow(int Width, int Row, std::vector<std::vector<bool>> Board)
+TSharedRef<SHorizontalBox> MineSweeperBoard::CreateRow(int Width, int Row)
 {
-	const int RowIndex = Row; // Capture the current column index
 	TSharedRef<SHorizontalBox> HorizontalBox = SNew(SHorizontalBox);
+	if (Grid->GetTopology() == EMineSweeperTopology::Hex && (Row & 1) == 1)
+	{
+		// Odd rows of a hex board sit half a tile to the right, which is what makes the diagonals line up as neighbors
+		HorizontalBox->AddSlot()
+			.AutoWidth()
+			[
+				SNew(SSpacer)
+				.Size(FVector2D(HexRowShift, 1.0f))
+			];
+	}
 	for(int i = 0; i < Width; i++)
 	{
-		const int ColumnIndex = i; // Capture the current column index
+		const int32 Tile = Grid->ToTile(Row, i); // Everything from here on only needs the index
+		TSharedRef<STextBlock> Label = SNew(STextBlock)
+			.Text(GetHiddenText())
+			.ColorAndOpacity(FLinearColor::Gray);
 		// Create a button or widget for each cell in the row
 		TSharedRef<SButton> CellButton = SNew(SButton)
-			.Text(FText::FromString("+"))
 			.ForegroundColor(FLinearColor::Gray)
+			.ButtonColorAndOpacity_Lambda([this, Tile]() { return this->GetTileColor(Tile); })
 			// Decided to use on pressed and released because it's more flexible that just on clicked and we may want to do different things on pressed and released
-			.OnPressed_Lambda([=, this, RowIndex = RowIndex, ColumnIndex = ColumnIndex]() {
-			
-			for (const auto& Key : this->GetSurroundingTiles(RowIndex, ColumnIndex, 1))
-			{
-				TileState[Key]->Button->SetBorderBackgroundColor(FLinearColor::Blue);
-			}
-				
-				})
-			.OnReleased_Lambda([=, this, RowIndex = RowIndex, ColumnIndex = ColumnIndex]() {
-			for (const auto& Key : this->GetSurroundingTiles(RowIndex, ColumnIndex, 1))
-			{
-				TileState[Key]->Button->SetBorderBackgroundColor(FLinearColor::Gray);
-			}
-			this->RevealTile(RowIndex, ColumnIndex);
-				})
-			;
+			.OnPressed_Lambda([this, Tile]() { this->PressTile(Tile); })
+			.OnReleased_Lambda([this, Tile]() { this->ReleaseTile(Tile); })
+			[
+				Label
+			];
 
 		// The alternative to using OnPressed and OnReleased is to use OnClicked, but it doesn't allow for previewing the tile before clicking
 		//CellButton->SetOnClicked(
@@ -122,150 +389,358 @@ TSharedRef<SHorizontalBox> MineSweeperBoard::CreateRow(int Width, int Row, std::
 		//	)
 		//);
 
-		TileState.Add(MakeKey(RowIndex, ColumnIndex), MakeShared<MineSweeperTile>(MineSweeperTile(RowIndex, ColumnIndex, CellButton, Board[RowIndex][ColumnIndex])));
+		Tiles.Add({ CellButton, Label });
 
+		// SButton only handles the left mouse button, so a right click bubbles up to this border and becomes a flag
 		HorizontalBox->AddSlot()
 			.AutoWidth()
 			[
-				CellButton
+				SNew(SBorder)
+				.BorderImage(FCoreStyle::Get().GetBrush("NoBorder"))
+				.Padding(0.0f)
+				.OnMouseButtonDown_Lambda([this, Tile](const FGeometry&, const FPointerEvent& MouseEvent) -> FReply
+					{
+						if (MouseEvent.GetEffectingButton() != EKeys::RightMouseButton)
+						{
+							return FReply::Unhandled();
+						}
+						this->ToggleFlag(Tile);
+						return FReply::Handled();
+					})
+				[
+					CellButton
+				]
 			];
 	}
 	return HorizontalBox;
 }
 
-void MineSweeperBoard::RevealTile(int Row, int Column)
+void MineSweeperBoard::PressTile(int32 Tile)
 {
-	TSharedRef < MineSweeperTile> Tile = *TileState.Find(MakeKey(Row, Column));
-	if(!Tile->bIsMine)
+	if (!IsPlaying())
+	{
+		return;
+	}
+	InputCycles = InputCycles != 0 ? InputCycles : FPlatformTime::Cycles64();
+	GetSurroundingTiles(Tile, 1, PreviewTiles);
+	for (int32 Preview : PreviewTiles)
 	{
-		int MineCount = SetTileRevealed(Row, Column);
-		
-		if(MineCount == 0)
+		PreviewTile(Preview, true);
+	}
+}
+
+void MineSweeperBoard::ReleaseTile(int32 Tile)
+{
+	if (IsPlaying())
+	{
+		InputCycles = InputCycles != 0 ? InputCycles : FPlatformTime::Cycles64();
+	}
+	for (int32 Preview : PreviewTiles)
+	{
+		PreviewTile(Preview, false);
+	}
+	PreviewTiles.clear();
+	RevealTile(Tile);
+}
+
+void MineSweeperBoard::RevealTile(int32 Tile)
+{
+	if (!IsPlaying() || Grid->IsFlagged(Tile))
+	{
+		return;
+	}
+	const uint64 StartCycles = InputCycles != 0 ? InputCycles : FPlatformTime::Cycles64();
+	const MineSweeperPerfMove::EKind Kind = Grid->IsRevealed(Tile) ? MineSweeperPerfMove::EKind::Chord : MineSweeperPerfMove::EKind::Reveal;
+	RevealedTiles.clear();
+	FlaggedTiles.clear();
+	if (Kind == MineSweeperPerfMove::EKind::Chord)
+	{
+		// Clicking a number again chords it, which does nothing unless all of its flags are down
+		Grid->Chord(Tile, RevealedTiles);
+	}
+	else
+	{
+		if (bFirstClick && FirstClickSafety != EFirstClickSafety::None)
 		{
-			TSet<FString> Safe;
-			TSet<FString> Checked;
-			Safe = GetSurroundingSafeTiles(Row, Column, Checked);
-			for (const auto& Key : Safe)
+			// Nothing is on screen yet, so the mines can move without any repainting
+			int32 Moves[2 * (MineSweeperGrid::MaxNeighbors + 1)];
+			const int32 NumMoved = Grid->RelocateMinesAround(Tile, FirstClickSafety == EFirstClickSafety::Opening, FirstClickStream, Moves);
+			for (int32 i = 0; i < NumMoved; i++)
+			{
+				Pyramid.OnMineMoved(Moves[i * 2], Moves[i * 2 + 1]);
+			}
+			if (NumMoved > 0)
 			{
-				
-				int RowIndex, ColumnIndex;
-				SplitKey(Key, RowIndex, ColumnIndex);
-				SetTileRevealed(RowIndex, ColumnIndex);
+				Snapshots.Invalidate(); // The counts changed, so anything worked out before this is about a different board
 			}
 		}
-		if(GetUnrevealedTiles().Num() == 0)
+		bFirstClick = false;
+		Grid->Reveal(Tile, RevealedTiles);
+	}
+	ChangedTiles = RevealedTiles;
+	FinishMove(Kind, Tile, StartCycles);
+}
+
+void MineSweeperBoard::ToggleFlag(int32 Tile)
+{
+	if (!IsPlaying())
+	{
+		return;
+	}
+	// Only stamped once the flag has actually changed, so a click on a revealed tile doesn't time the next paint
+	const uint64 StartCycles = InputCycles != 0 ? InputCycles : FPlatformTime::Cycles64();
+	if (!Grid->ToggleFlag(Tile))
+	{
+		return;
+	}
+	InputCycles = StartCycles;
+	RevealedTiles.clear();
+	FlaggedTiles.clear();
+	SetTileFlagged(Tile, Grid->IsFlagged(Tile));
+	Pyramid.OnFlagChanged(Tile, Grid->IsFlagged(Tile));
+	ChangedTiles.assign(1, Tile);
+	Snapshots.MarkDirty(ChangedTiles);
+	FinishMove(MineSweeperPerfMove::EKind::Flag, Tile, InputCycles);
+}
+
+void MineSweeperBoard::FinishMove(MineSweeperPerfMove::EKind Kind, int32 Tile, uint64 StartCycles)
+{
+	if (bAutoFlag || bAutoReveal)
+	{
+		Grid->AutoPlay(ChangedTiles, bAutoFlag, bAutoReveal, RevealedTiles, FlaggedTiles);
+	}
+	Snapshots.MarkDirty(RevealedTiles);
+	Snapshots.MarkDirty(FlaggedTiles);
+	Pyramid.OnRevealed(RevealedTiles);
+	for (int32 Flagged : FlaggedTiles)
+	{
+		Pyramid.OnFlagChanged(Flagged, true);
+	}
+	if (!RevealedTiles.empty() || !FlaggedTiles.empty())
+	{
+		ShownHint = MineSweeperHint(); // Whatever the hint pointed at may have just been played
+	}
+	RepaintView();
+	bool bHitMine = false;
+	for (int32 Revealed : RevealedTiles)
+	{
+		SetTileRevealed(Revealed);
+		bHitMine |= Grid->IsMine(Revealed);
+	}
+	for (int32 Flagged : FlaggedTiles)
+	{
+		SetTileFlagged(Flagged, true);
+	}
+	// Before the game over, so its repaint and any dialog aren't counted as part of the move
+	Perf.RecordMove(Kind, Tile, int32(RevealedTiles.size() + FlaggedTiles.size()), StartCycles);
+	if (bHitMine)
+	{
+		GameOver(EMineSweeperPhase::Lost);
+		UE_LOG(MineSweeperLog, Log, TEXT("You Lost!"));
+		if (bShowResultDialog)
+		{
+			FText WinText = FText::FromString(TEXT("You Lost!"));
+			FMessageDialog::Open(EAppMsgType::Ok, WinText);
+		}
+	}
+	else if (!RevealedTiles.empty() && Grid->GetRemainingSafeTiles() == 0)
+	{
+		GameOver(EMineSweeperPhase::Won);
+		UE_LOG(MineSweeperLog, Log, TEXT("You Win!"));
+		if (bShowResultDialog)
 		{
-			GameOver();
-			UE_LOG(MineSweeperLog, Log, TEXT("You Win!"));
 			FText WinText = FText::FromString(TEXT("You Win!"));
 			FMessageDialog::Open(EAppMsgType::Ok, WinText);
-			
 		}
 	}
-	else
+}
+
+void MineSweeperBoard::GameOver(EMineSweeperPhase EndPhase)
+{
+	StopGameTimer();
+	Phase = EndPhase;
+	// The buttons and the view both read the phase when they paint, so all that's left is asking for that paint
+	VerticalBox->Invalidate(EInvalidateWidgetReason::Paint);
+	if (bUseButtons)
 	{
-		GameOver();
-		UE_LOG(MineSweeperLog, Log, TEXT("You Lost!"));
-		FText WinText = FText::FromString(TEXT("You Lost!"));
-		FMessageDialog::Open(EAppMsgType::Ok, WinText);
-		
+		Perf.RecordWidgetUpdates(Tiles.Num());
+	}
+	RepaintView();
+	OnGameOver.Broadcast(Phase);
+}
+
+FSlateColor MineSweeperBoard::GetTileColor(int32 Tile) const
+{
+	if (!IsPlaying())
+	{
+		return Grid->IsMine(Tile) ? FLinearColor::Red : FLinearColor::Green;
+	}
+	switch (TileLooks[Tile])
+	{
+	case ETileLook::Preview:
+		return FLinearColor::Blue;
+	case ETileLook::Revealed:
+		return Grid->IsMine(Tile) ? FLinearColor::Red : FLinearColor::Green;
+	case ETileLook::Flagged:
+		return FLinearColor(1.0f, 0.5f, 0.0f);
+	case ETileLook::HintSafe:
+		return FLinearColor::Yellow;
+	case ETileLook::HintMine:
+		return FLinearColor(0.6f, 0.0f, 0.8f);
+	default:
+		return FLinearColor::Gray;
+	}
+}
+
+void MineSweeperBoard::RepaintView()
+{
+	if (TSharedPtr<SMineSweeperBoardView> PinnedView = View.Pin())
+	{
+		PinnedView->Invalidate(EInvalidateWidgetReason::Paint);
+		Perf.RecordWidgetUpdates(1);
 	}
 }
 
-int MineSweeperBoard::SetTileRevealed(int Row, int Column)
+int MineSweeperBoard::SetTileRevealed(int32 Tile)
 {
-	TSharedRef < MineSweeperTile> Tile = *TileState.Find(MakeKey(Row, Column));
-	int MineCount = GetSurroundingTiles(Row, Column, 1).Array().FilterByPredicate([this](const FString& Key) {
-		return TileState.Find(Key)->Get().bIsMine;
-		}).Num();
-	Tile->bIsRevealed = true;
-	Tile->Button->SetBorderBackgroundColor(Tile->bIsMine ? FLinearColor::Red :FLinearColor::Green);
-	Tile->Button->SetContent(
-		SNew(STextBlock)
-		.Text(FText::FromString(FString::FromInt(MineCount)))
-		.ColorAndOpacity(FLinearColor::White)
-	);
+	const int32 MineCount = Grid->GetAdjacentMines(Tile);
+	if (!bUseButtons)
+	{
+		return MineCount; // The view reads the grid when it paints
+	}
+	const MineSweeperTile& Widgets = Tiles[Tile];
+	TileLooks[Tile] = ETileLook::Revealed;
+	Widgets.Label->SetText(GetNumberText(MineCount));
+	Widgets.Label->SetColorAndOpacity(FLinearColor::White);
+	Perf.RecordWidgetUpdates(2); // The label, and the button through its color lambda
 	if (MineCount == 0)
 	{
-		Tile->Button->SetEnabled(false);
+		Widgets.Button->SetEnabled(false);
 	}
 	return MineCount;
 }
 
-void MineSweeperBoard::PreviewTile(int row, int column, bool bPreview)
+void MineSweeperBoard::SetTileFlagged(int32 Tile, bool bFlagged)
+{
+	if (!bUseButtons)
+	{
+		return;
+	}
+	const MineSweeperTile& Widgets = Tiles[Tile];
+	TileLooks[Tile] = bFlagged ? ETileLook::Flagged : ETileLook::Hidden;
+	Widgets.Label->SetText(bFlagged ? GetFlagText() : GetHiddenText());
+	Widgets.Label->SetColorAndOpacity(bFlagged ? FLinearColor::White : FLinearColor::Gray);
+	Perf.RecordWidgetUpdates(2);
+}
+
+void MineSweeperBoard::RequestHint()
+{
+	if (!Grid.IsValid() || bFirstClick)
+	{
+		return; // Nothing to work anything out from yet
+	}
+	MineSweeperSnapshotRef Snapshot = Snapshots.Publish(*Grid);
+	Async(EAsyncExecution::ThreadPool, [WeakBoard = AsWeak(), Snapshot]()
+		{
+			const MineSweeperHint Hint = MineSweeperAnalysis::FindHint(*Snapshot);
+			AsyncTask(ENamedThreads::GameThread, [WeakBoard, Hint]()
+				{
+					if (TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board = WeakBoard.Pin())
+					{
+						Board->ShowHint(Hint);
+					}
+				});
+		});
+}
+
+void MineSweeperBoard::ShowHint(const MineSweeperHint& Hint)
+{
+	// Nothing has happened since if the version matches, otherwise the hint has to still hold on the board as it is now
+	if (Hint.Version != Snapshots.GetVersion() && !Hint.CanRebase(*Grid, Snapshots.GetGameId()))
+	{
+		UE_LOG(MineSweeperLog, Verbose, TEXT("Dropping a hint from version %llu, the board is on %llu"), Hint.Version, Snapshots.GetVersion());
+		return;
+	}
+	if (!Hint.IsValid())
+	{
+		UE_LOG(MineSweeperLog, Log, TEXT("No hint, nothing can be worked out from what's revealed"));
+		return;
+	}
+	ShownHint = Hint;
+	if (!bUseButtons)
+	{
+		RepaintView();
+		return;
+	}
+	TileLooks[Hint.Tile] = Hint.bIsMine ? ETileLook::HintMine : ETileLook::HintSafe;
+	Perf.RecordWidgetUpdates(1);
+}
+
+void MineSweeperBoard::PreviewTile(int32 Tile, bool bPreview)
 {
-	TSharedRef < MineSweeperTile> Tile = *TileState.Find(MakeKey(row, column));
-	if (!Tile->bIsRevealed)
+	if (bUseButtons && !Grid->IsRevealed(Tile) && !Grid->IsFlagged(Tile))
 	{
-		FLinearColor Color = bPreview ? FLinearColor::Blue : FLinearColor::Gray;
-		Tile->Button->SetBorderBackgroundColor(Color);
+		TileLooks[Tile] = bPreview ? ETileLook::Preview : ETileLook::Hidden;
+		Perf.RecordWidgetUpdates(1);
 	}
 }
 
-TSet<FString> MineSweeperBoard::GetSurroundingTiles(int Row, int Column, int Rings)
+int32 MineSweeperBoard::GetSurroundingTiles(int32 Tile, int32 Rings, std::vector<int32>& OutTiles)
 {
 	/*
-	* As we're essentially USING a 2D array, we need to ensure that we don't go out of bounds, So we're clamping with min and max functions.
+	* The grid knows which tiles are next to each other, so we just walk outwards from the center one ring at a time.
+	* RingTiles holds every tile we've reached in the order we reached them, so each ring is just the stretch of it
+	* added by the ring before, and the visited flags get cleared from it afterwards instead of clearing the whole board.
 	*/
-	int MinRow = FMath::Max(0, Row - Rings);
-	int MaxRow = FMath::Min(Row + Rings, BoardHeight - 1);
-	int MinColumn = FMath::Max(0, Column - Rings);
-	int MaxColumn = FMath::Min(Column + Rings, BoardWidth - 1);
-	TSet<FString> AllTiles;
-	for (int i = MinRow; i <= MaxRow; i++) {
-		
-		for (int j = MinColumn; j <= MaxColumn; j++) {
-			// Iterate through each child in the row
-			// Check if the child is a button or widget you want to add
-			
-			if(i != Row || j != Column) // Exclude the center tile
+	OutTiles.clear();
+	RingTiles.clear();
+	RingTiles.push_back(Tile);
+	VisitedTiles[Tile] = true;
+	size_t RingStart = 0;
+	int32 Neighbors[MineSweeperGrid::MaxNeighbors];
+	for (int32 Depth = 0; Depth < Rings; Depth++)
+	{
+		const size_t RingEnd = RingTiles.size();
+		for (size_t i = RingStart; i < RingEnd; i++)
+		{
+			const int32 NumNeighbors = Grid->GetNeighbors(RingTiles[i], Neighbors);
+			for (int32 j = 0; j < NumNeighbors; j++)
 			{
-				FString Key = MakeKey(i, j);
-				TSharedRef<MineSweeperTile> Tile = *TileState.Find(Key);
-				if(!Tile->bIsRevealed)
+				if (VisitedTiles[Neighbors[j]])
 				{
-					AllTiles.Add(Key);
+					continue;
+				}
+				VisitedTiles[Neighbors[j]] = true;
+				RingTiles.push_back(Neighbors[j]);
+				if (!Grid->IsRevealed(Neighbors[j]) && !Grid->IsFlagged(Neighbors[j]))
+				{
+					OutTiles.push_back(Neighbors[j]);
 				}
 			}
 		}
+		RingStart = RingEnd;
 	}
-	// I prefer using sets for this because they are unique and we don't have to worry about duplicates.
-		
-	return AllTiles;
-
+	for (int32 Visited : RingTiles)
+	{
+		VisitedTiles[Visited] = false;
+	}
+	return int32(OutTiles.size());
 }
 
-TSet<FString> MineSweeperBoard::GetSurroundingSafeTiles(int Row, int Column, TSet<FString> &Checked)
+void MineSweeperBoard::OnWindowRendered(SWindow& Window, void* ViewportRHIPtr)
 {
-	TSet<FString> Found;
-	FString MyKey = MakeKey(Row, Column);
-	if (Checked.Contains(MyKey) || TileState.Find(MyKey)->Get().bIsMine)
+	// The first window Slate renders after the input, which in practice is the one the board is in
+	if (InputCycles == 0)
 	{
-		return TSet<FString>(); // Return early if already checked or revealed
+		return;
 	}
-	Found.Add(MyKey);
-	Checked.Add(MyKey);
-	int MineCount = GetSurroundingTiles(Row, Column, 1).Array().FilterByPredicate([this](const FString& Key) {
-		return TileState.Find(Key)->Get().bIsMine;
-		}).Num();
-	if (MineCount == 0)
+	InputLatency.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - InputCycles));
+	Perf.RecordPaint(InputLatency.LastMs);
+	InputCycles = 0;
+	UE_LOG(MineSweeperLog, Verbose, TEXT("Input to paint %.2f ms"), InputLatency.LastMs);
+	if (InputLatency.Num % 100 == 0)
 	{
-
-		//RevealTile(Row, Column);
-		TArray<FString> Array = GetSurroundingTiles(Row, Column, 1).Array().FilterByPredicate([this, Checked](const FString& Key) {
-				return !TileState.Find(Key)->Get().bIsMine && !Checked.Contains(Key);
-				});
-			
-		for (const FString& Key : Array)
-		{
-			if (!Checked.Contains(Key))
-			{
-				int NextRow, NextColumn;
-				SplitKey(Key, NextRow, NextColumn);
-				Found = Found.Union(GetSurroundingSafeTiles(NextRow, NextColumn, Checked));
-			}
-		}
-	} 
-	return Found;
+		UE_LOG(MineSweeperLog, Log, TEXT("Input to paint over %d inputs on %dx%d: avg %.2f ms, max %.2f ms"),
+			InputLatency.Num, BoardWidth, BoardHeight, InputLatency.GetAverageMs(), InputLatency.MaxMs);
+	}
 }
-
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperBoardPool.h"
+#include "MineSweeperBoard.h"
+#include "MineSweeperNativeGenerator.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+static TAutoConsoleVariable<int32> CVarBoardPoolSize(
+	TEXT("MineSweeper.Pool.Size"),
+	4,
+	TEXT("How many boards to keep generated ahead of time for the current settings. 0 turns the pool off."));
+
+static TAutoConsoleVariable<int32> CVarBoardPoolMemoryCapMB(
+	TEXT("MineSweeper.Pool.MemoryCapMB"),
+	64,
+	TEXT("Most memory the pre-generated boards may use, in megabytes. Boards in flight count towards it."));
+
+MineSweeperBoardPool::MineSweeperBoardPool()
+	: SeedStream(FMath::Rand())
+{
+}
+
+void MineSweeperBoardPool::SetSettings(const MineSweeperBoardSettings& InSettings)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		SetSettingsLocked(InSettings);
+	}
+	Refill();
+}
+
+void MineSweeperBoardPool::SetSettingsLocked(const MineSweeperBoardSettings& InSettings)
+{
+	if (Settings == InSettings)
+	{
+		return;
+	}
+	if (Settings.GeneratorLibrary != InSettings.GeneratorLibrary)
+	{
+		NativeGenerator = InSettings.GeneratorLibrary.IsEmpty() ? nullptr : NativeBoardGenerator::Load(InSettings.GeneratorLibrary);
+	}
+	Settings = InSettings;
+	Generation++;
+	Ready.Reset();
+	ReadyBytes = 0;
+	BytesPerBoard = 0;
+}
+
+TSharedPtr<MineSweeperGrid> MineSweeperBoardPool::Pop(const MineSweeperBoardSettings& InSettings)
+{
+	TSharedPtr<MineSweeperGrid> Result;
+	{
+		FScopeLock ScopeLock(&Lock);
+		SetSettingsLocked(InSettings);
+		if (Ready.Num() > 0)
+		{
+			Result = Ready.Pop(EAllowShrinking::No);
+			ReadyBytes -= Result->GetAllocatedSize();
+		}
+	}
+	Refill();
+	return Result;
+}
+
+int32 MineSweeperBoardPool::NumReady() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Ready.Num();
+}
+
+SIZE_T MineSweeperBoardPool::GetReadyBytes() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return ReadyBytes;
+}
+
+void MineSweeperBoardPool::Refill()
+{
+	const int32 TargetSize = FMath::Max(0, CVarBoardPoolSize.GetValueOnAnyThread());
+	const SIZE_T MemoryCap = SIZE_T(FMath::Max(0, CVarBoardPoolMemoryCapMB.GetValueOnAnyThread())) * 1024 * 1024;
+
+	FScopeLock ScopeLock(&Lock);
+	const MineSweeperDimensions Dims = Settings.GetDimensions();
+	if (Dims.Width <= 0 || Dims.Height <= 0 || Dims.Depth <= 0 || Settings.NumMines >= Dims.Num())
+	{
+		return; // The generator would never finish placing the mines, and we don't want that stuck on a worker
+	}
+	// Until we've made one board for these settings, go by what the grid will report once it's made
+	const SIZE_T EstimatedBytes = BytesPerBoard > 0 ? BytesPerBoard : EstimateMineSweeperGridSize(Settings.Topology, Dims);
+	while (Ready.Num() + InFlight < TargetSize && ReadyBytes + (InFlight + 1) * EstimatedBytes <= MemoryCap)
+	{
+		InFlight++;
+		const MineSweeperBoardSettings ForSettings = Settings;
+		const uint32 ForGeneration = Generation;
+		// A seeded board is the same every time, so only unseeded boards draw a fresh seed
+		const int32 BoardSeed = Settings.bUseSeed ? Settings.Seed : int32(SeedStream.GetUnsignedInt());
+		Async(EAsyncExecution::ThreadPool, [WeakPool = AsWeak(), ForSettings, ForGeneration, BoardSeed, ForNative = NativeGenerator]()
+			{
+				TSharedPtr<MineSweeperBoardPool, ESPMode::ThreadSafe> Pool = WeakPool.Pin();
+				if (!Pool.IsValid())
+				{
+					return;
+				}
+				LLM_SCOPE_BYTAG(MineSweeper_State);
+				const MineSweeperDimensions ForDims = ForSettings.GetDimensions();
+				TSharedRef<MineSweeperGrid> NewGrid = MakeMineSweeperGrid(ForSettings.Topology, ForDims);
+				// Generators only know about rows, so the layers of a 3D board go one after another down them
+				if (ForNative.IsValid())
+				{
+					FScopeLock GeneratorScopeLock(&Pool->GeneratorLock);
+					ForNative->SetSeed(true, BoardSeed);
+					NewGrid->SetMines(ForNative->Generate(ForDims.Width, ForDims.Height * ForDims.Depth, ForSettings.NumMines));
+				}
+				else
+				{
+					RandomBoardGenerator Generator(true, BoardSeed);
+					NewGrid->SetMines(Generator.Generate(ForDims.Width, ForDims.Height * ForDims.Depth, ForSettings.NumMines));
+				}
+				Pool->OnGenerated(ForGeneration, NewGrid);
+			});
+	}
+}
+
+void MineSweeperBoardPool::OnGenerated(uint32 ForGeneration, TSharedRef<MineSweeperGrid> NewGrid)
+{
+	bool bStale = false;
+	{
+		FScopeLock ScopeLock(&Lock);
+		InFlight--;
+		bStale = ForGeneration != Generation;
+		if (!bStale)
+		{
+			BytesPerBoard = NewGrid->GetAllocatedSize();
+			Ready.Add(NewGrid);
+			ReadyBytes += BytesPerBoard;
+		}
+	}
+	if (bStale)
+	{
+		// The stale board was holding a slot, so the current settings may be short one now
+		Refill();
+	}
+}
@@ -0,0 +1,567 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperBot.h"
+#include "Async/Async.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarBotPaceMs(
+	TEXT("MineSweeper.Bot.PaceMs"),
+	150.0f,
+	TEXT("How long a bot playing the board in the GameWindow tab waits before each move, in milliseconds. Headless bots never wait."));
+
+/**
+* A grid of its own, played on its shard's thread. Moves happen straight away, and then the bot goes to the back of the
+* shard's queue so every other bot on the shard gets a move before it gets another.
+*/
+class HeadlessBotTable : public MineSweeperBotTable
+{
+public:
+	HeadlessBotTable(MineSweeperBotScheduler& InScheduler, MineSweeperBotScheduler::Shard& InShard)
+		: MineSweeperBotTable(InScheduler)
+		, OwnShard(InShard)
+		, Grid(MakeMineSweeperGrid(30, 16)) // Expert and empty until the first NewGame
+	{
+	}
+
+protected:
+	const MineSweeperGrid& GetGrid() const override { return *Grid; }
+
+	void Run(std::coroutine_handle<> Handle) override
+	{
+		switch (Pending.Op)
+		{
+		case EOp::NewGame:
+			StartGame();
+			break;
+		case EOp::Reveal:
+			RevealTile(Pending.Arg);
+			OwnShard.NumMoves.fetch_add(1, std::memory_order_relaxed);
+			break;
+		case EOp::Flag:
+			LastMove.NumChanged = IsPlaying(Pending.Arg) && Grid->ToggleFlag(Pending.Arg) ? 1 : 0;
+			OwnShard.NumMoves.fetch_add(1, std::memory_order_relaxed);
+			break;
+		default:
+			LastMove.NumChanged = 0;
+			break;
+		}
+		// Already on the shard's thread, which drains its queue before it sleeps, so there's nobody to wake
+		OwnShard.Ready.Enqueue(Handle);
+	}
+
+	void Post(std::coroutine_handle<> Handle) override
+	{
+		OwnShard.Ready.Enqueue(Handle);
+		OwnShard.Wake->Trigger();
+	}
+
+private:
+	bool IsPlaying(int32 Tile) const
+	{
+		return LastMove.Phase == EMineSweeperPhase::Playing && Tile >= 0 && Tile < Grid->Num();
+	}
+
+	void StartGame()
+	{
+		const int32 Width = Pending.Width > 0 ? Pending.Width : Grid->GetWidth();
+		const int32 Height = Pending.Width > 0 ? Pending.Height : Grid->GetHeight();
+		const int32 NumMines = FMath::Clamp(Pending.Width > 0 ? Pending.NumMines : Grid->GetNumMines(), 0, Width * Height - 1);
+		LLM_SCOPE_BYTAG(MineSweeper_State);
+		if (Width != Grid->GetWidth() || Height != Grid->GetHeight())
+		{
+			Grid = MakeMineSweeperGrid(Width, Height);
+		}
+		// Same placement as a seeded game on the server, so a game a bot lost can be replayed there. Mines never move on the
+		// first click here, so the editor only plays the same game with first click safety off.
+		RandomBoardGenerator Generator(true, Pending.Arg);
+		Grid->SetMines(Generator.Generate(Width, Height, NumMines));
+		RevealedTiles.reserve(Grid->Num());
+		LastMove = MineSweeperBotMove();
+	}
+
+	void RevealTile(int32 Tile)
+	{
+		LastMove.NumChanged = 0;
+		if (!IsPlaying(Tile) || Grid->IsFlagged(Tile))
+		{
+			return;
+		}
+		RevealedTiles.clear();
+		Grid->IsRevealed(Tile) ? Grid->Chord(Tile, RevealedTiles) : Grid->Reveal(Tile, RevealedTiles);
+		bool bHitMine = false;
+		for (int32 Revealed : RevealedTiles)
+		{
+			bHitMine |= Grid->IsMine(Revealed);
+		}
+		LastMove.NumChanged = int32(RevealedTiles.size());
+		if (bHitMine || Grid->GetRemainingSafeTiles() == 0)
+		{
+			LastMove.Phase = bHitMine ? EMineSweeperPhase::Lost : EMineSweeperPhase::Won;
+		}
+	}
+
+	MineSweeperBotScheduler::Shard& OwnShard;
+	TSharedRef<MineSweeperGrid> Grid;
+	std::vector<int32> RevealedTiles;
+};
+
+/**
+* Plays a MineSweeperBoard through the same calls its buttons make, on the game thread, a move every
+* MineSweeper.Bot.PaceMs. The bot is resumed from a core ticker rather than from inside the board, so it never makes a
+* move while the board is still in the middle of the last one.
+*/
+class EditorBotTable : public MineSweeperBotTable
+{
+public:
+	EditorBotTable(MineSweeperBotScheduler& InScheduler, TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> InBoard)
+		: MineSweeperBotTable(InScheduler)
+		, Board(InBoard)
+		, Grid(InBoard->GetGrid())
+	{
+		if (!Grid.IsValid())
+		{
+			Grid = MakeMineSweeperGrid(9, 9);
+		}
+		LastMove.Phase = InBoard->GetPhase();
+		InBoard->bShowResultDialog = false; // A dialog would stop the bot until someone closed it
+	}
+
+	~EditorBotTable()
+	{
+		if (TickerHandle.IsValid())
+		{
+			FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		}
+		if (TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Pinned = Board.Pin())
+		{
+			Pinned->OnGameOver.Remove(GameOverHandle);
+			Pinned->bShowResultDialog = true;
+		}
+	}
+
+protected:
+	const MineSweeperGrid& GetGrid() const override { return *Grid; }
+
+	void Run(std::coroutine_handle<> Handle) override
+	{
+		TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Pinned = Board.Pin();
+		if (Pending.Op == EOp::WaitForGameOver && Pinned.IsValid() && !Pinned->IsGameOver())
+		{
+			// Nothing to do until the board says so, whoever ends up finishing the game
+			Waiting = Handle;
+			GameOverHandle = Pinned->OnGameOver.AddRaw(this, &EditorBotTable::OnGameOver);
+			return;
+		}
+		Schedule(Handle, Pending.Op != EOp::WaitForGameOver, CVarBotPaceMs.GetValueOnGameThread() / 1000.0f);
+	}
+
+	void Post(std::coroutine_handle<> Handle) override
+	{
+		Schedule(Handle, false, 0.0f);
+	}
+
+private:
+	void Schedule(std::coroutine_handle<> Handle, bool bInPerformPending, float Delay)
+	{
+		Waiting = Handle;
+		bPerformPending = bInPerformPending;
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &EditorBotTable::Tick), Delay);
+	}
+
+	void OnGameOver(EMineSweeperPhase Phase)
+	{
+		if (TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Pinned = Board.Pin())
+		{
+			Pinned->OnGameOver.Remove(GameOverHandle);
+		}
+		GameOverHandle.Reset();
+		LastMove = { 0, Phase };
+		Schedule(Waiting, false, 0.0f);
+	}
+
+	bool Tick(float DeltaTime)
+	{
+		// One shot, the bot's next move adds the next one
+		TickerHandle.Reset();
+		TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Pinned = Board.Pin();
+		if (!Pinned.IsValid() || !Pinned->GetGrid().IsValid())
+		{
+			UE_LOG(MineSweeperLog, Warning, TEXT("The board a bot was playing has gone, stopping the bot"));
+			Abandon();
+			return false;
+		}
+		if (ReleasePending != INDEX_NONE)
+		{
+			Release(*Pinned);
+		}
+		else if (bPerformPending && !Perform(*Pinned))
+		{
+			// Pressed but not released, so the preview gets a frame to paint before the bot lets go
+			Schedule(Waiting, false, 0.0f);
+			return false;
+		}
+		Grid = Pinned->GetGrid();
+		LastMove.Phase = Pinned->GetPhase();
+		std::coroutine_handle<> Handle = Waiting;
+		Waiting = nullptr;
+		Handle.resume();
+		return false;
+	}
+
+	/** Returns false if the move is a press that still has to be released on the next tick */
+	bool Perform(MineSweeperBoard& Pinned)
+	{
+		const MineSweeperGrid& Current = *Pinned.GetGrid();
+		const int32 Tile = Pending.Arg;
+		LastMove.NumChanged = 0;
+		if (Pending.Op == EOp::NewGame)
+		{
+			// Keeping the size keeps the shape too, so a bot can play whatever board the player set up
+			const bool bSameSize = Pending.Width <= 0;
+			const EMineSweeperTopology Topology = bSameSize ? Current.GetTopology() : EMineSweeperTopology::Square;
+			const MineSweeperDimensions Dims = bSameSize ? MineSweeperDimensions{ Current.GetWidth(), Current.GetHeight(), Current.GetDepth() }
+				: MineSweeperDimensions{ Pending.Width, Pending.Height, 1 };
+			Pinned.RefreshBoard(Topology, Dims, bSameSize ? Current.GetNumMines() : Pending.NumMines, MakeShared<RandomBoardGenerator>(true, Pending.Arg), Pending.Arg);
+		}
+		else if (!Pinned.IsGameOver() && Tile >= 0 && Tile < Current.Num())
+		{
+			Scheduler.NumEditorMoves.fetch_add(1, std::memory_order_relaxed);
+			if (Pending.Op == EOp::Flag)
+			{
+				const bool bWasFlagged = Current.IsFlagged(Tile);
+				Pinned.ToggleFlag(Tile);
+				LastMove.NumChanged = bWasFlagged != Current.IsFlagged(Tile) ? 1 : 0;
+			}
+			else
+			{
+				// Pressed now and released next tick, so the preview shows the same as it would for a person
+				Pinned.PressTile(Tile);
+				ReleasePending = Tile;
+				PressedGrid = Pinned.GetGrid().Get();
+				RevealedBefore = Current.Num() - Current.GetNumMines() - Current.GetRemainingSafeTiles();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Release(MineSweeperBoard& Pinned)
+	{
+		const int32 Tile = ReleasePending;
+		ReleasePending = INDEX_NONE;
+		if (Pinned.GetGrid().Get() != PressedGrid)
+		{
+			return; // Someone started a new game in between, which leaves nothing to let go of
+		}
+		Pinned.ReleaseTile(Tile);
+		const MineSweeperGrid& After = *Pinned.GetGrid();
+		LastMove.NumChanged = After.Num() - After.GetNumMines() - After.GetRemainingSafeTiles() - RevealedBefore
+			+ (Pinned.GetPhase() == EMineSweeperPhase::Lost ? 1 : 0);
+	}
+
+	TWeakPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board;
+	TSharedPtr<const MineSweeperGrid> Grid; // The board's grid as of the last resume, held so a refresh can't pull it out from under a bot
+	std::coroutine_handle<> Waiting;
+	bool bPerformPending = false;
+	int32 ReleasePending = INDEX_NONE; // The tile pressed last tick, if the bot hasn't let go of it yet
+	const MineSweeperGrid* PressedGrid = nullptr; // Only compared, to tell whether the board was refreshed in between
+	int32 RevealedBefore = 0;
+	FTSTicker::FDelegateHandle TickerHandle;
+	FDelegateHandle GameOverHandle;
+};
+
+MineSweeperBot::~MineSweeperBot()
+{
+	if (Handle)
+	{
+		Handle.destroy(); // Never spawned
+	}
+}
+
+void MineSweeperBot::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> Handle) noexcept
+{
+	MineSweeperBotTable& Table = *Handle.promise().Table;
+	Handle.destroy();
+	Table.OnBotFinished();
+}
+
+MineSweeperBotTable::~MineSweeperBotTable()
+{
+	Abandon();
+}
+
+void MineSweeperBotTable::OnBotFinished()
+{
+	Bot = nullptr;
+	Scheduler.NumRunning.fetch_sub(1, std::memory_order_release);
+}
+
+void MineSweeperBotTable::Abandon()
+{
+	if (Bot)
+	{
+		Bot.destroy();
+		OnBotFinished();
+	}
+}
+
+MineSweeperBotScheduler::~MineSweeperBotScheduler()
+{
+	Stop();
+}
+
+void MineSweeperBotScheduler::Start(int32 NumThreads)
+{
+	Stop();
+	bStopShards = false;
+	NumThreads = NumThreads > 0 ? NumThreads : FPlatformMisc::NumberOfCores();
+	for (int32 Index = 0; Index < NumThreads; Index++)
+	{
+		Shard& NewShard = *Shards.Add_GetRef(MakeUnique<Shard>());
+		NewShard.Wake = FPlatformProcess::GetSynchEventFromPool();
+		NewShard.Thread = Async(EAsyncExecution::Thread, [this, &NewShard]() { RunShard(NewShard); });
+	}
+}
+
+void MineSweeperBotScheduler::Stop()
+{
+	bStopShards = true;
+	for (TUniquePtr<Shard>& Each : Shards)
+	{
+		Each->Wake->Trigger();
+		Each->Thread.Wait();
+	}
+	// Nothing is running any more, so every bot that's left is sitting at a co_await and can be destroyed there
+	Tables.Reset();
+	for (TUniquePtr<Shard>& Each : Shards)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(Each->Wake);
+	}
+	Shards.Reset();
+	NextShard = 0;
+}
+
+MineSweeperBotTable& MineSweeperBotScheduler::CreateHeadlessTable()
+{
+	check(Shards.Num() > 0); // Start first
+	Shard& OwnShard = *Shards[NextShard];
+	NextShard = (NextShard + 1) % Shards.Num();
+	return *Tables.Add_GetRef(MakeUnique<HeadlessBotTable>(*this, OwnShard));
+}
+
+MineSweeperBotTable& MineSweeperBotScheduler::CreateEditorTable(TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> Board)
+{
+	return *Tables.Add_GetRef(MakeUnique<EditorBotTable>(*this, Board));
+}
+
+void MineSweeperBotScheduler::Spawn(MineSweeperBotTable& Table, MineSweeperBot Bot)
+{
+	check(!Table.Bot && Bot.Handle);
+	Table.Bot = Bot.Handle;
+	Table.Bot.promise().Table = &Table;
+	Bot.Handle = nullptr;
+	NumRunning.fetch_add(1, std::memory_order_relaxed);
+	Table.Post(Table.Bot);
+}
+
+int64 MineSweeperBotScheduler::GetNumMoves() const
+{
+	int64 NumMoves = NumEditorMoves.load(std::memory_order_relaxed);
+	for (const TUniquePtr<Shard>& Each : Shards)
+	{
+		NumMoves += Each->NumMoves.load(std::memory_order_relaxed);
+	}
+	return NumMoves;
+}
+
+void MineSweeperBotScheduler::RunShard(Shard& InShard)
+{
+	while (!bStopShards)
+	{
+		std::coroutine_handle<> Handle;
+		bool bWorked = false;
+		// Checked every resume, a shard full of bots would otherwise never run out of work to stop at
+		while (!bStopShards.load(std::memory_order_relaxed) && InShard.Ready.Dequeue(Handle))
+		{
+			bWorked = true;
+			Handle.resume();
+		}
+		if (!bWorked)
+		{
+			InShard.Wake->Wait(10);
+		}
+	}
+}
+
+namespace MineSweeperBotCommands
+{
+	struct BotTally
+	{
+		std::atomic<int64> Won = 0;
+		std::atomic<int64> Lost = 0;
+	};
+
+	struct BotChoice
+	{
+		int32 Tile = INDEX_NONE;
+		bool bFlag = false;
+	};
+
+	/**
+	* The simplest bot worth watching. Chords any number with all its flags, flags around any number whose hidden tiles
+	* must all be mines, and otherwise guesses.
+	*/
+	BotChoice ChooseMove(const MineSweeperBotTable& Table, FRandomStream& Stream)
+	{
+		int32 Neighbors[MineSweeperGrid::MaxNeighbors];
+		for (int32 Tile = 0; Tile < Table.Num(); Tile++)
+		{
+			const int32 Mines = Table.GetAdjacentMines(Tile);
+			if (Mines <= 0)
+			{
+				continue; // Hidden, or a zero, which the cascade has already opened around
+			}
+			const int32 NumNeighbors = Table.GetNeighbors(Tile, Neighbors);
+			int32 Flags = 0;
+			int32 Unknown = INDEX_NONE;
+			int32 NumUnknown = 0;
+			for (int32 i = 0; i < NumNeighbors; i++)
+			{
+				if (Table.IsFlagged(Neighbors[i]))
+				{
+					Flags++;
+				}
+				else if (!Table.IsRevealed(Neighbors[i]))
+				{
+					Unknown = Neighbors[i];
+					NumUnknown++;
+				}
+			}
+			if (NumUnknown > 0 && Flags == Mines)
+			{
+				return { Tile, false };
+			}
+			if (NumUnknown > 0 && Flags + NumUnknown == Mines)
+			{
+				return { Unknown, true };
+			}
+		}
+		const int32 Start = Stream.RandRange(0, Table.Num() - 1);
+		for (int32 Offset = 0; Offset < Table.Num(); Offset++)
+		{
+			const int32 Tile = (Start + Offset) % Table.Num();
+			if (!Table.IsRevealed(Tile) && !Table.IsFlagged(Tile))
+			{
+				return { Tile, false };
+			}
+		}
+		return { Start, false };
+	}
+
+	MineSweeperBot PlayGames(MineSweeperBotTable& Table, int32 NumGames, int32 Width, int32 Height, int32 NumMines, int32 Seed, TSharedRef<BotTally, ESPMode::ThreadSafe> Tally)
+	{
+		FRandomStream Stream(Seed);
+		for (int32 Game = 0; Game < NumGames; Game++)
+		{
+			co_await Table.NewGame(Width, Height, NumMines, int32(Stream.GetUnsignedInt()));
+			MineSweeperBotMove Move = co_await Table.Reveal((Table.GetHeight() / 2) * Table.GetWidth() + Table.GetWidth() / 2);
+			while (Move.Phase == EMineSweeperPhase::Playing)
+			{
+				const BotChoice Choice = ChooseMove(Table, Stream);
+				if (Choice.bFlag)
+				{
+					Move = co_await Table.Flag(Choice.Tile);
+				}
+				else
+				{
+					Move = co_await Table.Reveal(Choice.Tile);
+				}
+			}
+			(Move.Phase == EMineSweeperPhase::Won ? Tally->Won : Tally->Lost).fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	TUniquePtr<MineSweeperBotScheduler> HeadlessScheduler;
+	FTSTicker::FDelegateHandle HeadlessReport; // Waits for the headless run to finish, and goes with it
+	TUniquePtr<MineSweeperBotScheduler> EditorScheduler;
+
+	void StopAll()
+	{
+		// The report first, so a Run straight after a Stop can't be reported on, or reset, by the last run's ticker
+		FTSTicker::GetCoreTicker().RemoveTicker(HeadlessReport);
+		HeadlessReport.Reset();
+		HeadlessScheduler.Reset();
+		EditorScheduler.Reset();
+	}
+
+	static FAutoConsoleCommand BotRunCommand(
+		TEXT("MineSweeper.Bot.Run"),
+		TEXT("Plays expert games headlessly with the built in bot at full speed and logs games and moves per second. Optional arguments: bots (default 1000), games per bot (default 10), worker threads (default one per core)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				if (HeadlessScheduler.IsValid())
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("Headless bots are already running, MineSweeper.Bot.Stop first"));
+					return;
+				}
+				const int32 NumBots = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+				const int32 NumGames = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 10;
+				const int32 NumThreads = Args.Num() > 2 ? FMath::Max(0, FCString::Atoi(*Args[2])) : 0;
+
+				HeadlessScheduler = MakeUnique<MineSweeperBotScheduler>();
+				HeadlessScheduler->Start(NumThreads);
+				TSharedRef<BotTally, ESPMode::ThreadSafe> Tally = MakeShared<BotTally, ESPMode::ThreadSafe>();
+				for (int32 Index = 0; Index < NumBots; Index++)
+				{
+					MineSweeperBotTable& Table = HeadlessScheduler->CreateHeadlessTable();
+					HeadlessScheduler->Spawn(Table, PlayGames(Table, NumGames, 30, 16, 99, Index, Tally));
+				}
+
+				// Checked from the game thread, which is also where the scheduler has to be stopped from
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				HeadlessReport = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Tally, StartCycles, NumBots](float)
+					{
+						if (HeadlessScheduler->GetNumRunning() > 0)
+						{
+							return true;
+						}
+						const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+						const int64 Games = Tally->Won + Tally->Lost;
+						UE_LOG(MineSweeperLog, Log, TEXT("%d bots played %lld games in %.2f s (%.0f games/s, %.0f moves/s), won %.1f%%"),
+							NumBots, Games, Seconds, Games / Seconds, HeadlessScheduler->GetNumMoves() / Seconds, 100.0 * Tally->Won / FMath::Max<int64>(1, Games));
+						HeadlessScheduler.Reset();
+						HeadlessReport.Reset();
+						return false;
+					}), 0.1f);
+			}));
+
+	static FAutoConsoleCommand BotPlayCommand(
+		TEXT("MineSweeper.Bot.Play"),
+		TEXT("Has the built in bot play the board in the GameWindow tab, a move every MineSweeper.Bot.PaceMs. Optional argument: games (default 1)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board = MineSweeperBoard::GetActiveBoard();
+				if (!Board.IsValid())
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("There's no board to play, open the GameWindow tab and generate one"));
+					return;
+				}
+				const int32 NumGames = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1;
+				EditorScheduler = MakeUnique<MineSweeperBotScheduler>(); // Replacing it stops any bot already on the board
+				MineSweeperBotTable& Table = EditorScheduler->CreateEditorTable(Board.ToSharedRef());
+				TSharedRef<BotTally, ESPMode::ThreadSafe> Tally = MakeShared<BotTally, ESPMode::ThreadSafe>();
+				EditorScheduler->Spawn(Table, PlayGames(Table, NumGames, 0, 0, 0, FMath::Rand(), Tally));
+			}));
+
+	static FAutoConsoleCommand BotStopCommand(
+		TEXT("MineSweeper.Bot.Stop"),
+		TEXT("Stops every bot, headless or on the board."),
+		FConsoleCommandDelegate::CreateStatic(&StopAll));
+}
+
+void MineSweeperBotScheduler::StopAll()
+{
+	MineSweeperBotCommands::StopAll();
+}
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperClock.h"
+#include "Widgets/Text/STextBlock.h"
+
+void MineSweeperClock::Start(TSharedPtr<STextBlock> InText)
+{
+	Text = InText;
+	AccumulatedCycles = 0;
+	RunningSinceCycles = FPlatformTime::Cycles64();
+	DisplayedSeconds = -1;
+	State = EState::Running;
+	MineSweeperClockTicker::Get().Add(AsShared());
+}
+
+void MineSweeperClock::Pause()
+{
+	if (State != EState::Running)
+	{
+		return;
+	}
+	AccumulatedCycles += FPlatformTime::Cycles64() - RunningSinceCycles;
+	State = EState::Paused;
+	MineSweeperClockTicker::Get().Remove(*this);
+}
+
+void MineSweeperClock::Resume()
+{
+	if (State != EState::Paused)
+	{
+		return;
+	}
+	RunningSinceCycles = FPlatformTime::Cycles64();
+	State = EState::Running;
+	MineSweeperClockTicker::Get().Add(AsShared());
+}
+
+void MineSweeperClock::Stop()
+{
+	if (State == EState::Stopped)
+	{
+		return;
+	}
+	if (State == EState::Running)
+	{
+		AccumulatedCycles += FPlatformTime::Cycles64() - RunningSinceCycles;
+	}
+	State = EState::Stopped;
+	Refresh(); // Show exactly where it stopped, even if that's partway through a second
+	MineSweeperClockTicker::Get().Remove(*this);
+}
+
+double MineSweeperClock::GetElapsedSeconds() const
+{
+	const uint64 Cycles = AccumulatedCycles + (State == EState::Running ? FPlatformTime::Cycles64() - RunningSinceCycles : 0);
+	return FPlatformTime::ToSeconds64(Cycles);
+}
+
+double MineSweeperClock::Refresh()
+{
+	const double Elapsed = GetElapsedSeconds();
+	const int64 Seconds = int64(Elapsed);
+	TSharedPtr<STextBlock> PinnedText = Text.Pin();
+	if (Seconds != DisplayedSeconds && PinnedText.IsValid())
+	{
+		DisplayedSeconds = Seconds;
+		const FTimespan TimeSpan = FTimespan::FromSeconds(double(Seconds));
+		PinnedText->SetText(FText::FromString(FString::Printf(TEXT("Time: %02d:%02d:%02d"), int32(TimeSpan.GetTotalHours()), TimeSpan.GetMinutes(), TimeSpan.GetSeconds())));
+	}
+	return double(Seconds + 1) - Elapsed;
+}
+
+MineSweeperClockTicker& MineSweeperClockTicker::Get()
+{
+	static MineSweeperClockTicker Ticker;
+	return Ticker;
+}
+
+void MineSweeperClockTicker::Add(const TSharedRef<MineSweeperClock>& Clock)
+{
+	Running.AddUnique(Clock);
+	Schedule();
+}
+
+void MineSweeperClockTicker::Remove(const MineSweeperClock& Clock)
+{
+	Running.RemoveAll([&Clock](const TWeakPtr<MineSweeperClock>& Other) { return !Other.IsValid() || Other.Pin().Get() == &Clock; });
+	if (Running.Num() == 0 && Handle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(Handle);
+		Handle.Reset();
+	}
+}
+
+void MineSweeperClockTicker::Schedule()
+{
+	// Every clock gets refreshed here, so the ones just added show their time straight away
+	double NextChange = TNumericLimits<double>::Max();
+	for (int32 Index = Running.Num() - 1; Index >= 0; Index--)
+	{
+		TSharedPtr<MineSweeperClock> Clock = Running[Index].Pin();
+		if (!Clock.IsValid())
+		{
+			Running.RemoveAtSwap(Index, EAllowShrinking::No);
+			continue;
+		}
+		NextChange = FMath::Min(NextChange, Clock->Refresh());
+	}
+	if (Handle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(Handle);
+		Handle.Reset();
+	}
+	if (Running.Num() > 0)
+	{
+		// A millisecond late so we're definitely past the boundary when we land
+		Handle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &MineSweeperClockTicker::Tick), float(NextChange + 0.001));
+	}
+}
+
+bool MineSweeperClockTicker::Tick(float DeltaTime)
+{
+	// One shot, Schedule adds the next one
+	Handle.Reset();
+	Schedule();
+	return false;
+}
@@ -0,0 +1,380 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperDifficulty.h"
+#include "MineSweeperBoard.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include <algorithm>
+#include <atomic>
+
+MineSweeperDifficultyAnalyzer::MineSweeperDifficultyAnalyzer(int32 InWidth, int32 InHeight, int32 InNumMines)
+	: Width(InWidth)
+	, Height(InHeight)
+	, NumMines(InNumMines)
+	, Grid(MakeMineSweeperGrid(InWidth, InHeight))
+{
+	const int32 NumTiles = Width * Height;
+	Mines.assign(NumTiles, false);
+	Visited.assign(NumTiles, false);
+	RevealedTiles.reserve(NumTiles);
+	FlaggedTiles.reserve(NumTiles);
+	ChangedTiles.reserve(NumTiles);
+	IslandStack.reserve(NumTiles);
+}
+
+MineSweeperDifficulty MineSweeperDifficultyAnalyzer::Analyze(int32 Seed)
+{
+	MineSweeperDifficulty Result;
+	PlaceMines(Seed);
+	MeasureOpenings(Result);
+	Solve(Result);
+	return Result;
+}
+
+void MineSweeperDifficultyAnalyzer::PlaceMines(int32 Seed)
+{
+	// Draws row then column and skips repeats, the same as RandomBoardGenerator::Generate, but into one flat buffer
+	std::fill(Mines.begin(), Mines.end(), false);
+	Stream.Initialize(Seed);
+	int32 Placed = 0;
+	while (Placed < NumMines)
+	{
+		const int32 Row = Stream.RandRange(0, Height - 1);
+		const int32 Column = Stream.RandRange(0, Width - 1);
+		if (!Mines[Row * Width + Column])
+		{
+			Mines[Row * Width + Column] = true;
+			Placed++;
+		}
+	}
+	Grid->SetMines(Mines);
+}
+
+void MineSweeperDifficultyAnalyzer::MeasureOpenings(MineSweeperDifficulty& Out)
+{
+	// Every opening is one click, and revealing it also uncovers the numbers around its edge
+	for (int32 Tile = 0; Tile < Grid->Num(); Tile++)
+	{
+		if (!Grid->IsMine(Tile) && !Grid->IsRevealed(Tile) && Grid->GetAdjacentMines(Tile) == 0)
+		{
+			RevealedTiles.clear();
+			Grid->Reveal(Tile, RevealedTiles);
+			Out.NumOpenings++;
+		}
+	}
+	Out.ThreeBV = Out.NumOpenings;
+
+	// Whatever safe tile is still hidden is a number no opening reaches, and each of those is a click of its own
+	int32 Neighbors[MineSweeperGrid::MaxNeighbors];
+	for (int32 Tile = 0; Tile < Grid->Num(); Tile++)
+	{
+		if (Grid->IsMine(Tile) || Grid->IsRevealed(Tile) || Visited[Tile])
+		{
+			continue;
+		}
+		int32 IslandSize = 0;
+		Visited[Tile] = true;
+		IslandStack.push_back(Tile);
+		while (!IslandStack.empty())
+		{
+			const int32 Current = IslandStack.back();
+			IslandStack.pop_back();
+			IslandSize++;
+			const int32 NumNeighbors = Grid->GetNeighbors(Current, Neighbors);
+			for (int32 i = 0; i < NumNeighbors; i++)
+			{
+				if (!Grid->IsMine(Neighbors[i]) && !Grid->IsRevealed(Neighbors[i]) && !Visited[Neighbors[i]])
+				{
+					Visited[Neighbors[i]] = true;
+					IslandStack.push_back(Neighbors[i]);
+				}
+			}
+		}
+		Out.ThreeBV += IslandSize;
+		Out.NumIslands++;
+		Out.LargestIsland = FMath::Max(Out.LargestIsland, IslandSize);
+	}
+	std::fill(Visited.begin(), Visited.end(), false);
+}
+
+void MineSweeperDifficultyAnalyzer::Solve(MineSweeperDifficulty& Out)
+{
+	Grid->SetMines(Mines); // Back to a fresh board, the opening count revealed everything it could
+	OpeningCursor = 0;
+	SafeCursor = 0;
+	Out.NumGuesses = -1; // The first click doesn't count, there's nothing to go on yet whatever the board
+	for (int32 Guess = FindGuess(); Guess != INDEX_NONE; Guess = FindGuess())
+	{
+		Out.NumGuesses++;
+		RevealedTiles.clear();
+		FlaggedTiles.clear();
+		Grid->Reveal(Guess, RevealedTiles);
+		ChangedTiles = RevealedTiles;
+		Grid->AutoPlay(ChangedTiles, true, true, RevealedTiles, FlaggedTiles);
+		while (Grid->GetRemainingSafeTiles() > 0 && ApplySubsetRule())
+		{
+		}
+	}
+	Out.NumGuesses = FMath::Max(0, Out.NumGuesses);
+}
+
+int32 MineSweeperDifficultyAnalyzer::GetUnknownNeighbors(int32 Tile, int32* OutUnknown, int32& OutMinesLeft) const
+{
+	int32 Neighbors[MineSweeperGrid::MaxNeighbors];
+	const int32 NumNeighbors = Grid->GetNeighbors(Tile, Neighbors);
+	int32 NumUnknown = 0;
+	for (int32 i = 0; i < NumNeighbors; i++)
+	{
+		if (!Grid->IsRevealed(Neighbors[i]) && !Grid->IsFlagged(Neighbors[i]))
+		{
+			OutUnknown[NumUnknown++] = Neighbors[i];
+		}
+	}
+	OutMinesLeft = Grid->GetAdjacentMines(Tile) - Grid->GetAdjacentFlags(Tile);
+	return NumUnknown;
+}
+
+bool MineSweeperDifficultyAnalyzer::ApplySubsetRule()
+{
+	int32 UnknownA[MineSweeperGrid::MaxNeighbors];
+	int32 UnknownB[MineSweeperGrid::MaxNeighbors];
+	int32 Difference[MineSweeperGrid::MaxNeighbors];
+	bool bProgress = false;
+	for (int32 A = 0; A < Grid->Num(); A++)
+	{
+		// Only numbers on the frontier have anything to say, and auto play has already used up every single-number rule
+		if (!Grid->IsRevealed(A) || Grid->IsMine(A) || Grid->GetAdjacentHidden(A) == Grid->GetAdjacentFlags(A))
+		{
+			continue;
+		}
+		int32 MinesA = 0;
+		int32 NumA = GetUnknownNeighbors(A, UnknownA, MinesA);
+		const int32 RowA = A / Width;
+		const int32 ColumnA = A % Width;
+		// Two numbers can only share unknown tiles if they're at most two tiles apart. B needs more unknown tiles than A,
+		// equal sets prove nothing new and smaller ones get their turn as A.
+		for (int32 Row = FMath::Max(0, RowA - 2); Row <= FMath::Min(Height - 1, RowA + 2); Row++)
+		{
+			for (int32 Column = FMath::Max(0, ColumnA - 2); Column <= FMath::Min(Width - 1, ColumnA + 2); Column++)
+			{
+				const int32 B = Row * Width + Column;
+				if (B == A || !Grid->IsRevealed(B) || Grid->IsMine(B) || Grid->GetAdjacentHidden(B) - Grid->GetAdjacentFlags(B) <= NumA)
+				{
+					continue;
+				}
+				int32 MinesB = 0;
+				const int32 NumB = GetUnknownNeighbors(B, UnknownB, MinesB);
+				int32 NumDifference = 0;
+				int32 NumShared = 0;
+				for (int32 i = 0; i < NumB; i++)
+				{
+					const bool bShared = std::find(UnknownA, UnknownA + NumA, UnknownB[i]) != UnknownA + NumA;
+					NumShared += bShared;
+					if (!bShared)
+					{
+						Difference[NumDifference++] = UnknownB[i];
+					}
+				}
+				if (NumShared != NumA)
+				{
+					continue; // A isn't a subset of B
+				}
+				const int32 MinesInDifference = MinesB - MinesA;
+				if (MinesInDifference != 0 && MinesInDifference != NumDifference)
+				{
+					continue;
+				}
+				RevealedTiles.clear();
+				FlaggedTiles.clear();
+				ChangedTiles.clear();
+				for (int32 i = 0; i < NumDifference; i++)
+				{
+					if (MinesInDifference == 0)
+					{
+						Grid->Reveal(Difference[i], RevealedTiles);
+					}
+					else if (Grid->SetFlagged(Difference[i], true))
+					{
+						ChangedTiles.push_back(Difference[i]);
+					}
+				}
+				ChangedTiles.insert(ChangedTiles.end(), RevealedTiles.begin(), RevealedTiles.end());
+				Grid->AutoPlay(ChangedTiles, true, true, RevealedTiles, FlaggedTiles);
+				bProgress = true;
+				// Keep scanning rather than starting over, everything is read fresh from the grid so it's still sound
+				NumA = GetUnknownNeighbors(A, UnknownA, MinesA);
+			}
+		}
+	}
+	return bProgress;
+}
+
+int32 MineSweeperDifficultyAnalyzer::FindGuess()
+{
+	if (Grid->GetRemainingSafeTiles() == 0)
+	{
+		return INDEX_NONE;
+	}
+	const auto IsSafeHidden = [this](int32 Tile) { return !Grid->IsMine(Tile) && !Grid->IsRevealed(Tile) && !Grid->IsFlagged(Tile); };
+	for (; OpeningCursor < Grid->Num(); OpeningCursor++)
+	{
+		if (IsSafeHidden(OpeningCursor) && Grid->GetAdjacentMines(OpeningCursor) == 0)
+		{
+			return OpeningCursor;
+		}
+	}
+	for (; SafeCursor < Grid->Num(); SafeCursor++)
+	{
+		if (IsSafeHidden(SafeCursor))
+		{
+			return SafeCursor;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void MineSweeperDifficultyColumns::Reset(int32 NumRows)
+{
+	Seeds.assign(NumRows, 0);
+	ThreeBV.assign(NumRows, 0);
+	NumOpenings.assign(NumRows, 0);
+	NumGuesses.assign(NumRows, 0);
+	NumIslands.assign(NumRows, 0);
+	LargestIsland.assign(NumRows, 0);
+}
+
+void MineSweeperDifficultyColumns::Set(int32 Row, int32 Seed, const MineSweeperDifficulty& Difficulty)
+{
+	// Nothing on a board under 65536 tiles can go past a uint16, and bigger boards aren't what this is for
+	const auto Narrow = [](int32 Value) { return uint16(FMath::Clamp(Value, 0, 0xFFFF)); };
+	Seeds[Row] = Seed;
+	ThreeBV[Row] = Narrow(Difficulty.ThreeBV);
+	NumOpenings[Row] = Narrow(Difficulty.NumOpenings);
+	NumGuesses[Row] = Narrow(Difficulty.NumGuesses);
+	NumIslands[Row] = Narrow(Difficulty.NumIslands);
+	LargestIsland[Row] = Narrow(Difficulty.LargestIsland);
+}
+
+bool MineSweeperDifficultyColumns::Write(const FString& Path) const
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer)
+	{
+		return false;
+	}
+	struct Column
+	{
+		const char* Name;
+		const void* Data;
+		uint32 ElementSize;
+	};
+	const Column Columns[] = {
+		{ "Seed", Seeds.data(), sizeof(int32) },
+		{ "ThreeBV", ThreeBV.data(), sizeof(uint16) },
+		{ "Openings", NumOpenings.data(), sizeof(uint16) },
+		{ "Guesses", NumGuesses.data(), sizeof(uint16) },
+		{ "Islands", NumIslands.data(), sizeof(uint16) },
+		{ "LargestIsland", LargestIsland.data(), sizeof(uint16) },
+	};
+
+	uint32 Header[] = { 'M' | ('S' << 8) | ('D' << 16) | ('A' << 24), 1, uint32(Width), uint32(Height), uint32(NumMines) };
+	uint64 NumRows = uint64(Num());
+	uint32 NumColumns = UE_ARRAY_COUNT(Columns);
+	Writer->Serialize(Header, sizeof(Header));
+	Writer->Serialize(&NumRows, sizeof(NumRows));
+	Writer->Serialize(&NumColumns, sizeof(NumColumns));
+	for (const Column& Each : Columns)
+	{
+		ANSICHAR Name[16] = {};
+		FMemory::Memcpy(Name, Each.Name, FMath::Min<SIZE_T>(FCStringAnsi::Strlen(Each.Name), sizeof(Name)));
+		uint32 ElementSize = Each.ElementSize;
+		Writer->Serialize(Name, sizeof(Name));
+		Writer->Serialize(&ElementSize, sizeof(ElementSize));
+	}
+	for (const Column& Each : Columns)
+	{
+		Writer->Serialize(const_cast<void*>(Each.Data), int64(NumRows) * Each.ElementSize);
+	}
+	return Writer->Close();
+}
+
+void MineSweeperAnalysis::AnalyzeDifficulty(int32 Width, int32 Height, int32 NumMines, int32 FirstSeed, int32 NumSeeds, MineSweeperDifficultyColumns& Out)
+{
+	Out.Width = Width;
+	Out.Height = Height;
+	Out.NumMines = NumMines;
+	Out.Reset(NumSeeds);
+	if (NumSeeds <= 0 || Width <= 0 || Height <= 0 || NumMines >= Width * Height)
+	{
+		return;
+	}
+
+	// One task per worker, each with its own analyzer, pulling chunks off a shared counter. Chunks are small enough that
+	// the workers finish together and big enough that the counter is touched a few thousand times in a whole sweep.
+	constexpr int32 ChunkSize = 4096;
+	std::atomic<int32> NextChunk = 0;
+	const int32 NumChunks = (NumSeeds + ChunkSize - 1) / ChunkSize;
+	const int32 NumTasks = FMath::Clamp(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1, NumChunks);
+	ParallelFor(NumTasks, [&](int32 TaskIndex)
+		{
+			MineSweeperDifficultyAnalyzer Analyzer(Width, Height, NumMines);
+			for (int32 Chunk = NextChunk++; Chunk < NumChunks; Chunk = NextChunk++)
+			{
+				const int32 Last = FMath::Min(NumSeeds, (Chunk + 1) * ChunkSize);
+				for (int32 Row = Chunk * ChunkSize; Row < Last; Row++)
+				{
+					const int32 Seed = FirstSeed + Row;
+					Out.Set(Row, Seed, Analyzer.Analyze(Seed));
+				}
+			}
+		});
+}
+
+namespace MineSweeperDifficultyCommands
+{
+	static FAutoConsoleCommand AnalyzeDifficultyCommand(
+		TEXT("MineSweeper.Analyze.Difficulty"),
+		TEXT("Measures 3BV, openings, guesses and islands for a range of seeds and writes them to a columnar file. Optional arguments: width height mines (default expert), seeds (default 10000000), first seed (default 0), output path (default Saved/MineSweeper)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				const int32 Width = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 30;
+				const int32 Height = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 16;
+				const int32 NumMines = Args.Num() > 2 ? FMath::Clamp(FCString::Atoi(*Args[2]), 0, Width * Height - 1) : 99;
+				const int32 NumSeeds = Args.Num() > 3 ? FMath::Max(1, FCString::Atoi(*Args[3])) : 10000000;
+				const int32 FirstSeed = Args.Num() > 4 ? FCString::Atoi(*Args[4]) : 0;
+				const FString Path = Args.Num() > 5 ? Args[5]
+					: FPaths::ProjectSavedDir() / TEXT("MineSweeper") / FString::Printf(TEXT("Difficulty_%dx%d_%d_%d.msda"), Width, Height, NumMines, FirstSeed);
+
+				// A full sweep takes a while, so it runs on its own thread and the editor stays usable
+				UE_LOG(MineSweeperLog, Log, TEXT("Analysing %d seeds of %dx%d with %d mines..."), NumSeeds, Width, Height, NumMines);
+				Async(EAsyncExecution::Thread, [=]()
+					{
+						MineSweeperDifficultyColumns Columns;
+						const double Start = FPlatformTime::Seconds();
+						MineSweeperAnalysis::AnalyzeDifficulty(Width, Height, NumMines, FirstSeed, NumSeeds, Columns);
+						const double Elapsed = FPlatformTime::Seconds() - Start;
+
+						int64 TotalThreeBV = 0;
+						int64 TotalGuesses = 0;
+						int64 TotalIslands = 0;
+						int32 NoGuessBoards = 0;
+						for (int32 Row = 0; Row < Columns.Num(); Row++)
+						{
+							TotalThreeBV += Columns.ThreeBV[Row];
+							TotalGuesses += Columns.NumGuesses[Row];
+							TotalIslands += Columns.NumIslands[Row];
+							NoGuessBoards += Columns.NumGuesses[Row] == 0;
+						}
+						const bool bWritten = Columns.Write(Path);
+						const double Rows = FMath::Max(1, Columns.Num());
+						UE_LOG(MineSweeperLog, Log, TEXT("Analysed %d boards in %.2f s (%.0f boards/s): avg 3BV %.2f, avg guesses %.3f, avg islands %.2f, %.2f%% need no guess"),
+							Columns.Num(), Elapsed, Columns.Num() / FMath::Max(Elapsed, 1e-9),
+							TotalThreeBV / Rows, TotalGuesses / Rows, TotalIslands / Rows, 100.0 * NoGuessBoards / Rows);
+						UE_LOG(MineSweeperLog, Log, TEXT("%s %s"), bWritten ? TEXT("Wrote") : TEXT("Failed to write"), *Path);
+					});
+			}));
+}
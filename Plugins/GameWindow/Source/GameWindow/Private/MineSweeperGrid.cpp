@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperGrid.h"
+
+int32 MineSweeperGrid::RelocateMinesAround(int32 Tile, bool bClearNeighbors, FRandomStream& Stream, int32* OutMoves)
+{
+	int32 Protected[MaxNeighbors + 1];
+	Protected[0] = Tile;
+	const int32 NumProtected = 1 + (bClearNeighbors ? GetNeighbors(Tile, Protected + 1) : 0);
+	const auto IsFree = [&](int32 Candidate)
+		{
+			if (IsMine(Candidate))
+			{
+				return false;
+			}
+			for (int32 i = 0; i < NumProtected; i++)
+			{
+				if (Protected[i] == Candidate)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+	int32 NumMoved = 0;
+	for (int32 i = 0; i < NumProtected; i++)
+	{
+		if (!IsMine(Protected[i]))
+		{
+			continue;
+		}
+		// Picking random tiles until one is free is uniform over the free tiles, and on any normal density it takes a
+		// couple of tries. Only a nearly full board falls through to counting them.
+		int32 Target = INDEX_NONE;
+		for (int32 Attempt = 0; Attempt < 64 && Target == INDEX_NONE; Attempt++)
+		{
+			const int32 Candidate = Stream.RandRange(0, Num() - 1);
+			Target = IsFree(Candidate) ? Candidate : INDEX_NONE;
+		}
+		if (Target == INDEX_NONE)
+		{
+			int32 NumFree = 0;
+			for (int32 Candidate = 0; Candidate < Num(); Candidate++)
+			{
+				NumFree += IsFree(Candidate);
+			}
+			if (NumFree == 0)
+			{
+				break; // There's nowhere left to put it, so this click can't be made safe
+			}
+			int32 Pick = Stream.RandRange(0, NumFree - 1);
+			for (int32 Candidate = 0; Candidate < Num() && Target == INDEX_NONE; Candidate++)
+			{
+				if (IsFree(Candidate) && Pick-- == 0)
+				{
+					Target = Candidate;
+				}
+			}
+		}
+		MoveMine(Protected[i], Target);
+		if (OutMoves != nullptr)
+		{
+			OutMoves[NumMoved * 2] = Protected[i];
+			OutMoves[NumMoved * 2 + 1] = Target;
+		}
+		NumMoved++;
+	}
+	return NumMoved;
+}
+
+int32 MineSweeperGrid::Chord(int32 Tile, std::vector<int32>& OutRevealed)
+{
+	if (!IsRevealed(Tile) || IsMine(Tile) || GetAdjacentFlags(Tile) != GetAdjacentMines(Tile) || GetAdjacentHidden(Tile) == GetAdjacentFlags(Tile))
+	{
+		return 0;
+	}
+	int32 Neighbors[MaxNeighbors];
+	const int32 NumNeighbors = GetNeighbors(Tile, Neighbors);
+	int32 NumChanged = 0;
+	for (int32 i = 0; i < NumNeighbors; i++)
+	{
+		// Reveal already skips anything flagged or revealed, including tiles an earlier neighbor's opening got to
+		NumChanged += Reveal(Neighbors[i], OutRevealed);
+	}
+	return NumChanged;
+}
+
+int32 MineSweeperGrid::AutoPlay(const std::vector<int32>& Changed, bool bAutoFlag, bool bAutoReveal, std::vector<int32>& OutRevealed, std::vector<int32>& OutFlagged)
+{
+	if (!bAutoFlag && !bAutoReveal)
+	{
+		return 0;
+	}
+	AutoPlayQueue.clear();
+	AutoPlayQueued.resize(Num());
+
+	int32 Neighbors[MaxNeighbors + 1]; // The tile itself goes in after its neighbors
+	const auto EnqueueAround = [&](int32 Tile)
+		{
+			const int32 NumNeighbors = GetNeighbors(Tile, Neighbors);
+			Neighbors[NumNeighbors] = Tile;
+			for (int32 i = 0; i <= NumNeighbors; i++)
+			{
+				if (!AutoPlayQueued[Neighbors[i]])
+				{
+					AutoPlayQueued[Neighbors[i]] = true;
+					AutoPlayQueue.push_back(Neighbors[i]);
+				}
+			}
+		};
+
+	for (int32 Tile : Changed)
+	{
+		EnqueueAround(Tile);
+	}
+
+	int32 NumChanged = 0;
+	bool bHitMine = false;
+	while (!AutoPlayQueue.empty())
+	{
+		const int32 Tile = AutoPlayQueue.back();
+		AutoPlayQueue.pop_back();
+		AutoPlayQueued[Tile] = false;
+		if (bHitMine || !IsRevealed(Tile) || IsMine(Tile))
+		{
+			continue; // Still drained so the queued bits are all clear for next time
+		}
+
+		const int32 Mines = GetAdjacentMines(Tile);
+		const int32 Flags = GetAdjacentFlags(Tile);
+		const int32 Hidden = GetAdjacentHidden(Tile);
+		if (Hidden == Flags)
+		{
+			continue; // Nothing left to work out around this one
+		}
+		if (bAutoReveal && Flags == Mines)
+		{
+			const size_t First = OutRevealed.size();
+			NumChanged += Chord(Tile, OutRevealed);
+			for (size_t i = First; i < OutRevealed.size(); i++)
+			{
+				bHitMine |= IsMine(OutRevealed[i]);
+				EnqueueAround(OutRevealed[i]);
+			}
+		}
+		else if (bAutoFlag && Hidden == Mines)
+		{
+			int32 Around[MaxNeighbors];
+			const int32 NumAround = GetNeighbors(Tile, Around);
+			for (int32 i = 0; i < NumAround; i++)
+			{
+				if (SetFlagged(Around[i], true))
+				{
+					OutFlagged.push_back(Around[i]);
+					NumChanged++;
+					EnqueueAround(Around[i]);
+				}
+			}
+		}
+	}
+	return NumChanged;
+}
+
+TSharedRef<MineSweeperGrid> MakeMineSweeperGrid(int32 Width, int32 Height)
+{
+	if (Width == 9 && Height == 9)
+	{
+		return MakeShared<BeginnerGrid>();
+	}
+	if (Width == 16 && Height == 16)
+	{
+		return MakeShared<IntermediateGrid>();
+	}
+	if (Width == 30 && Height == 16)
+	{
+		return MakeShared<ExpertGrid>();
+	}
+	return MakeShared<DynamicMineSweeperGrid>(Width, Height);
+}
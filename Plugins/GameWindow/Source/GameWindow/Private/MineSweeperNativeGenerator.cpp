@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperNativeGenerator.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<FString> CVarGeneratorLibrary(
+	TEXT("MineSweeper.Generator.Library"),
+	TEXT(""),
+	TEXT("Path to a shared library implementing MineSweeperGeneratorABI.h. When set, new games are generated by it instead of the built in generator."));
+
+TSharedPtr<NativeBoardGenerator> NativeBoardGenerator::Load(const FString& InLibraryPath)
+{
+	void* Handle = FPlatformProcess::GetDllHandle(*InLibraryPath);
+	if (Handle == nullptr)
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("Couldn't load generator library %s"), *InLibraryPath);
+		return nullptr;
+	}
+	const MineSweeperGetGeneratorApiFunc GetApi = reinterpret_cast<MineSweeperGetGeneratorApiFunc>(FPlatformProcess::GetDllExport(Handle, TEXT(MINESWEEPER_GENERATOR_ENTRY_POINT)));
+	const MineSweeperGeneratorApi* Api = GetApi ? GetApi(MINESWEEPER_GENERATOR_ABI_VERSION) : nullptr;
+	// Everything up to GenerateBatch has to be there, newer libraries may have more on the end
+	if (Api == nullptr || Api->AbiVersion != MINESWEEPER_GENERATOR_ABI_VERSION || Api->StructSize < sizeof(MineSweeperGeneratorApi) || Api->GenerateBatch == nullptr)
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("%s isn't a generator for ABI version %d"), *InLibraryPath, MINESWEEPER_GENERATOR_ABI_VERSION);
+		FPlatformProcess::FreeDllHandle(Handle);
+		return nullptr;
+	}
+
+	TSharedPtr<NativeBoardGenerator> Generator = MakeShareable(new NativeBoardGenerator());
+	Generator->DllHandle = Handle;
+	Generator->Api = Api;
+	Generator->Context = Api->CreateContext ? Api->CreateContext() : nullptr;
+	Generator->Name = Api->Name ? UTF8_TO_TCHAR(Api->Name) : *FPaths::GetBaseFilename(InLibraryPath);
+	Generator->LibraryPath = InLibraryPath;
+	Generator->SetSeed(false, 0);
+	UE_LOG(MineSweeperLog, Log, TEXT("Loaded generator %s from %s"), *Generator->Name, *InLibraryPath);
+	return Generator;
+}
+
+TSharedPtr<NativeBoardGenerator> NativeBoardGenerator::GetConfigured()
+{
+	static TSharedPtr<NativeBoardGenerator> Configured;
+	const FString LibraryPath = CVarGeneratorLibrary.GetValueOnGameThread();
+	if (LibraryPath.IsEmpty())
+	{
+		Configured.Reset();
+	}
+	else if (!Configured.IsValid() || Configured->LibraryPath != LibraryPath)
+	{
+		Configured = Load(LibraryPath);
+	}
+	return Configured;
+}
+
+NativeBoardGenerator::~NativeBoardGenerator()
+{
+	if (Api && Api->DestroyContext)
+	{
+		Api->DestroyContext(Context);
+	}
+	if (DllHandle)
+	{
+		FPlatformProcess::FreeDllHandle(DllHandle);
+	}
+}
+
+void NativeBoardGenerator::SetSeed(bool bInIsSeeded, int32 InSeed)
+{
+	bIsSeeded = bInIsSeeded;
+	Seed = InSeed;
+}
+
+std::vector<std::vector<bool>> NativeBoardGenerator::Generate(int Width, int Height, int NumMines)
+{
+	const uint64 NumWords = GetWordsPerBoard(Width, Height);
+	Scratch.resize(NumWords);
+	const uint64 BoardSeed = bIsSeeded ? uint64(uint32(Seed)) : (uint64(FMath::Rand()) << 32) ^ uint64(FPlatformTime::Cycles64());
+	const int32 Written = GenerateBatch(Width, Height, NumMines, BoardSeed, 1, Scratch.data(), NumWords);
+	if (Written != 1)
+	{
+		// A board with no mines would look like a generator that works, so the game goes on with the built in one
+		UE_LOG(MineSweeperLog, Error, TEXT("Generator %s failed on a %dx%d board with %d mines (returned %d), using the built in generator instead"),
+			*Name, Width, Height, NumMines, Written);
+		return RandomBoardGenerator(bIsSeeded, Seed).Generate(Width, Height, NumMines);
+	}
+	std::vector<std::vector<bool>> Board(Height, std::vector<bool>(Width, false));
+	for (int32 Row = 0; Row < Height; Row++)
+	{
+		for (int32 Column = 0; Column < Width; Column++)
+		{
+			Board[Row][Column] = IsMine(Scratch.data(), Row * Width + Column);
+		}
+	}
+	return Board;
+}
+
+int32 NativeBoardGenerator::GenerateBatch(int32 Width, int32 Height, int32 NumMines, uint64 FirstSeed, int32 NumBoards, uint64* OutBits, uint64 OutNumWords)
+{
+	MineSweeperGeneratorRequest Request = {};
+	Request.StructSize = sizeof(Request);
+	Request.Width = Width;
+	Request.Height = Height;
+	Request.NumMines = NumMines;
+	Request.FirstSeed = FirstSeed;
+	Request.NumBoards = NumBoards;
+	Request.WordsPerBoard = GetWordsPerBoard(Width, Height);
+	return Api->GenerateBatch(Context, &Request, OutBits, OutNumWords);
+}
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperPerf.h"
+#include "MineSweeperBoard.h"
+#include "MineSweeperLatencyHistogram.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	const TCHAR* ToString(MineSweeperPerfMove::EKind Kind)
+	{
+		switch (Kind)
+		{
+		case MineSweeperPerfMove::EKind::Chord:
+			return TEXT("chord");
+		case MineSweeperPerfMove::EKind::Flag:
+			return TEXT("flag");
+		default:
+			return TEXT("reveal");
+		}
+	}
+}
+
+void MineSweeperPerfCounters::Reset()
+{
+	for (double& Phase : GenerationMs)
+	{
+		Phase = 0.0;
+	}
+	for (uint32& Bucket : PaintBuckets)
+	{
+		Bucket = 0;
+	}
+	NumPaints = 0;
+	NumMoves = 0;
+	Game++;
+	StartCycles = FPlatformTime::Cycles64();
+	MoveWidgets = 0;
+}
+
+void MineSweeperPerfCounters::RecordGeneration(EMineSweeperGenerationPhase Phase, uint64 PhaseStartCycles)
+{
+	GenerationMs[int32(Phase)] = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - PhaseStartCycles);
+}
+
+void MineSweeperPerfCounters::RecordMove(MineSweeperPerfMove::EKind Kind, int32 Tile, int32 Cascade, uint64 InputCycles)
+{
+	const uint64 Now = FPlatformTime::Cycles64();
+	MineSweeperPerfMove& Move = History[NextHistory % HistorySize];
+	Move.Game = Game;
+	Move.Kind = Kind;
+	Move.Tile = Tile;
+	Move.Cascade = Cascade;
+	Move.Widgets = MoveWidgets;
+	Move.RevealUs = float(FPlatformTime::ToMilliseconds64(Now - InputCycles) * 1000.0);
+	Move.PaintMs = 0.0f;
+	Move.Seconds = FPlatformTime::ToSeconds64(Now - StartCycles);
+	MoveWidgets = 0;
+	NextHistory++;
+	NumMoves++;
+}
+
+void MineSweeperPerfCounters::RecordPaint(double InputToPaintMs)
+{
+	PaintBuckets[MineSweeperLatencyHistogram::GetBucket(InputToPaintMs * 1000.0, NumPaintBuckets)]++;
+	NumPaints++;
+	if (NextHistory > 0)
+	{
+		History[(NextHistory - 1) % HistorySize].PaintMs = float(InputToPaintMs);
+	}
+}
+
+void MineSweeperPerfCounters::RecordWidgetUpdates(int32 NumWidgets)
+{
+	const uint64 Frame = GFrameCounter;
+	if (CountingFrame != Frame)
+	{
+		PreviousFrame = CountingFrame;
+		PreviousWidgets = CountingWidgets;
+		CountingFrame = Frame;
+		CountingWidgets = 0;
+	}
+	CountingWidgets += NumWidgets;
+	MoveWidgets += NumWidgets;
+}
+
+int32 MineSweeperPerfCounters::GetWidgetsLastFrame() const
+{
+	const uint64 LastFrame = GFrameCounter - 1;
+	if (CountingFrame == LastFrame)
+	{
+		return CountingWidgets;
+	}
+	return PreviousFrame == LastFrame ? PreviousWidgets : 0;
+}
+
+MineSweeperPerfMove MineSweeperPerfCounters::GetLastMove() const
+{
+	return NextHistory > 0 ? History[(NextHistory - 1) % HistorySize] : MineSweeperPerfMove();
+}
+
+double MineSweeperPerfCounters::GetPaintPercentileMs(double Percentile) const
+{
+	return MineSweeperLatencyHistogram::GetPercentileMicroseconds(PaintBuckets, NumPaintBuckets, Percentile) / 1000.0;
+}
+
+bool MineSweeperPerfCounters::DumpHistory(const FString& Path) const
+{
+	const uint32 End = NextHistory;
+	const uint32 Begin = End > uint32(HistorySize) ? End - HistorySize : 0;
+	FString Csv = TEXT("game,seconds,kind,tile,cascade,widgets,reveal_us,paint_ms\n");
+	Csv.Reserve(Csv.Len() + (End - Begin) * 64);
+	for (uint32 Index = Begin; Index < End; Index++)
+	{
+		const MineSweeperPerfMove& Move = History[Index % HistorySize];
+		Csv += FString::Printf(TEXT("%u,%.4f,%s,%d,%d,%d,%.1f,%.3f\n"),
+			Move.Game, Move.Seconds, ToString(Move.Kind), Move.Tile, Move.Cascade, Move.Widgets, Move.RevealUs, Move.PaintMs);
+	}
+	return FFileHelper::SaveStringToFile(Csv, *Path);
+}
+
+namespace MineSweeperPerfCommands
+{
+	static FAutoConsoleCommand DumpHistoryCommand(
+		TEXT("MineSweeper.Perf.Dump"),
+		TEXT("Writes the last moves on the current board, with their timings, to a CSV file. Optional argument: path (default in Saved/Profiling)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board = MineSweeperBoard::GetActiveBoard();
+				if (!Board.IsValid())
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("No board to dump moves from"));
+					return;
+				}
+				const FString Path = Args.Num() > 0 ? Args[0]
+					: FPaths::Combine(FPaths::ProfilingDir(), FString::Printf(TEXT("MineSweeperMoves-%s.csv"), *FDateTime::Now().ToString()));
+				if (Board->GetPerf().DumpHistory(Path))
+				{
+					UE_LOG(MineSweeperLog, Log, TEXT("Wrote the move history to %s"), *Path);
+				}
+				else
+				{
+					UE_LOG(MineSweeperLog, Error, TEXT("Couldn't write %s"), *Path);
+				}
+			}));
+}
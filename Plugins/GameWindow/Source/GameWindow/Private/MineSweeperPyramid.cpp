@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperPyramid.h"
+
+void MineSweeperPyramid::Build(const MineSweeperGrid& Grid)
+{
+	BoardWidth = Grid.GetWidth();
+	BoardHeight = Grid.GetRows(); // The layers of a 3D board stacked, the same as it's drawn
+	Levels.clear();
+	for (int32 Shift = BaseShift; ; Shift++)
+	{
+		Level& NewLevel = Levels.emplace_back();
+		NewLevel.Width = ((BoardWidth - 1) >> Shift) + 1;
+		NewLevel.Height = ((BoardHeight - 1) >> Shift) + 1;
+		NewLevel.Revealed.assign(size_t(NewLevel.Width) * NewLevel.Height, 0);
+		NewLevel.Flagged.assign(size_t(NewLevel.Width) * NewLevel.Height, 0);
+		NewLevel.Mines.assign(size_t(NewLevel.Width) * NewLevel.Height, 0);
+		if (NewLevel.Width == 1 && NewLevel.Height == 1)
+		{
+			break;
+		}
+	}
+
+	// Fill the finest level from the grid, then each coarser level is just four blocks of the one below
+	Level& Base = Levels[0];
+	for (int32 Tile = 0; Tile < BoardWidth * BoardHeight; Tile++)
+	{
+		const int32 Index = ((Tile / BoardWidth) >> BaseShift) * Base.Width + ((Tile % BoardWidth) >> BaseShift);
+		Base.Revealed[Index] += Grid.IsRevealed(Tile);
+		Base.Flagged[Index] += Grid.IsFlagged(Tile);
+		Base.Mines[Index] += Grid.IsMine(Tile);
+	}
+	for (size_t LevelIndex = 1; LevelIndex < Levels.size(); LevelIndex++)
+	{
+		const Level& Below = Levels[LevelIndex - 1];
+		Level& Above = Levels[LevelIndex];
+		for (int32 Y = 0; Y < Below.Height; Y++)
+		{
+			for (int32 X = 0; X < Below.Width; X++)
+			{
+				const int32 From = Y * Below.Width + X;
+				const int32 To = (Y >> 1) * Above.Width + (X >> 1);
+				Above.Revealed[To] += Below.Revealed[From];
+				Above.Flagged[To] += Below.Flagged[From];
+				Above.Mines[To] += Below.Mines[From];
+			}
+		}
+	}
+}
+
+void MineSweeperPyramid::OnRevealed(const std::vector<int32>& Tiles)
+{
+	for (int32 Tile : Tiles)
+	{
+		ForEachLevel(Tile, [](Level& InLevel, int32 Index) { InLevel.Revealed[Index]++; });
+	}
+}
+
+void MineSweeperPyramid::OnFlagChanged(int32 Tile, bool bFlagged)
+{
+	const uint32 Delta = bFlagged ? 1 : uint32(-1); // Wraps back round on unsigned, same as subtracting one
+	ForEachLevel(Tile, [Delta](Level& InLevel, int32 Index) { InLevel.Flagged[Index] += Delta; });
+}
+
+void MineSweeperPyramid::OnMineMoved(int32 From, int32 To)
+{
+	ForEachLevel(From, [](Level& InLevel, int32 Index) { InLevel.Mines[Index]--; });
+	ForEachLevel(To, [](Level& InLevel, int32 Index) { InLevel.Mines[Index]++; });
+}
+
+MineSweeperPyramid::Block MineSweeperPyramid::GetBlock(int32 LevelIndex, int32 BlockX, int32 BlockY) const
+{
+	const Level& InLevel = Levels[LevelIndex];
+	const int32 Index = BlockY * InLevel.Width + BlockX;
+	const int32 Size = GetBlockSize(LevelIndex);
+	Block Result;
+	Result.Tiles = uint32(FMath::Min(Size, BoardWidth - BlockX * Size)) * uint32(FMath::Min(Size, BoardHeight - BlockY * Size));
+	Result.Revealed = InLevel.Revealed[Index];
+	Result.Flagged = InLevel.Flagged[Index];
+	Result.Mines = InLevel.Mines[Index];
+	return Result;
+}
+
+SIZE_T MineSweeperPyramid::GetAllocatedSize() const
+{
+	SIZE_T Size = Levels.capacity() * sizeof(Level);
+	for (const Level& InLevel : Levels)
+	{
+		Size += (InLevel.Revealed.capacity() + InLevel.Flagged.capacity() + InLevel.Mines.capacity()) * sizeof(uint32);
+	}
+	return Size;
+}
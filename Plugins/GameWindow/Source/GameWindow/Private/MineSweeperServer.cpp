@@ -0,0 +1,733 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperServer.h"
+#include "MineSweeperBoard.h"
+#include "MineSweeperLatencyHistogram.h"
+#include "Async/Async.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_UNIX || PLATFORM_MAC
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define MINESWEEPER_SERVER_SUPPORTED 1
+#else
+#define MINESWEEPER_SERVER_SUPPORTED 0
+#endif
+
+using namespace MineSweeperProtocol;
+
+namespace
+{
+#if MINESWEEPER_SERVER_SUPPORTED
+#ifdef MSG_NOSIGNAL
+	constexpr int SendFlags = MSG_NOSIGNAL; // A client hanging up mid reply shouldn't take the whole process down with SIGPIPE
+#else
+	constexpr int SendFlags = 0;
+#endif
+
+	bool MakeAddress(const FString& Path, sockaddr_un& OutAddress)
+	{
+		FMemory::Memzero(&OutAddress, sizeof(OutAddress));
+		OutAddress.sun_family = AF_UNIX;
+		const FTCHARToUTF8 Utf8Path(*Path);
+		if (Utf8Path.Length() >= int32(sizeof(OutAddress.sun_path)))
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Socket path %s is too long"), *Path);
+			return false;
+		}
+		FMemory::Memcpy(OutAddress.sun_path, Utf8Path.Get(), Utf8Path.Length());
+		return true;
+	}
+
+	bool SendAll(int32 Socket, const void* Data, SIZE_T Size)
+	{
+		const uint8* Bytes = static_cast<const uint8*>(Data);
+		while (Size > 0)
+		{
+			const ssize_t Sent = send(Socket, Bytes, Size, SendFlags);
+			if (Sent < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (Sent <= 0)
+			{
+				return false;
+			}
+			Bytes += Sent;
+			Size -= SIZE_T(Sent);
+		}
+		return true;
+	}
+
+	bool ReceiveAll(int32 Socket, void* Data, SIZE_T Size)
+	{
+		uint8* Bytes = static_cast<uint8*>(Data);
+		while (Size > 0)
+		{
+			const ssize_t Received = recv(Socket, Bytes, Size, 0);
+			if (Received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (Received <= 0)
+			{
+				return false;
+			}
+			Bytes += Received;
+			Size -= SIZE_T(Received);
+		}
+		return true;
+	}
+
+	int32 ConnectTo(const FString& Path)
+	{
+		sockaddr_un Address;
+		if (!MakeAddress(Path, Address))
+		{
+			return -1;
+		}
+		const int32 Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (Socket >= 0 && connect(Socket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0)
+		{
+			close(Socket);
+			return -1;
+		}
+		return Socket;
+	}
+
+	/** One request and its reply, as a client sees it */
+	bool RoundTrip(int32 Socket, const std::vector<Command>& Commands, std::vector<Result>& OutResults)
+	{
+		uint32 NumCommands = uint32(Commands.size());
+		uint32 NumResults = 0;
+		if (!SendAll(Socket, &NumCommands, sizeof(NumCommands)) || !SendAll(Socket, Commands.data(), Commands.size() * sizeof(Command))
+			|| !ReceiveAll(Socket, &NumResults, sizeof(NumResults)) || NumResults != NumCommands)
+		{
+			return false;
+		}
+		OutResults.resize(NumResults);
+		return ReceiveAll(Socket, OutResults.data(), OutResults.size() * sizeof(Result));
+	}
+#endif
+}
+
+MineSweeperServer::PendingRing::PendingRing(int32 Capacity)
+{
+	const uint64 Size = FMath::RoundUpToPowerOfTwo64(uint64(FMath::Max(Capacity, 2)));
+	Slots = MakeUnique<Slot[]>(Size);
+	Mask = Size - 1;
+	for (uint64 Index = 0; Index < Size; Index++)
+	{
+		Slots[Index].Sequence.store(Index, std::memory_order_relaxed);
+	}
+}
+
+bool MineSweeperServer::PendingRing::Enqueue(const Pending& Item)
+{
+	uint64 Position = Tail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot& Target = Slots[Position & Mask];
+		// A slot is free for the producer at Position once the consumer has set its sequence back to Position
+		const int64 Lag = int64(Target.Sequence.load(std::memory_order_acquire)) - int64(Position);
+		if (Lag == 0)
+		{
+			if (Tail.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+			{
+				Target.Item = Item;
+				Target.Sequence.store(Position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Lag < 0)
+		{
+			return false; // Still holding an item from a lap ago
+		}
+		else
+		{
+			Position = Tail.load(std::memory_order_relaxed); // Another producer took it first
+		}
+	}
+}
+
+bool MineSweeperServer::PendingRing::Dequeue(Pending& OutItem)
+{
+	Slot& Target = Slots[Head & Mask];
+	if (Target.Sequence.load(std::memory_order_acquire) != Head + 1)
+	{
+		return false;
+	}
+	OutItem = Target.Item;
+	Target.Sequence.store(Head + Mask + 1, std::memory_order_release); // Free for the producer one lap on
+	Head++;
+	return true;
+}
+
+MineSweeperServer::~MineSweeperServer()
+{
+	Stop();
+}
+
+FString MineSweeperServer::GetDefaultSocketPath()
+{
+	// Saved/ would be the obvious place, but socket paths have to fit in about a hundred bytes
+	return FPaths::Combine(FPlatformProcess::UserTempDir(), TEXT("MineSweeper.sock"));
+}
+
+bool MineSweeperServer::Start(const FString& SocketPath, int32 NumShards)
+{
+#if MINESWEEPER_SERVER_SUPPORTED
+	if (bRunning)
+	{
+		return false;
+	}
+	sockaddr_un Address;
+	if (!MakeAddress(SocketPath, Address))
+	{
+		return false;
+	}
+	unlink(Address.sun_path); // Left behind by a server that didn't shut down cleanly
+	ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ListenSocket < 0 || bind(ListenSocket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0 || listen(ListenSocket, 64) != 0)
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("Couldn't listen on %s (errno %d)"), *SocketPath, errno);
+		if (ListenSocket >= 0)
+		{
+			close(ListenSocket);
+			ListenSocket = -1;
+		}
+		return false;
+	}
+	Path = SocketPath;
+	bRunning = true;
+	bStopShards = false;
+
+	NumShards = NumShards > 0 ? NumShards : FPlatformMisc::NumberOfCores();
+	{
+		FRWScopeLock ScopeLock(ShardsLock, SLT_Write);
+		for (int32 Index = 0; Index < NumShards; Index++)
+		{
+			Shard& NewShard = *Shards.Add_GetRef(MakeUnique<Shard>());
+			NewShard.Wake = FPlatformProcess::GetSynchEventFromPool();
+			NewShard.Thread = Async(EAsyncExecution::Thread, [this, &NewShard]() { RunShard(NewShard); });
+		}
+	}
+	ResetStats();
+	AcceptThread = Async(EAsyncExecution::Thread, [this]() { AcceptConnections(); });
+	UE_LOG(MineSweeperLog, Log, TEXT("MineSweeper server listening on %s with %d shards"), *Path, NumShards);
+	return true;
+#else
+	UE_LOG(MineSweeperLog, Error, TEXT("The MineSweeper server needs Unix domain sockets, which this platform doesn't have"));
+	return false;
+#endif
+}
+
+void MineSweeperServer::Stop()
+{
+#if MINESWEEPER_SERVER_SUPPORTED
+	if (!bRunning.exchange(false))
+	{
+		return;
+	}
+	// Connections go first, and the shards keep running until they have, so no batch is left waiting on a dead shard
+	shutdown(ListenSocket, SHUT_RDWR);
+	close(ListenSocket);
+	ListenSocket = -1;
+	AcceptThread.Wait();
+	{
+		FScopeLock ScopeLock(&ConnectionsLock);
+		for (int32 Connection : Connections)
+		{
+			shutdown(Connection, SHUT_RDWR);
+		}
+	}
+	while (NumConnectionThreads > 0)
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	// In process callers can still be in Execute, and this waits for their batches to be answered before the shards go
+	FRWScopeLock ScopeLock(ShardsLock, SLT_Write);
+	bStopShards = true;
+	for (TUniquePtr<Shard>& Each : Shards)
+	{
+		Each->Wake->Trigger();
+		Each->Thread.Wait();
+		FPlatformProcess::ReturnSynchEventToPool(Each->Wake);
+	}
+	Shards.Reset();
+	unlink(TCHAR_TO_UTF8(*Path));
+	UE_LOG(MineSweeperLog, Log, TEXT("MineSweeper server on %s stopped"), *Path);
+#endif
+}
+
+void MineSweeperServer::Execute(const Command* Commands, int32 NumCommands, Result* OutResults)
+{
+	if (NumCommands <= 0)
+	{
+		return;
+	}
+	FRWScopeLock ScopeLock(ShardsLock, SLT_ReadOnly);
+	if (Shards.Num() == 0 || bStopShards)
+	{
+		for (int32 Index = 0; Index < NumCommands; Index++)
+		{
+			OutResults[Index] = Result();
+			OutResults[Index].SessionId = Commands[Index].SessionId;
+			OutResults[Index].Op = Commands[Index].Op;
+			OutResults[Index].Status = EStatus::NoSession;
+		}
+		return;
+	}
+	Batch NewBatch;
+	NewBatch.Commands = Commands;
+	NewBatch.Results = OutResults;
+	NewBatch.Remaining = NumCommands;
+	NewBatch.Done = FPlatformProcess::GetSynchEventFromPool();
+
+	// Each shard is only woken once for the whole batch, after all of its commands are queued
+	TArray<bool, TInlineAllocator<64>> Touched;
+	Touched.SetNumZeroed(Shards.Num());
+	const uint64 Now = FPlatformTime::Cycles64();
+	for (int32 Index = 0; Index < NumCommands; Index++)
+	{
+		const int32 ShardIndex = int32(Commands[Index].SessionId % uint32(Shards.Num()));
+		Shard& Target = *Shards[ShardIndex];
+		while (!Target.Queue.Enqueue({ &NewBatch, Index, Now }))
+		{
+			// A batch bigger than the ring, or lots of connections on one shard. Make sure it's awake and let it drain.
+			Target.Wake->Trigger();
+			FPlatformProcess::Yield();
+		}
+		Touched[ShardIndex] = true;
+	}
+	for (int32 ShardIndex = 0; ShardIndex < Shards.Num(); ShardIndex++)
+	{
+		if (Touched[ShardIndex])
+		{
+			Shards[ShardIndex]->Wake->Trigger();
+		}
+	}
+	NewBatch.Done->Wait();
+	FPlatformProcess::ReturnSynchEventToPool(NewBatch.Done);
+}
+
+void MineSweeperServer::RunShard(Shard& InShard)
+{
+	while (true)
+	{
+		Pending Item;
+		bool bWorked = false;
+		while (InShard.Queue.Dequeue(Item))
+		{
+			bWorked = true;
+			Batch& Owner = *Item.Owner;
+			Owner.Results[Item.Index] = RunCommand(InShard, Owner.Commands[Item.Index]);
+
+			const double Microseconds = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - Item.EnqueueCycles) * 1000.0;
+			InShard.Latency[MineSweeperLatencyHistogram::GetBucket(Microseconds, NumLatencyBuckets)].fetch_add(1, std::memory_order_relaxed);
+			InShard.NumCommands.fetch_add(1, std::memory_order_relaxed);
+
+			// The batch can be gone the moment the last command is counted, so the event is read before that
+			FEvent* Done = Owner.Done;
+			if (Owner.Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Done->Trigger();
+			}
+		}
+		if (!bWorked)
+		{
+			if (bStopShards)
+			{
+				break;
+			}
+			InShard.Wake->Wait(10);
+		}
+	}
+	InShard.Sessions.Reset();
+	InShard.NumSessions = 0;
+}
+
+Result MineSweeperServer::RunCommand(Shard& InShard, const Command& InCommand)
+{
+	Result Out;
+	Out.SessionId = InCommand.SessionId;
+	Out.Op = InCommand.Op;
+
+	if (InCommand.Op == EOp::Create)
+	{
+		const int32 NumTiles = int32(InCommand.Width) * int32(InCommand.Height);
+		if (NumTiles <= 0 || NumTiles > (1 << 20) || InCommand.NumMines >= NumTiles)
+		{
+			Out.Status = EStatus::Invalid;
+			return Out;
+		}
+		LLM_SCOPE_BYTAG(MineSweeper_State);
+		Session& Target = InShard.Sessions.FindOrAdd(InCommand.SessionId);
+		if (!Target.Grid.IsValid())
+		{
+			InShard.NumSessions++;
+		}
+		if (!Target.Grid.IsValid() || Target.Grid->GetWidth() != InCommand.Width || Target.Grid->GetHeight() != InCommand.Height)
+		{
+			Target.Grid = MakeMineSweeperGrid(InCommand.Width, InCommand.Height);
+			Target.RevealedTiles.reserve(NumTiles);
+		}
+		// Same placement as a seeded game in the editor, so any session can be replayed there
+		RandomBoardGenerator Generator(true, InCommand.Arg);
+		Target.Grid->SetMines(Generator.Generate(InCommand.Width, InCommand.Height, InCommand.NumMines));
+		Target.bOver = false;
+		Out.RemainingSafeTiles = Target.Grid->GetRemainingSafeTiles();
+		return Out;
+	}
+
+	Session* Target = InShard.Sessions.Find(InCommand.SessionId);
+	if (Target == nullptr)
+	{
+		Out.Status = EStatus::NoSession;
+		return Out;
+	}
+	if (InCommand.Op == EOp::Close)
+	{
+		InShard.Sessions.Remove(InCommand.SessionId);
+		InShard.NumSessions--;
+		return Out;
+	}
+
+	MineSweeperGrid& Grid = *Target->Grid;
+	Out.RemainingSafeTiles = Grid.GetRemainingSafeTiles();
+	if (Target->bOver)
+	{
+		Out.Status = EStatus::GameOver;
+		return Out;
+	}
+	if (InCommand.Arg < 0 || InCommand.Arg >= Grid.Num())
+	{
+		Out.Status = EStatus::Invalid;
+		return Out;
+	}
+
+	if (InCommand.Op == EOp::Flag)
+	{
+		Out.NumChanged = Grid.ToggleFlag(InCommand.Arg) ? 1 : 0;
+		return Out;
+	}
+
+	Target->RevealedTiles.clear();
+	Grid.IsRevealed(InCommand.Arg) ? Grid.Chord(InCommand.Arg, Target->RevealedTiles) : Grid.Reveal(InCommand.Arg, Target->RevealedTiles);
+	bool bHitMine = false;
+	for (int32 Tile : Target->RevealedTiles)
+	{
+		bHitMine |= Grid.IsMine(Tile);
+	}
+	Out.NumChanged = uint16(FMath::Min<SIZE_T>(Target->RevealedTiles.size(), 0xFFFF));
+	Out.RemainingSafeTiles = Grid.GetRemainingSafeTiles();
+	if (bHitMine || Out.RemainingSafeTiles == 0)
+	{
+		Out.Status = bHitMine ? EStatus::Lost : EStatus::Won;
+		Target->bOver = true;
+	}
+	return Out;
+}
+
+void MineSweeperServer::AcceptConnections()
+{
+#if MINESWEEPER_SERVER_SUPPORTED
+	while (bRunning)
+	{
+		pollfd Listen = { ListenSocket, POLLIN, 0 };
+		if (poll(&Listen, 1, 100) <= 0 || !bRunning)
+		{
+			continue;
+		}
+		const int32 Connection = accept(ListenSocket, nullptr, nullptr);
+		if (Connection < 0)
+		{
+			continue;
+		}
+		{
+			FScopeLock ScopeLock(&ConnectionsLock);
+			Connections.Add(Connection);
+		}
+		NumConnectionThreads++;
+		Async(EAsyncExecution::Thread, [this, Connection]() { ServeConnection(Connection); });
+	}
+#endif
+}
+
+void MineSweeperServer::ServeConnection(int32 Connection)
+{
+#if MINESWEEPER_SERVER_SUPPORTED
+	// Grown to the biggest batch this connection has sent and then reused, so steady traffic doesn't allocate here
+	std::vector<Command> Commands;
+	std::vector<Result> Results;
+	uint32 NumCommands = 0;
+	while (bRunning && ReceiveAll(Connection, &NumCommands, sizeof(NumCommands)) && NumCommands <= MaxBatch)
+	{
+		Commands.resize(NumCommands);
+		Results.resize(NumCommands);
+		if (!ReceiveAll(Connection, Commands.data(), Commands.size() * sizeof(Command)))
+		{
+			break;
+		}
+		Execute(Commands.data(), int32(NumCommands), Results.data());
+		if (!SendAll(Connection, &NumCommands, sizeof(NumCommands)) || !SendAll(Connection, Results.data(), Results.size() * sizeof(Result)))
+		{
+			break;
+		}
+	}
+	{
+		FScopeLock ScopeLock(&ConnectionsLock);
+		Connections.Remove(Connection);
+	}
+	close(Connection);
+	NumConnectionThreads--;
+#endif
+}
+
+MineSweeperServerStats MineSweeperServer::GetStats() const
+{
+	MineSweeperServerStats Stats;
+	uint64 Buckets[NumLatencyBuckets] = {};
+	FRWScopeLock ScopeLock(ShardsLock, SLT_ReadOnly);
+	for (const TUniquePtr<Shard>& Each : Shards)
+	{
+		Stats.NumCommands += Each->NumCommands.load(std::memory_order_relaxed);
+		Stats.NumSessions += Each->NumSessions.load(std::memory_order_relaxed);
+		for (int32 Bucket = 0; Bucket < NumLatencyBuckets; Bucket++)
+		{
+			Buckets[Bucket] += Each->Latency[Bucket].load(std::memory_order_relaxed);
+		}
+	}
+	Stats.Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StatsStartCycles.load());
+
+	Stats.P50Us = MineSweeperLatencyHistogram::GetPercentileMicroseconds(Buckets, NumLatencyBuckets, 0.5);
+	Stats.P90Us = MineSweeperLatencyHistogram::GetPercentileMicroseconds(Buckets, NumLatencyBuckets, 0.9);
+	Stats.P99Us = MineSweeperLatencyHistogram::GetPercentileMicroseconds(Buckets, NumLatencyBuckets, 0.99);
+	Stats.MaxUs = MineSweeperLatencyHistogram::GetPercentileMicroseconds(Buckets, NumLatencyBuckets, 1.0);
+	return Stats;
+}
+
+void MineSweeperServer::ResetStats()
+{
+	FRWScopeLock ScopeLock(ShardsLock, SLT_ReadOnly); // The counters are atomic, it's only the shards themselves that need keeping
+	for (TUniquePtr<Shard>& Each : Shards)
+	{
+		Each->NumCommands = 0;
+		for (std::atomic<uint64>& Bucket : Each->Latency)
+		{
+			Bucket = 0;
+		}
+	}
+	StatsStartCycles = FPlatformTime::Cycles64();
+}
+
+namespace MineSweeperServerCommands
+{
+	static TSharedPtr<MineSweeperServer, ESPMode::ThreadSafe> RunningServer; // Only touched on the game thread
+
+	static void StartServer(const FString& SocketPath, int32 NumShards)
+	{
+		if (RunningServer.IsValid())
+		{
+			UE_LOG(MineSweeperLog, Warning, TEXT("The MineSweeper server is already running"));
+			return;
+		}
+		TSharedRef<MineSweeperServer, ESPMode::ThreadSafe> NewServer = MakeShared<MineSweeperServer, ESPMode::ThreadSafe>();
+		if (NewServer->Start(SocketPath, NumShards))
+		{
+			RunningServer = NewServer;
+		}
+	}
+
+	static void LogStats(const MineSweeperServerStats& Stats)
+	{
+		UE_LOG(MineSweeperLog, Log, TEXT("%lld commands in %.2f s (%.0f/s) over %d sessions. Latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us"),
+			Stats.NumCommands, Stats.Seconds, Stats.GetCommandsPerSecond(), Stats.NumSessions, Stats.P50Us, Stats.P90Us, Stats.P99Us, Stats.MaxUs);
+	}
+
+#if MINESWEEPER_SERVER_SUPPORTED
+	/**
+	* One load generator connection. It creates its own range of sessions, then sends batches of random reveals until
+	* the time is up, restarting any session whose game ends with a new seed.
+	*/
+	static void RunLoadClient(const FString& SocketPath, uint32 FirstSession, int32 NumSessions, int32 BatchSize, double Deadline, std::atomic<int64>& OutBatches, std::atomic<int64>& OutRoundTripCycles)
+	{
+		const int32 Socket = ConnectTo(SocketPath);
+		if (Socket < 0)
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Load generator couldn't connect to %s"), *SocketPath);
+			return;
+		}
+		FRandomStream Stream(int32(FirstSession));
+		const auto MakeCreate = [&Stream](uint32 SessionId)
+			{
+				Command Create;
+				Create.SessionId = SessionId;
+				Create.Op = EOp::Create;
+				Create.Width = 30;
+				Create.Height = 16;
+				Create.NumMines = 99;
+				Create.Arg = int32(Stream.GetUnsignedInt());
+				return Create;
+			};
+
+		std::vector<Command> Commands;
+		std::vector<Result> Results;
+		for (int32 Index = 0; Index < NumSessions; Index++)
+		{
+			Commands.push_back(MakeCreate(FirstSession + Index));
+		}
+		bool bConnected = RoundTrip(Socket, Commands, Results);
+
+		std::vector<bool> NeedsCreate(NumSessions, false);
+		while (bConnected && FPlatformTime::Seconds() < Deadline)
+		{
+			Commands.clear();
+			for (int32 Index = 0; Index < BatchSize; Index++)
+			{
+				const int32 Local = Stream.RandRange(0, NumSessions - 1);
+				if (NeedsCreate[Local])
+				{
+					NeedsCreate[Local] = false;
+					Commands.push_back(MakeCreate(FirstSession + Local));
+					continue;
+				}
+				Command Reveal;
+				Reveal.SessionId = FirstSession + Local;
+				Reveal.Op = EOp::Reveal;
+				Reveal.Arg = Stream.RandRange(0, 30 * 16 - 1);
+				Commands.push_back(Reveal);
+			}
+			const uint64 Start = FPlatformTime::Cycles64();
+			bConnected = RoundTrip(Socket, Commands, Results);
+			OutRoundTripCycles += FPlatformTime::Cycles64() - Start;
+			OutBatches++;
+			for (const Result& Each : Results)
+			{
+				if (Each.Status == EStatus::Lost || Each.Status == EStatus::Won || Each.Status == EStatus::GameOver)
+				{
+					NeedsCreate[Each.SessionId - FirstSession] = true;
+				}
+			}
+		}
+		close(Socket);
+	}
+#endif
+
+	static FAutoConsoleCommand ServerStartCommand(
+		TEXT("MineSweeper.Server.Start"),
+		TEXT("Starts the headless game server. Optional arguments: socket path (default in the temp directory), worker threads (default one per core)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				StartServer(Args.Num() > 0 ? Args[0] : MineSweeperServer::GetDefaultSocketPath(), Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0);
+			}));
+
+	static FAutoConsoleCommand ServerStopCommand(
+		TEXT("MineSweeper.Server.Stop"),
+		TEXT("Stops the headless game server."),
+		FConsoleCommandDelegate::CreateLambda([]()
+			{
+				if (RunningServer.IsValid())
+				{
+					LogStats(RunningServer->GetStats());
+					RunningServer->Stop();
+					RunningServer.Reset();
+				}
+			}));
+
+	static FAutoConsoleCommand ServerStatsCommand(
+		TEXT("MineSweeper.Server.Stats"),
+		TEXT("Logs the server's command latency percentiles and throughput since it started or since the last load test."),
+		FConsoleCommandDelegate::CreateLambda([]()
+			{
+				if (RunningServer.IsValid())
+				{
+					LogStats(RunningServer->GetStats());
+				}
+			}));
+
+	static FAutoConsoleCommand ServerLoadTestCommand(
+		TEXT("MineSweeper.Server.LoadTest"),
+		TEXT("Drives the server with random expert games and reports sustained moves per second and latency. Starts a server if none is running. Optional arguments: connections (default 8), sessions (default 4096), seconds (default 10), commands per batch (default 64)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+#if MINESWEEPER_SERVER_SUPPORTED
+				const int32 NumClients = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 8;
+				const int32 NumSessions = Args.Num() > 1 ? FMath::Max(NumClients, FCString::Atoi(*Args[1])) : 4096;
+				const double Seconds = Args.Num() > 2 ? FMath::Max(1.0, FCString::Atod(*Args[2])) : 10.0;
+				const int32 BatchSize = Args.Num() > 3 ? FMath::Clamp(FCString::Atoi(*Args[3]), 1, int32(MaxBatch)) : 64;
+				if (!RunningServer.IsValid())
+				{
+					StartServer(MineSweeperServer::GetDefaultSocketPath(), 0);
+				}
+				if (!RunningServer.IsValid())
+				{
+					return;
+				}
+
+				// Runs off the game thread, and holds its own reference so a Stop in the middle can't pull the server out from under it.
+				// The path is read here, where Start writes it.
+				Async(EAsyncExecution::Thread, [Server = RunningServer, SocketPath = RunningServer->GetSocketPath(), NumClients, NumSessions, Seconds, BatchSize]()
+					{
+						std::atomic<int64> Batches = 0;
+						std::atomic<int64> RoundTripCycles = 0;
+						const double Deadline = FPlatformTime::Seconds() + Seconds;
+						Server->ResetStats();
+						TArray<TFuture<void>> Clients;
+						for (int32 Client = 0; Client < NumClients; Client++)
+						{
+							const int32 First = NumSessions * Client / NumClients;
+							const int32 Last = NumSessions * (Client + 1) / NumClients;
+							Clients.Add(Async(EAsyncExecution::Thread, [&, First, Last]()
+								{
+									RunLoadClient(SocketPath, uint32(First), Last - First, BatchSize, Deadline, Batches, RoundTripCycles);
+								}));
+						}
+						for (TFuture<void>& Client : Clients)
+						{
+							Client.Wait();
+						}
+						UE_LOG(MineSweeperLog, Log, TEXT("Load test: %d connections, %d sessions, batches of %d, avg round trip %.1f us"),
+							NumClients, NumSessions, BatchSize, FPlatformTime::ToMilliseconds64(RoundTripCycles.load()) * 1000.0 / FMath::Max<int64>(1, Batches.load()));
+						LogStats(Server->GetStats());
+					});
+#else
+				UE_LOG(MineSweeperLog, Error, TEXT("The MineSweeper server needs Unix domain sockets, which this platform doesn't have"));
+#endif
+			}));
+}
+
+void MineSweeperServer::StopRunning()
+{
+	using namespace MineSweeperServerCommands;
+	if (RunningServer.IsValid())
+	{
+		RunningServer->Stop();
+		RunningServer.Reset();
+	}
+}
+
+void MineSweeperServer::StartIfRequested()
+{
+	if (!FParse::Param(FCommandLine::Get(), TEXT("MineSweeperServer")) && !FCString::Strifind(FCommandLine::Get(), TEXT("-MineSweeperServer=")))
+	{
+		return;
+	}
+	FString SocketPath = GetDefaultSocketPath();
+	FParse::Value(FCommandLine::Get(), TEXT("MineSweeperServer="), SocketPath);
+	FCoreDelegates::OnFEngineLoopInitComplete.AddLambda([SocketPath]()
+		{
+			MineSweeperServerCommands::StartServer(SocketPath, 0);
+		});
+}
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperSnapshot.h"
+
+MineSweeperSnapshotPublisher::MineSweeperSnapshotPublisher()
+	: LatestVersion(MakeShared<std::atomic<uint64>, ESPMode::ThreadSafe>(0))
+{
+}
+
+void MineSweeperSnapshotPublisher::Invalidate()
+{
+	bNeedsRebuild = true;
+	DirtyTiles.clear();
+	GameId++;
+	LatestVersion->fetch_add(1, std::memory_order_relaxed);
+}
+
+void MineSweeperSnapshotPublisher::MarkDirty(const std::vector<int32>& Tiles)
+{
+	if (Tiles.empty())
+	{
+		return;
+	}
+	if (!bNeedsRebuild)
+	{
+		DirtyTiles.insert(DirtyTiles.end(), Tiles.begin(), Tiles.end());
+	}
+	LatestVersion->fetch_add(1, std::memory_order_relaxed);
+}
+
+void MineSweeperSnapshotPublisher::Rebuild(const MineSweeperGrid& Grid)
+{
+	TSharedRef<MineSweeperSnapshot::Game, ESPMode::ThreadSafe> NewGame = MakeShared<MineSweeperSnapshot::Game, ESPMode::ThreadSafe>();
+	NewGame->GameId = GameId;
+	NewGame->Dims = { Grid.GetWidth(), Grid.GetHeight(), Grid.GetDepth() };
+	NewGame->NumMines = Grid.GetNumMines();
+	NewGame->Table = Grid.GetNeighborTable(); // Only non-square grids have one, and the snapshot just shares it
+	NewGame->Counts.resize(Grid.Num());
+	for (int32 Tile = 0; Tile < Grid.Num(); Tile++)
+	{
+		NewGame->Counts[Tile] = uint8(Grid.GetAdjacentMines(Tile));
+	}
+
+	TSharedRef<MineSweeperSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<MineSweeperSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->Version = GetVersion();
+	Snapshot->SharedGame = NewGame;
+	Snapshot->LatestVersion = LatestVersion;
+	const int32 NumPages = (Grid.Num() + MineSweeperSnapshot::PageTiles - 1) >> MineSweeperSnapshot::PageShift;
+	Snapshot->Pages.reserve(NumPages);
+	for (int32 PageIndex = 0; PageIndex < NumPages; PageIndex++)
+	{
+		TSharedRef<MineSweeperSnapshot::Page, ESPMode::ThreadSafe> NewPage = MakeShared<MineSweeperSnapshot::Page, ESPMode::ThreadSafe>();
+		const int32 First = PageIndex << MineSweeperSnapshot::PageShift;
+		const int32 Last = FMath::Min(First + MineSweeperSnapshot::PageTiles, Grid.Num());
+		for (int32 Tile = First; Tile < Last; Tile++)
+		{
+			if (Grid.IsRevealed(Tile))
+			{
+				MineSweeperBits::Set(NewPage->Revealed, Tile - First);
+			}
+			if (Grid.IsFlagged(Tile))
+			{
+				MineSweeperBits::Set(NewPage->Flagged, Tile - First);
+			}
+		}
+		Snapshot->Pages.push_back(NewPage);
+	}
+	Latest = Snapshot;
+	bNeedsRebuild = false;
+	DirtyTiles.clear();
+	DirtyTiles.reserve(Grid.Num()); // So marking moves dirty doesn't allocate, unless a lot pile up between snapshots
+}
+
+MineSweeperSnapshotRef MineSweeperSnapshotPublisher::Publish(const MineSweeperGrid& Grid)
+{
+	if (bNeedsRebuild || !Latest.IsValid())
+	{
+		Rebuild(Grid);
+		return Latest.ToSharedRef();
+	}
+	if (Latest->Version == GetVersion())
+	{
+		return Latest.ToSharedRef();
+	}
+
+	TSharedRef<MineSweeperSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<MineSweeperSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->Version = GetVersion();
+	Snapshot->SharedGame = Latest->SharedGame;
+	Snapshot->LatestVersion = LatestVersion;
+	Snapshot->Pages = Latest->Pages;
+
+	// The first dirty tile on a page copies it, every later one on that page writes into the copy
+	TMap<int32, MineSweeperSnapshot::Page*> Copies;
+	for (int32 Tile : DirtyTiles)
+	{
+		const int32 PageIndex = Tile >> MineSweeperSnapshot::PageShift;
+		const int32 Bit = Tile & (MineSweeperSnapshot::PageTiles - 1);
+		MineSweeperSnapshot::Page*& Writable = Copies.FindOrAdd(PageIndex, nullptr);
+		if (Writable == nullptr)
+		{
+			TSharedRef<MineSweeperSnapshot::Page, ESPMode::ThreadSafe> Copy = MakeShared<MineSweeperSnapshot::Page, ESPMode::ThreadSafe>(*Latest->Pages[PageIndex]);
+			Snapshot->Pages[PageIndex] = Copy;
+			Writable = &Copy.Get();
+		}
+		Grid.IsRevealed(Tile) ? MineSweeperBits::Set(Writable->Revealed, Bit) : MineSweeperBits::Clear(Writable->Revealed, Bit);
+		Grid.IsFlagged(Tile) ? MineSweeperBits::Set(Writable->Flagged, Bit) : MineSweeperBits::Clear(Writable->Flagged, Bit);
+	}
+	DirtyTiles.clear();
+	Latest = Snapshot;
+	return Snapshot;
+}
+
+SIZE_T MineSweeperSnapshotPublisher::GetAllocatedSize() const
+{
+	SIZE_T Size = DirtyTiles.capacity() * sizeof(int32);
+	if (Latest.IsValid())
+	{
+		Size += Latest->GetAllocatedSize() + Latest->Pages.size() * sizeof(MineSweeperSnapshot::Page);
+		Size += sizeof(MineSweeperSnapshot::Game) + Latest->SharedGame->Counts.capacity();
+	}
+	return Size;
+}
@@ -0,0 +1,504 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperSweep.h"
+#include "MineSweeperBoard.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+static TAutoConsoleVariable<float> CVarSweepCheckpointSeconds(
+	TEXT("MineSweeper.Sweep.CheckpointSeconds"),
+	10.0f,
+	TEXT("How often a running sweep writes its checkpoint."));
+
+static TAutoConsoleVariable<int32> CVarSweepMaxLaunches(
+	TEXT("MineSweeper.Sweep.MaxLaunches"),
+	3,
+	TEXT("How many times a sweep starts a shard's worker before giving up on it, counting the first."));
+
+namespace
+{
+	constexpr uint32 CheckpointMagic = 'M' | ('S' << 8) | ('C' << 16) | ('K' << 24);
+	constexpr uint32 CheckpointVersion = 1;
+
+	uint32 GetSharedMemoryAccess()
+	{
+		return uint32(FPlatformMemory::ESharedMemoryAccess::Read) | uint32(FPlatformMemory::ESharedMemoryAccess::Write);
+	}
+
+	/**
+	* Workers never need a window, so they run the command line build of whatever editor binary we are when there is
+	* one. Only Windows builds that, elsewhere the workers run this binary, which -MineSweeperShard keeps headless anyway.
+	*/
+	FString GetWorkerExecutable()
+	{
+		const FString Executable = FPlatformProcess::ExecutablePath();
+		const FString Name = FPaths::GetBaseFilename(Executable);
+		if (Name.EndsWith(TEXT("-Cmd")))
+		{
+			return Executable;
+		}
+		const FString CmdExecutable = FPaths::GetPath(Executable) / Name + TEXT("-Cmd") + FPaths::GetExtension(Executable, true);
+		return FPaths::FileExists(CmdExecutable) ? CmdExecutable : Executable;
+	}
+
+	void AddToHistogram(TArray<int64>& Histogram, int32 Value, int64 Count = 1)
+	{
+		if (Histogram.Num() <= Value)
+		{
+			Histogram.SetNumZeroed(Value + 1);
+		}
+		Histogram[Value] += Count;
+	}
+
+	void RunWorker(const FString& RegionName, uint32 ParentProcessId)
+	{
+		// The header says how big the rest of the region is, so it's mapped on its own first
+		FPlatformMemory::FSharedMemoryRegion* HeaderRegion = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, false, GetSharedMemoryAccess(), sizeof(MineSweeperShardHeader));
+		if (HeaderRegion == nullptr)
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Sweep worker couldn't open shared memory %s"), *RegionName);
+			return;
+		}
+		const int32 NumSeeds = static_cast<MineSweeperShardHeader*>(HeaderRegion->GetAddress())->NumSeeds;
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(HeaderRegion);
+
+		FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, false, GetSharedMemoryAccess(), MineSweeperShardHeader::GetRegionSize(NumSeeds));
+		MineSweeperShardHeader* Header = Region ? static_cast<MineSweeperShardHeader*>(Region->GetAddress()) : nullptr;
+		if (Header == nullptr || Header->Magic != MineSweeperShardHeader::ExpectedMagic)
+		{
+			UE_LOG(MineSweeperLog, Error, TEXT("Sweep worker found no shard in %s"), *RegionName);
+			if (Region)
+			{
+				FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+			}
+			return;
+		}
+
+		Header->State.store(MineSweeperShardHeader::Running, std::memory_order_release);
+		MineSweeperDifficultyAnalyzer Analyzer(Header->Width, Header->Height, Header->NumMines);
+		MineSweeperGameRecord* Records = Header->GetRecords();
+		for (int32 Index = 0; Index < Header->NumSeeds; Index++)
+		{
+			// If the editor that started us is gone nobody will read the rest, and a resumed sweep starts its own workers
+			if ((Index & 255) == 0 && ParentProcessId != 0 && !FPlatformProcess::IsApplicationRunning(ParentProcessId))
+			{
+				UE_LOG(MineSweeperLog, Warning, TEXT("Sweep worker stopping at %d of %d games, the process that started it has exited"), Index, Header->NumSeeds);
+				Header->State.store(MineSweeperShardHeader::Failed, std::memory_order_release);
+				FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+				return;
+			}
+			const int32 Seed = Header->FirstSeed + Index;
+			Records[Index] = MineSweeperGameRecord::Make(Seed, Analyzer.Analyze(Seed));
+			Header->NumWritten.store(Index + 1, std::memory_order_release);
+		}
+		Header->State.store(MineSweeperShardHeader::Done, std::memory_order_release);
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+	}
+}
+
+MineSweeperGameRecord MineSweeperGameRecord::Make(int32 Seed, const MineSweeperDifficulty& Difficulty)
+{
+	MineSweeperGameRecord Record;
+	Record.Seed = Seed;
+	Record.ThreeBV = uint16(FMath::Clamp(Difficulty.ThreeBV, 0, 0xFFFF));
+	Record.NumOpenings = uint16(FMath::Clamp(Difficulty.NumOpenings, 0, 0xFFFF));
+	Record.NumGuesses = uint16(FMath::Clamp(Difficulty.NumGuesses, 0, 0xFFFF));
+	Record.NumIslands = uint8(FMath::Clamp(Difficulty.NumIslands, 0, 0xFF));
+	Record.LargestIsland = uint8(FMath::Clamp(Difficulty.LargestIsland, 0, 0xFF));
+	return Record;
+}
+
+void MineSweeperSweepStats::Add(const MineSweeperGameRecord& Record)
+{
+	NumGames++;
+	NumNoGuessGames += Record.NumGuesses == 0;
+	AddToHistogram(ThreeBV, Record.ThreeBV);
+	AddToHistogram(NumOpenings, Record.NumOpenings);
+	AddToHistogram(NumGuesses, Record.NumGuesses);
+	AddToHistogram(NumIslands, Record.NumIslands);
+}
+
+void MineSweeperSweepStats::Merge(const MineSweeperSweepStats& Other)
+{
+	NumGames += Other.NumGames;
+	NumNoGuessGames += Other.NumNoGuessGames;
+	const auto MergeHistogram = [](TArray<int64>& Into, const TArray<int64>& From)
+		{
+			for (int32 Value = 0; Value < From.Num(); Value++)
+			{
+				AddToHistogram(Into, Value, From[Value]);
+			}
+		};
+	MergeHistogram(ThreeBV, Other.ThreeBV);
+	MergeHistogram(NumOpenings, Other.NumOpenings);
+	MergeHistogram(NumGuesses, Other.NumGuesses);
+	MergeHistogram(NumIslands, Other.NumIslands);
+}
+
+double MineSweeperSweepStats::GetMean(const TArray<int64>& Histogram)
+{
+	double Sum = 0.0;
+	int64 Count = 0;
+	for (int32 Value = 0; Value < Histogram.Num(); Value++)
+	{
+		Sum += double(Value) * Histogram[Value];
+		Count += Histogram[Value];
+	}
+	return Count > 0 ? Sum / Count : 0.0;
+}
+
+int32 MineSweeperSweepStats::GetPercentile(const TArray<int64>& Histogram, double Percentile)
+{
+	int64 Total = 0;
+	for (int64 Count : Histogram)
+	{
+		Total += Count;
+	}
+	const double Target = Total * FMath::Clamp(Percentile, 0.0, 1.0);
+	int64 Seen = 0;
+	for (int32 Value = 0; Value < Histogram.Num(); Value++)
+	{
+		Seen += Histogram[Value];
+		if (Seen > 0 && Seen >= Target)
+		{
+			return Value;
+		}
+	}
+	return 0;
+}
+
+FArchive& operator<<(FArchive& Ar, MineSweeperSweepStats& Stats)
+{
+	return Ar << Stats.NumGames << Stats.NumNoGuessGames << Stats.ThreeBV << Stats.NumOpenings << Stats.NumGuesses << Stats.NumIslands;
+}
+
+MineSweeperSweepRunner::MineSweeperSweepRunner(const Settings& InSettings)
+	: SweepSettings(InSettings)
+{
+}
+
+MineSweeperSweepRunner::~MineSweeperSweepRunner()
+{
+	for (Shard& Each : Shards)
+	{
+		Release(Each, true);
+	}
+}
+
+FString MineSweeperSweepRunner::GetCheckpointPath() const
+{
+	return FPaths::ProjectSavedDir() / TEXT("MineSweeper") / FString::Printf(TEXT("Sweep_%dx%d_%d_%d_%d.ckpt"),
+		SweepSettings.Width, SweepSettings.Height, SweepSettings.NumMines, SweepSettings.FirstSeed, SweepSettings.NumSeeds);
+}
+
+bool MineSweeperSweepRunner::Run()
+{
+	if (!LoadCheckpoint())
+	{
+		// Worker count only matters for a fresh sweep, a resumed one keeps the shards it was checkpointed with
+		const int32 NumWorkers = FMath::Clamp(SweepSettings.NumWorkers > 0 ? SweepSettings.NumWorkers : FPlatformMisc::NumberOfCores(), 1, FMath::Max(1, SweepSettings.NumSeeds));
+		Shards.Reset();
+		Stats = MineSweeperSweepStats();
+		for (int32 Index = 0; Index < NumWorkers; Index++)
+		{
+			Shard& NewShard = Shards.AddDefaulted_GetRef();
+			const int64 First = int64(SweepSettings.NumSeeds) * Index / NumWorkers;
+			const int64 Last = int64(SweepSettings.NumSeeds) * (Index + 1) / NumWorkers;
+			NewShard.FirstSeed = SweepSettings.FirstSeed + int32(First);
+			NewShard.NumSeeds = int32(Last - First);
+		}
+	}
+	else
+	{
+		UE_LOG(MineSweeperLog, Log, TEXT("Resuming sweep from %s with %lld games already done"), *GetCheckpointPath(), Stats.NumGames);
+	}
+
+	for (int32 Index = 0; Index < Shards.Num(); Index++)
+	{
+		if (!Shards[Index].IsComplete())
+		{
+			Launch(Index);
+		}
+	}
+
+	double LastCheckpoint = FPlatformTime::Seconds();
+	while (true)
+	{
+		const bool bCancel = bCancelled;
+		bool bAnyActive = false;
+		for (int32 Index = 0; Index < Shards.Num(); Index++)
+		{
+			Shard& Each = Shards[Index];
+			if (Each.Region != nullptr && (Poll(Each) || bCancel))
+			{
+				Release(Each, bCancel);
+				if (!Each.IsComplete() && !bCancel)
+				{
+					if (Each.NumLaunches < CVarSweepMaxLaunches.GetValueOnAnyThread())
+					{
+						UE_LOG(MineSweeperLog, Warning, TEXT("Sweep worker for shard %d stopped at %d of %d games, starting it again"), Index, Each.NumDone, Each.NumSeeds);
+						// The new worker's handle goes in the same place, so the old one is closed first or it leaks, zombie and all
+						if (Each.Process.IsValid())
+						{
+							if (FPlatformProcess::IsProcRunning(Each.Process))
+							{
+								FPlatformProcess::TerminateProc(Each.Process, true);
+							}
+							FPlatformProcess::CloseProc(Each.Process);
+						}
+						Launch(Index);
+					}
+					else
+					{
+						UE_LOG(MineSweeperLog, Error, TEXT("Giving up on shard %d at %d of %d games"), Index, Each.NumDone, Each.NumSeeds);
+					}
+				}
+			}
+			// A worker that's written everything still has to shut the engine down, and the handle is kept until it has.
+			// Cancelling doesn't wait for that, so nothing is left running behind a sweep that's stopped.
+			if (Each.Region == nullptr && Each.Process.IsValid() && (bCancel || !FPlatformProcess::IsProcRunning(Each.Process)))
+			{
+				if (bCancel)
+				{
+					FPlatformProcess::TerminateProc(Each.Process, true);
+				}
+				FPlatformProcess::CloseProc(Each.Process);
+			}
+			bAnyActive |= Each.Region != nullptr || Each.Process.IsValid();
+		}
+		if (!bAnyActive)
+		{
+			break;
+		}
+		if (FPlatformTime::Seconds() - LastCheckpoint >= CVarSweepCheckpointSeconds.GetValueOnAnyThread())
+		{
+			SaveCheckpoint();
+			LastCheckpoint = FPlatformTime::Seconds();
+		}
+		FPlatformProcess::Sleep(0.05f);
+	}
+	SaveCheckpoint();
+	return Stats.NumGames >= SweepSettings.NumSeeds;
+}
+
+bool MineSweeperSweepRunner::Launch(int32 ShardIndex)
+{
+	Shard& Target = Shards[ShardIndex];
+	const int32 Remaining = Target.NumSeeds - Target.NumDone;
+	const FString RegionName = FString::Printf(TEXT("MineSweeperShard_%u_%d_%d"), FPlatformProcess::GetCurrentProcessId(), ShardIndex, Target.NumLaunches);
+	Target.NumLaunches++;
+	Target.NumConsumed = 0;
+	Target.Region = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, true, GetSharedMemoryAccess(), MineSweeperShardHeader::GetRegionSize(Remaining));
+	if (Target.Region == nullptr)
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("Couldn't create %llu bytes of shared memory for shard %d"), uint64(MineSweeperShardHeader::GetRegionSize(Remaining)), ShardIndex);
+		return false;
+	}
+
+	MineSweeperShardHeader* Header = new (Target.Region->GetAddress()) MineSweeperShardHeader();
+	Header->Width = SweepSettings.Width;
+	Header->Height = SweepSettings.Height;
+	Header->NumMines = SweepSettings.NumMines;
+	Header->FirstSeed = Target.FirstSeed + Target.NumDone;
+	Header->NumSeeds = Remaining;
+	Header->Magic = MineSweeperShardHeader::ExpectedMagic;
+
+	const FString Params = FString::Printf(TEXT("\"%s\" -MineSweeperShard=%s -MineSweeperParent=%u -nullrhi -unattended -nosplash -nosound -nopause -log=MineSweeperShard_%d.log"),
+		*FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *RegionName, FPlatformProcess::GetCurrentProcessId(), ShardIndex);
+	Target.Process = FPlatformProcess::CreateProc(*GetWorkerExecutable(), *Params, false, true, true, nullptr, 0, nullptr, nullptr);
+	if (!Target.Process.IsValid())
+	{
+		UE_LOG(MineSweeperLog, Error, TEXT("Couldn't start a sweep worker for shard %d"), ShardIndex);
+		Release(Target, false);
+		return false;
+	}
+	return true;
+}
+
+void MineSweeperSweepRunner::Release(Shard& InShard, bool bTerminate)
+{
+	if (InShard.Region != nullptr)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(InShard.Region);
+		InShard.Region = nullptr;
+	}
+	if (bTerminate && InShard.Process.IsValid())
+	{
+		FPlatformProcess::TerminateProc(InShard.Process, true);
+		FPlatformProcess::CloseProc(InShard.Process);
+	}
+}
+
+bool MineSweeperSweepRunner::Poll(Shard& InShard)
+{
+	MineSweeperShardHeader* Header = InShard.GetHeader();
+	if (Header == nullptr)
+	{
+		return true;
+	}
+	// Checked before reading the count, so a worker that writes its last records and exits in between still has them merged
+	const bool bExited = !FPlatformProcess::IsProcRunning(InShard.Process);
+	const int32 NumWritten = Header->NumWritten.load(std::memory_order_acquire);
+	const MineSweeperGameRecord* Records = Header->GetRecords();
+	for (int32 Index = InShard.NumConsumed; Index < NumWritten; Index++)
+	{
+		Stats.Add(Records[Index]);
+	}
+	InShard.NumDone += NumWritten - InShard.NumConsumed;
+	InShard.NumConsumed = NumWritten;
+	return bExited || Header->State.load(std::memory_order_acquire) == MineSweeperShardHeader::Done;
+}
+
+bool MineSweeperSweepRunner::LoadCheckpoint()
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetCheckpointPath(), FILEREAD_Silent))
+	{
+		return false;
+	}
+	FMemoryReader Reader(Bytes);
+	SerializeCheckpoint(Reader);
+	if (Reader.IsError() || Shards.Num() == 0)
+	{
+		UE_LOG(MineSweeperLog, Warning, TEXT("Ignoring unreadable sweep checkpoint %s"), *GetCheckpointPath());
+		Shards.Reset();
+		Stats = MineSweeperSweepStats();
+		return false;
+	}
+	return true;
+}
+
+void MineSweeperSweepRunner::SaveCheckpoint()
+{
+	// Written next to the real one and moved over it, so a kill in the middle of writing leaves the last good checkpoint
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	SerializeCheckpoint(Writer);
+	const FString Path = GetCheckpointPath();
+	const FString TempPath = Path + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+	{
+		UE_LOG(MineSweeperLog, Warning, TEXT("Couldn't write sweep checkpoint %s"), *Path);
+	}
+}
+
+void MineSweeperSweepRunner::SerializeCheckpoint(FArchive& Ar)
+{
+	uint32 Magic = CheckpointMagic;
+	uint32 Version = CheckpointVersion;
+	Settings Saved = SweepSettings;
+	Ar << Magic << Version << Saved.Width << Saved.Height << Saved.NumMines << Saved.FirstSeed << Saved.NumSeeds;
+	if (Ar.IsLoading() && (Magic != CheckpointMagic || Version != CheckpointVersion || Saved.Width != SweepSettings.Width || Saved.Height != SweepSettings.Height
+		|| Saved.NumMines != SweepSettings.NumMines || Saved.FirstSeed != SweepSettings.FirstSeed || Saved.NumSeeds != SweepSettings.NumSeeds))
+	{
+		Ar.SetError();
+		return;
+	}
+
+	int32 NumShards = Shards.Num();
+	Ar << NumShards;
+	if (Ar.IsLoading())
+	{
+		Shards.Reset();
+		Shards.SetNum(FMath::Clamp(NumShards, 0, 4096));
+	}
+	for (Shard& Each : Shards)
+	{
+		Ar << Each.FirstSeed << Each.NumSeeds << Each.NumDone;
+	}
+	Ar << Stats;
+}
+
+void MineSweeperSweepRunner::RunWorkerIfRequested()
+{
+	FString RegionName;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("MineSweeperShard="), RegionName))
+	{
+		return;
+	}
+	uint32 ParentProcessId = 0;
+	FParse::Value(FCommandLine::Get(), TEXT("MineSweeperParent="), ParentProcessId);
+	FCoreDelegates::OnFEngineLoopInitComplete.AddLambda([RegionName, ParentProcessId]()
+		{
+			RunWorker(RegionName, ParentProcessId);
+			FPlatformMisc::RequestExit(false, TEXT("MineSweeperShard"));
+		});
+}
+
+namespace MineSweeperSweepCommands
+{
+	// Only touched on the game thread. The sweep is still running until its future is ready.
+	static TSharedPtr<MineSweeperSweepRunner, ESPMode::ThreadSafe> ActiveSweep;
+	static TFuture<void> ActiveSweepDone;
+
+	static FAutoConsoleCommand SweepCommand(
+		TEXT("MineSweeper.Sweep"),
+		TEXT("Plays headless games over a seed range in worker processes, merging the results and checkpointing as it goes. Running it again with the same arguments resumes. Optional arguments: width height mines (default expert), seeds (default 10000000), workers (default one per core), first seed (default 0)."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+			{
+				if (ActiveSweep.IsValid() && !ActiveSweepDone.IsReady())
+				{
+					UE_LOG(MineSweeperLog, Warning, TEXT("A sweep is already running, MineSweeper.Sweep.Cancel stops it"));
+					return;
+				}
+				MineSweeperSweepRunner::Settings Settings;
+				Settings.Width = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 30;
+				Settings.Height = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 16;
+				Settings.NumMines = Args.Num() > 2 ? FMath::Clamp(FCString::Atoi(*Args[2]), 0, Settings.Width * Settings.Height - 1) : 99;
+				Settings.NumSeeds = Args.Num() > 3 ? FMath::Max(1, FCString::Atoi(*Args[3])) : 10000000;
+				Settings.NumWorkers = Args.Num() > 4 ? FMath::Max(0, FCString::Atoi(*Args[4])) : 0;
+				Settings.FirstSeed = Args.Num() > 5 ? FCString::Atoi(*Args[5]) : 0;
+
+				ActiveSweep = MakeShared<MineSweeperSweepRunner, ESPMode::ThreadSafe>(Settings);
+				ActiveSweepDone = Async(EAsyncExecution::Thread, [Sweep = ActiveSweep, Settings]()
+					{
+						const double Start = FPlatformTime::Seconds();
+						const bool bComplete = Sweep->Run();
+						const double Elapsed = FPlatformTime::Seconds() - Start;
+						const MineSweeperSweepStats& Stats = Sweep->GetStats();
+						UE_LOG(MineSweeperLog, Log, TEXT("Sweep %s: %lld of %d games in %.1f s. 3BV avg %.2f, p50 %d, p90 %d, p99 %d. Guesses avg %.3f, %.2f%% need none. Islands avg %.2f."),
+							bComplete ? TEXT("complete") : TEXT("stopped"), Stats.NumGames, Settings.NumSeeds, Elapsed,
+							MineSweeperSweepStats::GetMean(Stats.ThreeBV), MineSweeperSweepStats::GetPercentile(Stats.ThreeBV, 0.5),
+							MineSweeperSweepStats::GetPercentile(Stats.ThreeBV, 0.9), MineSweeperSweepStats::GetPercentile(Stats.ThreeBV, 0.99),
+							MineSweeperSweepStats::GetMean(Stats.NumGuesses), 100.0 * Stats.NumNoGuessGames / FMath::Max<int64>(1, Stats.NumGames),
+							MineSweeperSweepStats::GetMean(Stats.NumIslands));
+						UE_LOG(MineSweeperLog, Log, TEXT("Checkpoint at %s"), *Sweep->GetCheckpointPath());
+					});
+			}));
+
+	static FAutoConsoleCommand SweepCancelCommand(
+		TEXT("MineSweeper.Sweep.Cancel"),
+		TEXT("Stops the running sweep. Its checkpoint keeps what was done, so running the same sweep again carries on from there."),
+		FConsoleCommandDelegate::CreateLambda([]()
+			{
+				if (ActiveSweep.IsValid())
+				{
+					ActiveSweep->Cancel();
+				}
+			}));
+}
+
+void MineSweeperSweepRunner::ShutdownActiveSweep()
+{
+	using namespace MineSweeperSweepCommands;
+	if (!ActiveSweep.IsValid())
+	{
+		return;
+	}
+	ActiveSweep->Cancel();
+	if (ActiveSweepDone.IsValid())
+	{
+		ActiveSweepDone.Wait();
+	}
+	ActiveSweepDone.Reset();
+	ActiveSweep.Reset();
+}
@@ -0,0 +1,271 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MineSweeperTopology.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	// Weak, so a table goes away with the last board using it instead of sitting in the cache. Only a handful of
+	// board shapes are ever live at once, so a short list is plenty.
+	FCriticalSection CacheLock;
+	TArray<TWeakPtr<const MineSweeperNeighborTable>> CachedTables;
+}
+
+TSharedRef<const MineSweeperNeighborTable> MineSweeperNeighborTable::Get(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims)
+{
+	{
+		FScopeLock Lock(&CacheLock);
+		for (const TWeakPtr<const MineSweeperNeighborTable>& Cached : CachedTables)
+		{
+			const TSharedPtr<const MineSweeperNeighborTable> Table = Cached.Pin();
+			if (Table.IsValid() && Table->Topology == Topology && Table->Dims == Dims)
+			{
+				return Table.ToSharedRef();
+			}
+		}
+	}
+
+	TSharedRef<const MineSweeperNeighborTable> Table = [&]()
+		{
+			switch (Topology)
+			{
+			case EMineSweeperTopology::Hex:
+				return Build<HexTopology>(Dims);
+			case EMineSweeperTopology::Triangle:
+				return Build<TriangleTopology>(Dims);
+			case EMineSweeperTopology::Cube:
+				return Build<CubeTopology>(Dims);
+			default:
+				return Build<SquareTopology>(Dims);
+			}
+		}();
+
+	FScopeLock Lock(&CacheLock);
+	CachedTables.RemoveAll([](const TWeakPtr<const MineSweeperNeighborTable>& Cached) { return !Cached.IsValid(); });
+	CachedTables.Add(Table);
+	return Table;
+}
+
+SIZE_T MineSweeperNeighborTable::GetCachedSize()
+{
+	FScopeLock Lock(&CacheLock);
+	SIZE_T Size = CachedTables.GetAllocatedSize();
+	for (const TWeakPtr<const MineSweeperNeighborTable>& Cached : CachedTables)
+	{
+		if (const TSharedPtr<const MineSweeperNeighborTable> Table = Cached.Pin())
+		{
+			Size += Table->GetAllocatedSize();
+		}
+	}
+	return Size;
+}
+
+SIZE_T MineSweeperNeighborTable::EstimateAllocatedSize(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims)
+{
+	int32 MaxNeighbors = 0;
+	switch (Topology)
+	{
+	case EMineSweeperTopology::Hex:
+		MaxNeighbors = HexTopology::MaxNeighbors;
+		break;
+	case EMineSweeperTopology::Triangle:
+		MaxNeighbors = TriangleTopology::MaxNeighbors;
+		break;
+	case EMineSweeperTopology::Cube:
+		MaxNeighbors = CubeTopology::MaxNeighbors;
+		break;
+	default:
+		if (Dims.Depth == 1)
+		{
+			return 0;
+		}
+		MaxNeighbors = SquareTopology::MaxNeighbors;
+		break;
+	}
+	// Every tile at its full count, edges have fewer so this errs on the big side
+	return sizeof(MineSweeperNeighborTable) + (SIZE_T(Dims.Num()) + 1 + SIZE_T(Dims.Num()) * MaxNeighbors) * sizeof(int32);
+}
+
+TopologyMineSweeperGrid::TopologyMineSweeperGrid(TSharedRef<const MineSweeperNeighborTable> InTable)
+	: Table(InTable)
+{
+	const int32 NumTiles = Table->Dims.Num();
+	Mines.resize((NumTiles + 63) / 64);
+	Revealed.resize((NumTiles + 63) / 64);
+	Flagged.resize((NumTiles + 63) / 64);
+	Counts.resize(NumTiles);
+	FlagCounts.resize(NumTiles);
+	HiddenCounts.resize(NumTiles);
+	Stack.reserve(NumTiles);
+	Clear();
+}
+
+void TopologyMineSweeperGrid::Clear()
+{
+	std::fill(Mines.begin(), Mines.end(), 0);
+	std::fill(Revealed.begin(), Revealed.end(), 0);
+	std::fill(Flagged.begin(), Flagged.end(), 0);
+	std::fill(Counts.begin(), Counts.end(), 0);
+	std::fill(FlagCounts.begin(), FlagCounts.end(), 0);
+	NumMines = 0;
+	NumRevealedSafe = 0;
+	NumFlags = 0;
+}
+
+void TopologyMineSweeperGrid::SetMines(const std::vector<std::vector<bool>>& Board)
+{
+	Clear();
+	// A 2D generator only knows about rows, so a 3D board takes its layers one after another down the rows
+	const int32 Width = Table->Dims.Width;
+	for (int32 Row = 0; Row < int32(Board.size()) && Row * Width < Num(); Row++)
+	{
+		for (int32 Column = 0; Column < Width; Column++)
+		{
+			if (Board[Row][Column])
+			{
+				MineSweeperBits::Set(Mines, Row * Width + Column);
+				NumMines++;
+			}
+		}
+	}
+	CountAdjacentMines();
+}
+
+void TopologyMineSweeperGrid::SetMines(const std::vector<bool>& Tiles)
+{
+	Clear();
+	for (int32 Tile = 0; Tile < Num(); Tile++)
+	{
+		if (Tiles[Tile])
+		{
+			MineSweeperBits::Set(Mines, Tile);
+			NumMines++;
+		}
+	}
+	CountAdjacentMines();
+}
+
+void TopologyMineSweeperGrid::CountAdjacentMines()
+{
+	for (int32 Tile = 0; Tile < Num(); Tile++)
+	{
+		int32 Count = 0;
+		for (const int32* Neighbor = Table->Begin(Tile); Neighbor != Table->End(Tile); ++Neighbor)
+		{
+			Count += MineSweeperBits::Test(Mines, *Neighbor);
+		}
+		Counts[Tile] = uint8(Count);
+		HiddenCounts[Tile] = uint8(Table->NumNeighbors(Tile));
+	}
+}
+
+void TopologyMineSweeperGrid::MarkRevealed(int32 Tile)
+{
+	MineSweeperBits::Set(Revealed, Tile);
+	for (const int32* Neighbor = Table->Begin(Tile); Neighbor != Table->End(Tile); ++Neighbor)
+	{
+		HiddenCounts[*Neighbor]--;
+	}
+}
+
+bool TopologyMineSweeperGrid::SetFlagged(int32 Tile, bool bFlagged)
+{
+	if (MineSweeperBits::Test(Revealed, Tile) || MineSweeperBits::Test(Flagged, Tile) == bFlagged)
+	{
+		return false;
+	}
+	const int32 Delta = bFlagged ? 1 : -1;
+	bFlagged ? MineSweeperBits::Set(Flagged, Tile) : MineSweeperBits::Clear(Flagged, Tile);
+	for (const int32* Neighbor = Table->Begin(Tile); Neighbor != Table->End(Tile); ++Neighbor)
+	{
+		FlagCounts[*Neighbor] += Delta;
+	}
+	NumFlags += Delta;
+	return true;
+}
+
+int32 TopologyMineSweeperGrid::GetNeighbors(int32 Tile, int32* OutNeighbors) const
+{
+	const int32 NumNeighbors = Table->NumNeighbors(Tile);
+	FMemory::Memcpy(OutNeighbors, Table->Begin(Tile), NumNeighbors * sizeof(int32));
+	return NumNeighbors;
+}
+
+void TopologyMineSweeperGrid::MoveMine(int32 From, int32 To)
+{
+	MineSweeperBits::Clear(Mines, From);
+	for (const int32* Neighbor = Table->Begin(From); Neighbor != Table->End(From); ++Neighbor)
+	{
+		Counts[*Neighbor]--;
+	}
+	MineSweeperBits::Set(Mines, To);
+	for (const int32* Neighbor = Table->Begin(To); Neighbor != Table->End(To); ++Neighbor)
+	{
+		Counts[*Neighbor]++;
+	}
+}
+
+int32 TopologyMineSweeperGrid::Reveal(int32 Tile, std::vector<int32>& OutRevealed)
+{
+	if (MineSweeperBits::Test(Revealed, Tile) || MineSweeperBits::Test(Flagged, Tile))
+	{
+		return 0;
+	}
+	MarkRevealed(Tile);
+	OutRevealed.push_back(Tile);
+	if (MineSweeperBits::Test(Mines, Tile))
+	{
+		return 1;
+	}
+	NumRevealedSafe++;
+	int32 NumChanged = 1;
+
+	// Same as the square grids, the neighbors of a zero can't be mines. The table already leaves out anything off the board.
+	Stack.clear();
+	if (Counts[Tile] == 0)
+	{
+		Stack.push_back(Tile);
+	}
+	while (!Stack.empty())
+	{
+		const int32 Current = Stack.back();
+		Stack.pop_back();
+		for (const int32* Neighbor = Table->Begin(Current); Neighbor != Table->End(Current); ++Neighbor)
+		{
+			const int32 Next = *Neighbor;
+			if (!MineSweeperBits::Test(Revealed, Next) && !MineSweeperBits::Test(Flagged, Next))
+			{
+				MarkRevealed(Next);
+				OutRevealed.push_back(Next);
+				NumRevealedSafe++;
+				NumChanged++;
+				if (Counts[Next] == 0)
+				{
+					Stack.push_back(Next);
+				}
+			}
+		}
+	}
+	return NumChanged;
+}
+
+SIZE_T EstimateMineSweeperGridSize(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims)
+{
+	const SIZE_T Scratch = MineSweeperGrid::EstimateScratchSize(Dims.Num());
+	if (Topology == EMineSweeperTopology::Square && Dims.Depth == 1)
+	{
+		// The presets keep the same planes inline rather than allocating them, which comes to about the same
+		return sizeof(DynamicMineSweeperGrid) + DynamicGridLayout::EstimateAllocatedSize(Dims.Width, Dims.Height) + Scratch;
+	}
+	return sizeof(TopologyMineSweeperGrid) + TopologyMineSweeperGrid::EstimateStateSize(Dims.Num()) + Scratch;
+}
+
+TSharedRef<MineSweeperGrid> MakeMineSweeperGrid(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims)
+{
+	if (Topology == EMineSweeperTopology::Square && Dims.Depth == 1)
+	{
+		return MakeMineSweeperGrid(Dims.Width, Dims.Height);
+	}
+	return MakeShared<TopologyMineSweeperGrid>(MineSweeperNeighborTable::Get(Topology, Dims));
+}
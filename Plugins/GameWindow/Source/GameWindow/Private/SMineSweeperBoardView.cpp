@@ -0,0 +1,292 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SMineSweeperBoardView.h"
+#include "MineSweeperBoard.h"
+#include "HAL/IConsoleManager.h"
+#include "Rendering/DrawElements.h"
+#include "Styling/CoreStyle.h"
+#include <algorithm>
+
+static TAutoConsoleVariable<float> CVarViewMinTilePixels(
+	TEXT("MineSweeper.View.MinTilePixels"),
+	4.0f,
+	TEXT("Below this many pixels per tile the board view draws blocks from the pyramid instead of single tiles."));
+
+namespace
+{
+	const FLinearColor HiddenColor = FLinearColor::Gray;
+	const FLinearColor RevealedColor = FLinearColor::Green;
+	const FLinearColor FlaggedColor = FLinearColor(1.0f, 0.5f, 0.0f);
+	const FLinearColor MineColor = FLinearColor::Red;
+	const FLinearColor PreviewColor = FLinearColor::Blue;
+
+	/** Made once, so drawing the numbers doesn't allocate a string per tile per paint */
+	const FString& GetNumberString(int32 Count)
+	{
+		static const TArray<FString> Numbers = []()
+			{
+				TArray<FString> Result;
+				for (int32 Number = 0; Number <= MineSweeperGrid::MaxNeighbors; Number++)
+				{
+					Result.Add(FString::FromInt(Number));
+				}
+				return Result;
+			}();
+		return Numbers[Count];
+	}
+}
+
+void SMineSweeperBoardView::Construct(const FArguments& InArgs, TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> InBoard)
+{
+	Board = InBoard;
+	ViewSize = InArgs._ViewSize;
+}
+
+void SMineSweeperBoardView::Tick(const FGeometry& AllottedGeometry, const double InCurrentTime, const float InDeltaTime)
+{
+	SLeafWidget::Tick(AllottedGeometry, InCurrentTime, InDeltaTime);
+	if (!bNeedsFit)
+	{
+		return;
+	}
+	// Start zoomed out far enough to see the whole board, in whatever space the layout gave us
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	TSharedPtr<const MineSweeperGrid> Grid = PinnedBoard.IsValid() ? PinnedBoard->GetGrid() : nullptr;
+	const FVector2D Size = AllottedGeometry.GetLocalSize();
+	if (Grid.IsValid() && Size.X > 0.0f && Size.Y > 0.0f)
+	{
+		TilePixels = FMath::Min(24.0f, float(FMath::Min(Size.X / Grid->GetWidth(), Size.Y / Grid->GetRows())));
+		bNeedsFit = false;
+	}
+}
+
+int32 SMineSweeperBoardView::GetTileAt(const FVector2D& LocalPosition) const
+{
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	TSharedPtr<const MineSweeperGrid> Grid = PinnedBoard.IsValid() ? PinnedBoard->GetGrid() : nullptr;
+	if (!Grid.IsValid())
+	{
+		return INDEX_NONE;
+	}
+	const FVector2D TilePosition = Origin + LocalPosition / TilePixels;
+	const int32 Column = FMath::FloorToInt32(TilePosition.X);
+	const int32 Row = FMath::FloorToInt32(TilePosition.Y);
+	if (Column < 0 || Row < 0 || Column >= Grid->GetWidth() || Row >= Grid->GetRows())
+	{
+		return INDEX_NONE;
+	}
+	return Grid->ToTile(Row, Column);
+}
+
+int32 SMineSweeperBoardView::OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect,
+	FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const
+{
+	LastPaintElements = TilePixels >= CVarViewMinTilePixels.GetValueOnGameThread()
+		? PaintTiles(AllottedGeometry, OutDrawElements, LayerId)
+		: PaintBlocks(AllottedGeometry, OutDrawElements, LayerId);
+	return LayerId + 1;
+}
+
+int32 SMineSweeperBoardView::PaintTiles(const FGeometry& AllottedGeometry, FSlateWindowElementList& OutDrawElements, int32 LayerId) const
+{
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	if (!PinnedBoard.IsValid() || !PinnedBoard->GetGrid().IsValid())
+	{
+		return 0;
+	}
+	const MineSweeperGrid& Grid = *PinnedBoard->GetGrid();
+	const FSlateBrush* Brush = FCoreStyle::Get().GetBrush("GenericWhiteBox");
+	const FVector2D Size = AllottedGeometry.GetLocalSize();
+	const int32 FirstColumn = FMath::Max(0, FMath::FloorToInt32(Origin.X));
+	const int32 FirstRow = FMath::Max(0, FMath::FloorToInt32(Origin.Y));
+	const int32 LastColumn = FMath::Min(Grid.GetWidth(), FMath::CeilToInt32(Origin.X + Size.X / TilePixels));
+	const int32 LastRow = FMath::Min(Grid.GetRows(), FMath::CeilToInt32(Origin.Y + Size.Y / TilePixels));
+	// Leave a gap between tiles while they're big enough to tell apart, and numbers once they're big enough to read
+	const float Gap = TilePixels >= 8.0f ? 1.0f : 0.0f;
+	const bool bDrawNumbers = TilePixels >= 14.0f;
+	const FSlateFontInfo Font = FCoreStyle::GetDefaultFontStyle("Regular", FMath::Max(6, int32(TilePixels * 0.5f)));
+	const bool bGameOver = PinnedBoard->IsGameOver();
+	const MineSweeperHint& Hint = PinnedBoard->GetShownHint();
+
+	// The preview tiles are few, so a linear search beats building a set every paint
+	const std::vector<int32>& Preview = PinnedBoard->GetPreviewTiles();
+	int32 NumElements = 0;
+	for (int32 Row = FirstRow; Row < LastRow; Row++)
+	{
+		for (int32 Column = FirstColumn; Column < LastColumn; Column++)
+		{
+			const int32 Tile = Grid.ToTile(Row, Column);
+			FLinearColor Color = HiddenColor;
+			if (Grid.IsRevealed(Tile) || (bGameOver && Grid.IsMine(Tile)))
+			{
+				Color = Grid.IsMine(Tile) ? MineColor : RevealedColor;
+			}
+			else if (Grid.IsFlagged(Tile))
+			{
+				Color = FlaggedColor;
+			}
+			else if (Hint.IsValid() && Hint.Tile == Tile)
+			{
+				Color = Hint.bIsMine ? FLinearColor(0.6f, 0.0f, 0.8f) : FLinearColor::Yellow;
+			}
+			else if (std::find(Preview.begin(), Preview.end(), Tile) != Preview.end())
+			{
+				Color = PreviewColor;
+			}
+			const FVector2f Position((Column - Origin.X) * TilePixels, (Row - Origin.Y) * TilePixels);
+			const FPaintGeometry Geometry = AllottedGeometry.ToPaintGeometry(FVector2f(TilePixels - Gap, TilePixels - Gap), FSlateLayoutTransform(Position));
+			FSlateDrawElement::MakeBox(OutDrawElements, LayerId, Geometry, Brush, ESlateDrawEffect::None, Color);
+			NumElements++;
+			if (bDrawNumbers && Grid.IsRevealed(Tile) && !Grid.IsMine(Tile) && Grid.GetAdjacentMines(Tile) > 0)
+			{
+				FSlateDrawElement::MakeText(OutDrawElements, LayerId + 1, Geometry, GetNumberString(Grid.GetAdjacentMines(Tile)), Font, ESlateDrawEffect::None, FLinearColor::White);
+				NumElements++;
+			}
+		}
+	}
+	return NumElements;
+}
+
+int32 SMineSweeperBoardView::PaintBlocks(const FGeometry& AllottedGeometry, FSlateWindowElementList& OutDrawElements, int32 LayerId) const
+{
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	if (!PinnedBoard.IsValid())
+	{
+		return 0;
+	}
+	const MineSweeperPyramid& Pyramid = PinnedBoard->GetPyramid();
+	if (Pyramid.NumLevels() == 0)
+	{
+		return 0;
+	}
+	// The finest level whose blocks come out at least MinTilePixels across
+	const float MinPixels = CVarViewMinTilePixels.GetValueOnGameThread();
+	int32 Level = 0;
+	while (Level < Pyramid.NumLevels() - 1 && TilePixels * Pyramid.GetBlockSize(Level) < MinPixels)
+	{
+		Level++;
+	}
+	const int32 BlockSize = Pyramid.GetBlockSize(Level);
+	const float BlockPixels = TilePixels * BlockSize;
+	const FSlateBrush* Brush = FCoreStyle::Get().GetBrush("GenericWhiteBox");
+	const FVector2D Size = AllottedGeometry.GetLocalSize();
+	const int32 FirstX = FMath::Max(0, FMath::FloorToInt32(Origin.X / BlockSize));
+	const int32 FirstY = FMath::Max(0, FMath::FloorToInt32(Origin.Y / BlockSize));
+	const int32 LastX = FMath::Min(Pyramid.GetLevelWidth(Level), FMath::CeilToInt32((Origin.X + Size.X / TilePixels) / BlockSize));
+	const int32 LastY = FMath::Min(Pyramid.GetLevelHeight(Level), FMath::CeilToInt32((Origin.Y + Size.Y / TilePixels) / BlockSize));
+	const bool bGameOver = PinnedBoard->IsGameOver();
+
+	int32 NumElements = 0;
+	for (int32 Y = FirstY; Y < LastY; Y++)
+	{
+		for (int32 X = FirstX; X < LastX; X++)
+		{
+			// Mix the colors by how much of the block is in each state, the same as averaging the tiles it covers
+			const MineSweeperPyramid::Block Block = Pyramid.GetBlock(Level, X, Y);
+			const float Tiles = float(FMath::Max(Block.Tiles, 1u));
+			const float Revealed = Block.Revealed / Tiles;
+			const float Flagged = Block.Flagged / Tiles;
+			const float Mines = bGameOver ? FMath::Min(Block.Mines / Tiles, 1.0f - Revealed - Flagged) : 0.0f;
+			const float Hidden = FMath::Max(0.0f, 1.0f - Revealed - Flagged - Mines);
+			const FLinearColor Color = RevealedColor * Revealed + FlaggedColor * Flagged + MineColor * Mines + HiddenColor * Hidden;
+
+			const FVector2f Position((X * BlockSize - Origin.X) * TilePixels, (Y * BlockSize - Origin.Y) * TilePixels);
+			const FPaintGeometry Geometry = AllottedGeometry.ToPaintGeometry(FVector2f(BlockPixels, BlockPixels), FSlateLayoutTransform(Position));
+			FSlateDrawElement::MakeBox(OutDrawElements, LayerId, Geometry, Brush, ESlateDrawEffect::None, Color.CopyWithNewOpacity(1.0f));
+			NumElements++;
+		}
+	}
+	return NumElements;
+}
+
+FReply SMineSweeperBoardView::OnMouseButtonDown(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent)
+{
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	if (!PinnedBoard.IsValid())
+	{
+		return FReply::Unhandled();
+	}
+	if (MouseEvent.GetEffectingButton() == EKeys::MiddleMouseButton)
+	{
+		// Before the game over check, a finished board is still worth looking around
+		bPanning = true;
+		return FReply::Handled().CaptureMouse(SharedThis(this));
+	}
+	if (PinnedBoard->IsGameOver())
+	{
+		return FReply::Unhandled();
+	}
+	const FVector2D LocalPosition = MyGeometry.AbsoluteToLocal(MouseEvent.GetScreenSpacePosition());
+	const int32 Tile = GetTileAt(LocalPosition);
+	if (Tile == INDEX_NONE)
+	{
+		return FReply::Unhandled();
+	}
+	if (MouseEvent.GetEffectingButton() == EKeys::RightMouseButton)
+	{
+		PinnedBoard->ToggleFlag(Tile);
+		Invalidate(EInvalidateWidgetReason::Paint);
+		return FReply::Handled();
+	}
+	if (MouseEvent.GetEffectingButton() == EKeys::LeftMouseButton)
+	{
+		PressedTile = Tile;
+		PinnedBoard->PressTile(Tile);
+		Invalidate(EInvalidateWidgetReason::Paint);
+		return FReply::Handled().CaptureMouse(SharedThis(this));
+	}
+	return FReply::Unhandled();
+}
+
+FReply SMineSweeperBoardView::OnMouseButtonUp(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent)
+{
+	if (MouseEvent.GetEffectingButton() == EKeys::MiddleMouseButton && bPanning)
+	{
+		bPanning = false;
+		return FReply::Handled().ReleaseMouseCapture();
+	}
+	if (MouseEvent.GetEffectingButton() == EKeys::LeftMouseButton && PressedTile != INDEX_NONE)
+	{
+		// Same as the buttons, the release reveals the tile that was pressed wherever the mouse ends up
+		const int32 Tile = PressedTile;
+		PressedTile = INDEX_NONE;
+		if (TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin())
+		{
+			PinnedBoard->ReleaseTile(Tile);
+		}
+		Invalidate(EInvalidateWidgetReason::Paint);
+		return FReply::Handled().ReleaseMouseCapture();
+	}
+	return FReply::Unhandled();
+}
+
+FReply SMineSweeperBoardView::OnMouseMove(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent)
+{
+	if (!bPanning)
+	{
+		return FReply::Unhandled();
+	}
+	Origin -= MouseEvent.GetCursorDelta() / (TilePixels * MyGeometry.Scale);
+	Invalidate(EInvalidateWidgetReason::Paint);
+	return FReply::Handled();
+}
+
+FReply SMineSweeperBoardView::OnMouseWheel(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent)
+{
+	TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> PinnedBoard = Board.Pin();
+	TSharedPtr<const MineSweeperGrid> Grid = PinnedBoard.IsValid() ? PinnedBoard->GetGrid() : nullptr;
+	if (!Grid.IsValid())
+	{
+		return FReply::Unhandled();
+	}
+	// Zoom around the cursor, so the tile under it stays under it
+	const FVector2D LocalPosition = MyGeometry.AbsoluteToLocal(MouseEvent.GetScreenSpacePosition());
+	const FVector2D Anchor = Origin + LocalPosition / TilePixels;
+	const FVector2D Size = MyGeometry.GetLocalSize();
+	const float MinTilePixels = 0.5f * float(FMath::Min(Size.X / Grid->GetWidth(), Size.Y / Grid->GetRows()));
+	TilePixels = FMath::Clamp(TilePixels * FMath::Pow(1.25f, MouseEvent.GetWheelDelta()), FMath::Min(MinTilePixels, 1.0f), 64.0f);
+	Origin = Anchor - LocalPosition / TilePixels;
+	Invalidate(EInvalidateWidgetReason::Paint);
+	return FReply::Handled();
+}
@@ -4,6 +4,8 @@
 
 #include "Modules/ModuleManager.h"
 #include "MineSweeperBoard.h"
+#include "MineSweeperBoardPool.h"
+#include "Containers/Ticker.h"
 
 class FToolBarBuilder;
 class FMenuBuilder;
@@ -29,13 +31,26 @@ private:
 	int NumMines{ 5 };
 	bool bUseSeed{ false };
 	int Seed{ 0 };
+	EFirstClickSafety FirstClickSafety{ EFirstClickSafety::SafeTile };
+	EMineSweeperTopology Topology{ EMineSweeperTopology::Square };
+	int Depth{ 3 };
 	void RegisterMenus();
 
 	TSharedRef<class SDockTab> OnSpawnPluginTab(const class FSpawnTabArgs& SpawnTabArgs);
 
 	TSharedRef<class SHorizontalBox> MakeTextEntry(FText Label, TSharedRef<SEditableTextBox> EditableTextBox);
 
+	/**
+	* The performance panel only costs anything while it's shown. The board keeps its counters either way, this just
+	* reads them a few times a second and puts them in PerfText.
+	*/
+	void StartPerfPanel(TSharedRef<STextBlock> PerfText);
+	void StopPerfPanel();
+	FText GetPerfText() const;
+
 	TSharedPtr<MineSweeperBoard> Board;
+	TSharedPtr<MineSweeperBoardPool, ESPMode::ThreadSafe> BoardPool;
+	FTSTicker::FDelegateHandle PerfPanelTicker;
 private:
 	TSharedPtr<class FUICommandList> PluginCommands;
 };
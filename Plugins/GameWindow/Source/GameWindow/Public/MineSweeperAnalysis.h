@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperSnapshot.h"
+
+/**
+* A tile that can be worked out from what's on screen, found on a worker thread from a snapshot.
+*/
+struct MineSweeperHint
+{
+	uint64 Version = 0; // Version of the snapshot this was worked out from
+	uint32 GameId = 0;
+	int32 Tile = INDEX_NONE; // INDEX_NONE when there was nothing to find, or the search gave up because it went stale
+	int32 FromTile = INDEX_NONE; // The number that gives it away
+	bool bIsMine = false;
+
+	bool IsValid() const { return Tile != INDEX_NONE; }
+
+	/**
+	* Whether a hint from an older version still holds on the board as it is now. Mines don't move once the first click
+	* is done, so the deduction itself can't go wrong later. All that can happen is the player got there first, so it's
+	* enough that it's the same game and the tile is still hidden and unflagged.
+	*/
+	bool CanRebase(const MineSweeperGrid& Grid, uint32 CurrentGameId) const
+	{
+		return IsValid() && GameId == CurrentGameId && !Grid.IsRevealed(Tile) && !Grid.IsFlagged(Tile);
+	}
+};
+
+namespace MineSweeperAnalysis
+{
+	/**
+	* Looks for a number whose flags are all down (so its other neighbors are safe) or whose hidden neighbors can only be
+	* mines. It trusts the player's flags, so a wrong flag can give a wrong hint, same as it would for a person.
+	* Checks the snapshot for staleness as it goes and gives up early if the player has moved on.
+	*/
+	GAMEWINDOW_API MineSweeperHint FindHint(const MineSweeperSnapshot& Snapshot);
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <vector>
+
+struct MineSweeperBitboardPlanes;
+struct MineSweeperBitboardKernels;
+
+/**
+* A bit-parallel square board for headless simulation, where every plane (mines, revealed, zero tiles) is one bit
+* per tile packed into 64 bit words.
+*
+* Adjacency is worked out for 64 tiles at a time by adding up the eight shifted mine planes with bit-sliced adders,
+* which leaves the counts as four bitplanes (1s, 2s, 4s, 8s). The flood fill never looks at single tiles either, it
+* grows the opening a row of words at a time until nothing changes. Both run 4 or 8 words at a time with AVX2 or
+* AVX-512 when the CPU has them, checked at runtime, so the module doesn't have to be compiled for either.
+*
+* Each row is padded to whole words and followed by one zero word, and there's a zero row above and below the board,
+* so shifting across row and board edges never needs a bounds check.
+*/
+class GAMEWINDOW_API MineSweeperBitboard
+{
+public:
+	MineSweeperBitboard(int32 InWidth, int32 InHeight);
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+	int32 Num() const { return Width * Height; }
+
+	/**
+	* Places the mines, one entry per tile (Row * Width + Column), and recomputes every count plane.
+	*/
+	void SetMines(const std::vector<bool>& Tiles);
+
+	bool IsMine(int32 Tile) const { return TestBit(Mines, Tile); }
+	bool IsRevealed(int32 Tile) const { return TestBit(Revealed, Tile); }
+	int32 GetAdjacentMines(int32 Tile) const;
+	int32 GetNumMines() const { return NumMines; }
+	int32 GetRemainingSafeTiles() const { return Num() - NumMines - NumRevealedSafe; }
+
+	/**
+	* Reveals a tile, flooding the whole opening if it's a zero. Returns the number of tiles that changed.
+	*/
+	int32 Reveal(int32 Tile);
+
+	/** Which vector path this board picked when it was made, for the benchmark output */
+	const TCHAR* GetSimdName() const;
+
+private:
+	FORCEINLINE int32 WordIndex(int32 Row, int32 Word) const { return Base + Row * Stride + Word; }
+	FORCEINLINE bool TestBit(const std::vector<uint64>& Plane, int32 Tile) const
+	{
+		const int32 Row = Tile / Width;
+		const int32 Column = Tile % Width;
+		return (Plane[WordIndex(Row, Column >> 6)] >> (Column & 63)) & 1;
+	}
+
+	MineSweeperBitboardPlanes GetPlanes();
+	void ComputeAdjacency();
+	bool FillRow(int32 Row, int32 FromRow);
+
+	int32 Width, Height;
+	int32 WordsPerRow; // Words holding tiles in each row
+	int32 Stride; // WordsPerRow plus the zero word between rows
+	int32 Base; // Index of the first word of row 0, after the zero row and the leading zero word
+	int32 NumMines = 0;
+	int32 NumRevealedSafe = 0;
+	const MineSweeperBitboardKernels* Kernels; // Picked from what the CPU supports and MineSweeper.Bitboard.Simd
+
+	std::vector<uint64> Valid; // 1 for every real tile, so the padding can be masked off
+	std::vector<uint64> Mines;
+	std::vector<uint64> Revealed;
+	std::vector<uint64> Zero; // Safe tiles with no adjacent mines, which is what an opening grows through
+	std::vector<uint64> CountBits[4];
+	std::vector<uint64> Open; // Scratch plane for the opening being flooded
+};
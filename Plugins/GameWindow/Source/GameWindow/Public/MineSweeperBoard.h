@@ -5,21 +5,55 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "Widgets/Layout/SBox.h"
+#include "MineSweeperGrid.h"
+#include "MineSweeperTopology.h"
+#include "MineSweeperSnapshot.h"
+#include "MineSweeperAnalysis.h"
+#include "MineSweeperClock.h"
+#include "MineSweeperPyramid.h"
+#include "MineSweeperPerf.h"
+#include "HAL/LowLevelMemTracker.h"
 #include <vector>
 
 DECLARE_LOG_CATEGORY_EXTERN(MineSweeperLog, Log, All);
 
+/**
+* Low level memory tracker tags, so what boards cost shows up under MineSweeper in "stat LLM" and Unreal Insights.
+* State is the grids, Widgets the Slate side of a board, Keys the per tile handle table and Caches everything kept around
+* to make moves and analysis cheap.
+*/
+LLM_DECLARE_TAG_API(MineSweeper_State, GAMEWINDOW_API);
+LLM_DECLARE_TAG_API(MineSweeper_Widgets, GAMEWINDOW_API);
+LLM_DECLARE_TAG_API(MineSweeper_Keys, GAMEWINDOW_API);
+LLM_DECLARE_TAG_API(MineSweeper_Caches, GAMEWINDOW_API);
+
+class SWindow;
+class SMineSweeperBoardView;
+
 
 /**
 * Root interface for generating a Minesweeper board.
 * 
 * I've kept this as a pure virtual class that uses standard C++ so that it would make it easier to import diffeerent implementations
 * that aren't written in Unreal C++. The idea is that this interface can be implemented in any C++ project, and then used in Unreal Engine
+*
+* A std::vector across a library boundary only works if both sides agree on the compiler and standard library though, so
+* generators that really live outside the project go through the C ABI in MineSweeperGeneratorABI.h instead, and
+* NativeBoardGenerator turns one of those back into a GenerateBoard.
 */
 class GenerateBoard {
 protected:
 public:
 	virtual std::vector<std::vector<bool>> Generate(int Width, int Height, int NumMines) = 0;
+
+	/**
+	* Boards that aren't square (hexagons, triangles, 3D) are just a list of tiles as far as mine placement goes,
+	* so by default we generate a single row of the right length.
+	*/
+	virtual std::vector<bool> GenerateTiles(int NumTiles, int NumMines) {
+		std::vector<std::vector<bool>> Board = Generate(NumTiles, 1, NumMines);
+		return Board.empty() ? std::vector<bool>(NumTiles, false) : Board[0];
+	}
 };
 
 /**
@@ -79,14 +113,71 @@ public:
 	int Seed = 0;
 };
 
+/**
+* The widget side of a tile. Whether it's a mine lives in the MineSweeperGrid, because the first click can still move mines around.
+*
+* The label is made once with the button and after that only its text and color change, so clicking never builds widgets.
+*/
 struct MineSweeperTile {
-	
-	bool bIsMine;
-	bool bIsRevealed;
 	TSharedRef<SButton> Button;
-	MineSweeperTile(int InRow, int InColumn, TSharedRef<SButton> InButton, bool InIsMine = false)
-		: bIsMine(InIsMine), bIsRevealed(false), Button(InButton) {}
-	MineSweeperTile() : bIsMine(false), bIsRevealed(false), Button(SNew(SButton)) {}
+	TSharedRef<STextBlock> Label;
+};
+
+/**
+* Input to paint latency of the board, from a press or release landing to the next frame Slate renders.
+*/
+struct MineSweeperLatencyStats
+{
+	int32 Num = 0;
+	double LastMs = 0.0;
+	double TotalMs = 0.0;
+	double MaxMs = 0.0;
+
+	void Add(double Ms)
+	{
+		Num++;
+		LastMs = Ms;
+		TotalMs += Ms;
+		MaxMs = FMath::Max(MaxMs, Ms);
+	}
+	double GetAverageMs() const { return Num > 0 ? TotalMs / Num : 0.0; }
+};
+
+/**
+* What a board costs, in bytes.
+*
+* State, keys and caches are measured from what's actually allocated. Slate can't tell us how big a widget is, so widgets
+* are counted from the size of everything a tile creates, which is a floor. LLM's MineSweeper/Widgets has the real figure.
+*/
+struct MineSweeperMemoryReport
+{
+	SIZE_T StateBytes = 0;
+	SIZE_T WidgetBytes = 0;
+	SIZE_T KeyBytes = 0;
+	SIZE_T CacheBytes = 0;
+
+	SIZE_T GetTotal() const { return StateBytes + WidgetBytes + KeyBytes + CacheBytes; }
+};
+
+/**
+* What the first click of a game is allowed to hit.
+*/
+enum class EFirstClickSafety : uint8
+{
+	None, // Classic, the first click can be a mine
+	SafeTile, // The clicked tile is never a mine
+	Opening, // The clicked tile and its neighbors are never mines, so the first click always opens an area
+};
+
+/**
+* Where a game is. Ending a game only changes this, everything that looks different afterwards works it out from the
+* phase and the mines when it's painted, so losing a huge board costs the same as losing a small one.
+*/
+enum class EMineSweeperPhase : uint8
+{
+	Playing,
+	Won,
+	Lost,
 };
 
 /**
@@ -98,6 +189,9 @@ struct MineSweeperTile {
 * 1. I've always thought it's very bad that Unreal doesn't support 2D arrays natively.
 * 2. I decided to use a map instead because its mre flexible and future proof e.g. a 2D array is limited to just 2D. 
 * A map could be used for 3D mine sweeper boards, different shaped Tiles (Triagles, or hexagons).
+*
+* Since then the MineSweeperGrid gives every tile a flat index whatever its shape, so the tiles are a flat TArray indexed
+* by that, which has the same flexibility without formatting and parsing string keys on every click.
 */
 //struct MineSweeperArray {
 //public:
@@ -118,108 +212,223 @@ struct MineSweeperTile {
 /**
  * MAin MineSweeper board class that does all of board management, tile management, and game logic.
  */
-class GAMEWINDOW_API MineSweeperBoard 
+class GAMEWINDOW_API MineSweeperBoard : public TSharedFromThis<MineSweeperBoard, ESPMode::ThreadSafe>
 {
 
 private:
-	TMap < FString, TSharedRef<MineSweeperTile>> TileState; // Map to store the state of each tile (e.g., revealed, flagged)
+	TArray<MineSweeperTile> Tiles; // Indexed by tile, the same as the grid
 		
-	TSharedRef<SHorizontalBox> CreateRow(int Width, int Column, std::vector<std::vector<bool>> Board);
+	TSharedRef<SHorizontalBox> CreateRow(int Width, int Row);
+
+	/** Logs why and returns false if a board this size won't fit in the memory budget at all */
+	static bool FitsBudget(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims);
+
+	/** Everything after the mines and counts, for either RefreshBoard */
+	void BuildBoard(TSharedRef<MineSweeperGrid> ReadyGrid, int32 FirstClickSeed);
+
+	/**
+	* Runs auto play from ChangedTiles, repaints everything in RevealedTiles and FlaggedTiles, records the move, then
+	* checks for a win or a loss.
+	*/
+	void FinishMove(MineSweeperPerfMove::EKind Kind, int32 Tile, uint64 StartCycles);
+
+	/**
+	* Called back on the game thread with a hint from a worker, which may be for a board the player has moved on from.
+	*/
+	void ShowHint(const MineSweeperHint& Hint);
+
+	void OnWindowRendered(SWindow& Window, void* ViewportRHIPtr);
 	
 	TSharedRef<SVerticalBox> VerticalBox = SNew(SVerticalBox);
 
+	/**
+	* Boards up to MineSweeper.View.MaxButtonTiles get a button per tile. Anything bigger is drawn by one
+	* SMineSweeperBoardView from the pyramid, and the per tile painting below does nothing but repaint the view.
+	*/
+	bool bUseButtons = true;
+	TWeakPtr<SMineSweeperBoardView> View;
+	MineSweeperPyramid Pyramid;
+	EMineSweeperPhase Phase = EMineSweeperPhase::Playing;
+	MineSweeperHint ShownHint;
+
+	void RepaintView();
+
+	/**
+	* What a tile's button is showing while the game's on. The buttons don't get colors pushed at them, each one has its
+	* color bound to GetTileColor, which reads this, so the game ending never has to visit them.
+	*/
+	enum class ETileLook : uint8
+	{
+		Hidden,
+		Preview,
+		Revealed,
+		Flagged,
+		HintSafe,
+		HintMine,
+	};
+	std::vector<ETileLook> TileLooks;
+
+	FSlateColor GetTileColor(int32 Tile) const;
+	bool IsPlaying() const { return Phase == EMineSweeperPhase::Playing; }
 
-	FTSTicker::FDelegateHandle Handle; // Handle for the game timer ticker
-	long GameStartTime; // Start time of the game in seconds
+	/**
+	* The mines, adjacency counts and revealed tiles live in a flat grid. The standard presets get a compile time
+	* specialization from MakeMineSweeperGrid, every other size gets the dynamic one.
+	*/
+	TSharedPtr<MineSweeperGrid> Grid;
+
+	/**
+	* Scratch for the interaction path. Everything is reserved for the whole board in RefreshBoard, so pressing, releasing
+	* and revealing never touch the heap.
+	*/
+	std::vector<int32> RevealedTiles;
+	std::vector<int32> FlaggedTiles;
+	std::vector<int32> ChangedTiles; // What auto play starts from
+	std::vector<int32> PreviewTiles; // What the current press painted, so the release can put it back
+	std::vector<int32> RingTiles;
+	std::vector<bool> VisitedTiles;
+
+	/**
+	* Hints and analysis never touch the grid, they get a snapshot of it. Every move marks its tiles dirty here, which is
+	* all it costs until somebody asks for a snapshot.
+	*/
+	MineSweeperSnapshotPublisher Snapshots;
+
+	bool bFirstClick = true;
+	FRandomStream FirstClickStream; // Picks where mines under the first click go, seeded with the board so it's reproducible
+
+	uint64 InputCycles = 0; // When the input we're waiting to see painted came in, 0 if there isn't one
+	MineSweeperLatencyStats InputLatency;
+	MineSweeperPerfCounters Perf;
+	FDelegateHandle WindowRenderedHandle;
+
+	TSharedRef<MineSweeperClock> Clock = MakeShared<MineSweeperClock>();
 	int BoardWidth, BoardHeight, MineNum;
 public:
 	
 	TSharedRef<STextBlock> GameTimeText = SNew(STextBlock);
 	~MineSweeperBoard();
 	
-	void RefreshBoard(int Width, int Height, int NumMines, TSharedPtr<GenerateBoard> Generator);
+	/**
+	* Returns false, and leaves the current board alone, if the new one wouldn't fit in MineSweeper.Memory.BudgetMB even
+	* drawn by the board view.
+	*/
+	bool RefreshBoard(int Width, int Height, int NumMines, TSharedPtr<GenerateBoard> Generator, int32 FirstClickSeed = 0);
+
+	/**
+	* The same for any topology. The generator is asked for Width by Height * Depth, a 3D board's layers one after
+	* another down the rows.
+	*/
+	bool RefreshBoard(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims, int NumMines, TSharedPtr<GenerateBoard> Generator, int32 FirstClickSeed = 0);
+
+	/**
+	* Rebuilds the widgets for a grid that already has its mines and counts, e.g. one popped from MineSweeperBoardPool.
+	* FirstClickSeed decides where any mines under the first click get moved to.
+	*/
+	bool RefreshBoard(TSharedRef<MineSweeperGrid> ReadyGrid, int32 FirstClickSeed = 0);
+
+	/** What this board is using right now */
+	MineSweeperMemoryReport GetMemoryReport() const;
+
+	/**
+	* What a board of this shape will cost before it's made, with a button per tile or drawn by the board view. Built
+	* from the same terms GetMemoryReport measures, with every scratch buffer at the most it can grow to, so the two can
+	* be compared and a board that fits the budget stays inside it while it's played.
+	*/
+	static MineSweeperMemoryReport EstimateMemory(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims, bool bWithButtons);
+	static MineSweeperMemoryReport EstimateMemory(int32 Width, int32 Height, bool bWithButtons)
+	{
+		return EstimateMemory(EMineSweeperTopology::Square, { Width, Height, 1 }, bWithButtons);
+	}
+
+	EFirstClickSafety FirstClickSafety = EFirstClickSafety::None;
+
+	/**
+	* Auto play, which runs after every move. Auto flag flags the neighbors of any number that can only be mines,
+	* and auto reveal chords any number that has all of its flags.
+	*/
+	bool bAutoFlag = false;
+	bool bAutoReveal = false;
+
+	/** Whether winning or losing pops up a message. Bots playing on the board turn it off. */
+	bool bShowResultDialog = true;
+
+	/** Broadcast on the game thread when a game is won or lost */
+	TMulticastDelegate<void(EMineSweeperPhase)> OnGameOver;
+
+	/** The board refreshed most recently, which in the editor is the one in the GameWindow tab */
+	static TSharedPtr<MineSweeperBoard, ESPMode::ThreadSafe> GetActiveBoard();
+
 	TSharedRef<SBox> GetVerticalBox();
+	TSharedPtr<const MineSweeperGrid> GetGrid() const { return Grid; }
+	const MineSweeperLatencyStats& GetInputLatency() const { return InputLatency; }
+	const MineSweeperPerfCounters& GetPerf() const { return Perf; }
 	
 	void StartGameTimer();
 	void StopGameTimer();
-	
 
-	void RevealTile(int row, int column);
+	/**
+	* Pausing stops the clock and hides the tiles, so the time can't be spent studying the board.
+	*/
+	void SetPaused(bool bPaused);
+	bool IsPaused() const { return Clock->GetState() == MineSweeperClock::EState::Paused; }
+	const MineSweeperClock& GetClock() const { return *Clock; }
 
-	int SetTileRevealed(int Row, int Column);
+	/**
+	* Mouse down on a tile, which previews the tiles around it. The buttons call these, and so does the interaction benchmark.
+	*/
+	void PressTile(int32 Tile);
 
-	void PreviewTile(int row, int column, bool bPreview);
+	/**
+	* Mouse up, which puts the preview back and then reveals.
+	*/
+	void ReleaseTile(int32 Tile);
 
+	/**
+	* Left click. Reveals a hidden tile, or chords a revealed number. Flagged tiles ignore it.
+	*/
+	void RevealTile(int32 Tile);
 
 	/**
-	* Returns the surrounding tiles for a given tile at (Row, Column) within the specified number of rings.
+	* Right click on a hidden tile.
 	*/
-	TSet<FString> GetSurroundingTiles(int Row, int Column, int Rings);
+	void ToggleFlag(int32 Tile);
+
+	int SetTileRevealed(int32 Tile);
+
+	void SetTileFlagged(int32 Tile, bool bFlagged);
 
 	/**
-	* The drawback to using a map is that we need to keep very tight control of how the keys are generated.
-	* 
-	* Technically, we could use any string as a key, but we don't want that, we want meaningful keys that represent the tile's position in the board.
-	* 
-	* Making sure that the keys fit the format of "Row,Column" would be a great to use the new contracts feature in C++26
+	* Works out a safe tile (or a certain mine) on a worker thread and highlights it when it comes back. The UI never waits
+	* on it, and if the player has made moves in the meantime it's only shown if it still makes sense.
 	*/
-	FString MakeKey(int Row, int Column) const
-	{
-		return FString::Printf(TEXT("%d,%d"), Row, Column);
-	}
+	void RequestHint();
 
 	/**
-	* Same as above, the drawback to using a TMap
+	* A snapshot of the board as it is right now, for anything else that wants to analyse it off the game thread.
 	*/
-	void SplitKey(const FString& Key, int& Row, int& Column) const
-	{
-		TArray<FString> Parts;
-		Key.ParseIntoArray(Parts, TEXT(","), true);
-		if (Parts.Num() == 2)
-		{
-			Row = FCString::Atoi(*Parts[0]);
-			Column = FCString::Atoi(*Parts[1]);
-		}
-		else
-		{
-			Row = -1;
-			Column = -1;
-		}
-	}
-	void GameOver()
-	{
-		StopGameTimer();
-		for (const auto& TilePair : TileState)
-		{
-			TilePair.Value->Button->SetBorderBackgroundColor(TilePair.Value->bIsMine ? FLinearColor::Red : FLinearColor::Green);
-			TilePair.Value->Button->SetEnabled(false);
-		}
-	}
+	MineSweeperSnapshotRef GetSnapshot() { return Snapshots.Publish(*Grid); }
+
+	const MineSweeperPyramid& GetPyramid() const { return Pyramid; }
+	const std::vector<int32>& GetPreviewTiles() const { return PreviewTiles; }
+	const MineSweeperHint& GetShownHint() const { return ShownHint; }
+	EMineSweeperPhase GetPhase() const { return Phase; }
+	bool IsGameOver() const { return Phase != EMineSweeperPhase::Playing; }
+	bool UsesButtons() const { return bUseButtons; }
+
+	void PreviewTile(int32 Tile, bool bPreview);
 
 	/**
-	* The recursive function to get all the surrounding safe tiles. I saw two ways to implement this function
-	* 
-	* 1. Reveal the tiles as we go, which would be the most efficient way to do it, but its less flexible.
-	*	If we want to use the logic in this function for other purposes, like highlighting safe tiles, we would need to refactor the code.
-	* 
-	* 2. Use a set to store the the tiles we've already visited, and another for the tiles we want to reveal. 
+	* Writes the tiles around Tile, out to the given number of rings, into OutTiles and returns how many there are.
+	* The rings follow the grid's topology, so on a hex board one ring is the six hexagons around the tile.
+	* Only tiles that are still hidden and unflagged are returned, since those are the ones the press preview paints.
 	*/
-	TSet<FString> GetSurroundingSafeTiles(int Row, int Column, TSet<FString> &Ignore);
+	int32 GetSurroundingTiles(int32 Tile, int32 Rings, std::vector<int32>& OutTiles);
 
 	/**
-	* We need to know when the game is over, so we can stop the game timer and disable all the tiles.
+	* Stops the clock and moves the board to Won or Lost. Constant time, nothing per tile happens here.
 	*/
-	TSet<FString> GetUnrevealedTiles()
-	{
-		TSet<FString> UnrevealedTiles;
-		for (const auto& TilePair : TileState)
-		{
-			if (!TilePair.Value->bIsRevealed && !TilePair.Value->bIsMine)
-			{
-				UnrevealedTiles.Add(TilePair.Key);
-			}
-		}
-		return UnrevealedTiles;
-	}
+	void GameOver(EMineSweeperPhase EndPhase);
+
 	
 };
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperTopology.h"
+
+class NativeBoardGenerator;
+
+/**
+* Everything that decides what a generated board looks like. If any of it changes, the pooled boards are stale.
+*/
+struct MineSweeperBoardSettings
+{
+	EMineSweeperTopology Topology = EMineSweeperTopology::Square;
+	int32 Width = 5;
+	int32 Height = 5;
+	int32 Depth = 1; // Layers, only cube boards have more than one
+	int32 NumMines = 5;
+	bool bUseSeed = false;
+	int32 Seed = 0;
+	FString GeneratorLibrary; // The generator library boards come from, empty for the built in generator
+
+	MineSweeperDimensions GetDimensions() const { return { Width, Height, Topology == EMineSweeperTopology::Cube ? Depth : 1 }; }
+
+	bool operator==(const MineSweeperBoardSettings& Other) const
+	{
+		return Topology == Other.Topology && GetDimensions() == Other.GetDimensions() && NumMines == Other.NumMines
+			&& bUseSeed == Other.bUseSeed && Seed == Other.Seed && GeneratorLibrary == Other.GeneratorLibrary;
+	}
+};
+
+/**
+* Keeps the next few boards for the current settings generated on worker threads, mines placed and counts done, so
+* "Generate New Grid" only has to build the widgets.
+*
+* The pool size and its memory cap are the console variables MineSweeper.Pool.Size and MineSweeper.Pool.MemoryCapMB.
+* Everything here is safe to call from any thread, but Pop is meant for the game thread.
+*/
+class GAMEWINDOW_API MineSweeperBoardPool : public TSharedFromThis<MineSweeperBoardPool, ESPMode::ThreadSafe>
+{
+public:
+	MineSweeperBoardPool();
+
+	/**
+	* Switches the pool over to new settings. Boards for the old settings are dropped straight away, and any still being
+	* generated are thrown away when they finish.
+	*/
+	void SetSettings(const MineSweeperBoardSettings& InSettings);
+
+	/**
+	* Takes a ready board for these settings, or returns null if there isn't one yet and the caller has to generate it.
+	* Either way the pool starts refilling in the background.
+	*/
+	TSharedPtr<MineSweeperGrid> Pop(const MineSweeperBoardSettings& InSettings);
+
+	int32 NumReady() const;
+	SIZE_T GetReadyBytes() const;
+
+private:
+	void SetSettingsLocked(const MineSweeperBoardSettings& InSettings);
+	void Refill();
+	void OnGenerated(uint32 ForGeneration, TSharedRef<MineSweeperGrid> NewGrid);
+
+	mutable FCriticalSection Lock;
+	MineSweeperBoardSettings Settings;
+	uint32 Generation = 0; // Bumped on every settings change, so boards from older settings can be recognised
+	TArray<TSharedRef<MineSweeperGrid>> Ready;
+	SIZE_T ReadyBytes = 0;
+	SIZE_T BytesPerBoard = 0; // Size of the last board we made, used to budget the ones still in flight
+	int32 InFlight = 0;
+
+	/**
+	* The pool's own instance of the settings' generator library, since an instance is for one thread at a time. Workers
+	* take turns on it through GeneratorLock, which is never held together with Lock.
+	*/
+	TSharedPtr<NativeBoardGenerator> NativeGenerator;
+	FCriticalSection GeneratorLock;
+	FRandomStream SeedStream; // Unseeded boards still need a seed each, drawn here so workers never touch FMath::Rand
+};
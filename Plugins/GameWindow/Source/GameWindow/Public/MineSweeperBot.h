@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include "MineSweeperBoard.h"
+#include "Async/Future.h"
+#include "Containers/Queue.h"
+#include "Containers/Ticker.h"
+#include <atomic>
+#include <coroutine>
+#include <vector>
+
+class MineSweeperBotTable;
+class MineSweeperBotScheduler;
+
+/**
+* What a move did, handed back once it's completely finished, cascade, auto play and all.
+*/
+struct MineSweeperBotMove
+{
+	int32 NumChanged = 0; // Tiles revealed, or 1 if a flag went on or off
+	EMineSweeperPhase Phase = EMineSweeperPhase::Playing;
+};
+
+/**
+* The return type of a bot. A bot is any coroutine returning this that co_awaits moves on a MineSweeperBotTable:
+*
+*	MineSweeperBot PlayOnce(MineSweeperBotTable& Table)
+*	{
+*		co_await Table.NewGame(30, 16, 99, 1234);
+*		MineSweeperBotMove Move = co_await Table.Reveal(Table.Num() / 2);
+*		...
+*	}
+*
+* Nothing runs until it's handed to MineSweeperBotScheduler::Spawn. Parameters are copied into the coroutine, so pass
+* the table by reference and anything else by value. A lambda with captures shouldn't be the coroutine itself, since
+* its captures die with the lambda.
+*/
+class GAMEWINDOW_API MineSweeperBot
+{
+public:
+	struct promise_type
+	{
+		MineSweeperBotTable* Table = nullptr;
+
+		MineSweeperBot get_return_object() { return MineSweeperBot(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { checkNoEntry(); } // Exceptions are off, this can't happen
+
+		/** The table is told the bot is done and the frame goes, so a finished bot costs nothing */
+		struct FinalAwaiter
+		{
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<promise_type> Handle) noexcept;
+			void await_resume() const noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept { return {}; }
+	};
+
+	MineSweeperBot(MineSweeperBot&& Other) : Handle(Other.Handle) { Other.Handle = nullptr; }
+	MineSweeperBot(const MineSweeperBot&) = delete;
+	~MineSweeperBot();
+
+private:
+	friend class MineSweeperBotScheduler;
+
+	explicit MineSweeperBot(std::coroutine_handle<promise_type> InHandle) : Handle(InHandle) {}
+
+	std::coroutine_handle<promise_type> Handle;
+};
+
+/**
+* The board as a bot sees it. It can only see what a player could, and every move is something to co_await, so the
+* same bot can play a headless grid at full speed on a worker thread or the board in the GameWindow tab at a pace
+* someone can watch. One bot plays a table at a time.
+*/
+class GAMEWINDOW_API MineSweeperBotTable
+{
+public:
+	virtual ~MineSweeperBotTable();
+
+	struct MoveAwaiter
+	{
+		MineSweeperBotTable& Table;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> Handle) { Table.Run(Handle); }
+		MineSweeperBotMove await_resume() const noexcept { return Table.LastMove; }
+	};
+
+	/** A new seeded game. A Width of 0 keeps the size and mine count of the game that's there. */
+	MoveAwaiter NewGame(int32 Width, int32 Height, int32 NumMines, int32 Seed) { return Request({ EOp::NewGame, Seed, Width, Height, NumMines }); }
+
+	/** Left click: reveals a hidden tile, or chords a revealed number. Resumes when the cascade has finished. */
+	MoveAwaiter Reveal(int32 Tile) { return Request({ EOp::Reveal, Tile }); }
+
+	/** Right click, toggling the flag on a hidden tile */
+	MoveAwaiter Flag(int32 Tile) { return Request({ EOp::Flag, Tile }); }
+
+	/**
+	* Resumes once the game is won or lost. On the editor board that can be someone else playing it, on a headless
+	* table nobody else moves, so it comes straight back with the phase as it is.
+	*/
+	MoveAwaiter GameOver() { return Request({ EOp::WaitForGameOver }); }
+
+	int32 GetWidth() const { return GetGrid().GetWidth(); }
+	int32 GetHeight() const { return GetGrid().GetHeight(); }
+	int32 Num() const { return GetGrid().Num(); }
+	int32 GetNumMines() const { return GetGrid().GetNumMines(); }
+	int32 GetRemainingSafeTiles() const { return GetGrid().GetRemainingSafeTiles(); }
+	int32 GetNeighbors(int32 Tile, int32* OutNeighbors) const { return GetGrid().GetNeighbors(Tile, OutNeighbors); }
+	bool IsRevealed(int32 Tile) const { return GetGrid().IsRevealed(Tile); }
+	bool IsFlagged(int32 Tile) const { return GetGrid().IsFlagged(Tile); }
+
+	/** Hidden tiles give INDEX_NONE, same as a snapshot, so a bot can't cheat */
+	int32 GetAdjacentMines(int32 Tile) const { return IsRevealed(Tile) ? GetGrid().GetAdjacentMines(Tile) : INDEX_NONE; }
+
+	EMineSweeperPhase GetPhase() const { return LastMove.Phase; }
+
+protected:
+	friend class MineSweeperBotScheduler;
+	friend struct MineSweeperBot::promise_type::FinalAwaiter;
+
+	enum class EOp : uint8
+	{
+		NewGame,
+		Reveal,
+		Flag,
+		WaitForGameOver,
+	};
+
+	struct Command
+	{
+		EOp Op = EOp::Reveal;
+		int32 Arg = 0; // The tile, or the seed for a new game
+		int32 Width = 0;
+		int32 Height = 0;
+		int32 NumMines = 0;
+	};
+
+	explicit MineSweeperBotTable(MineSweeperBotScheduler& InScheduler) : Scheduler(InScheduler) {}
+
+	MoveAwaiter Request(const Command& InCommand)
+	{
+		Pending = InCommand;
+		return { *this };
+	}
+
+	virtual const MineSweeperGrid& GetGrid() const = 0;
+
+	/** Carries out Pending and resumes Handle afterwards, wherever this table's bots run */
+	virtual void Run(std::coroutine_handle<> Handle) = 0;
+
+	/** Resumes Handle where this table's bots run, without doing anything first. Never resumes inside the call. */
+	virtual void Post(std::coroutine_handle<> Handle) = 0;
+
+	/** Called when the bot has run to the end, or by Abandon */
+	void OnBotFinished();
+
+	/** Drops a bot that's waiting and can never be resumed, e.g. because its board is gone */
+	void Abandon();
+
+	MineSweeperBotScheduler& Scheduler;
+	std::coroutine_handle<MineSweeperBot::promise_type> Bot;
+	Command Pending;
+	MineSweeperBotMove LastMove;
+};
+
+/**
+* Runs bots, lots of them, without a thread each.
+*
+* Headless tables are spread over a few worker threads, and a table and its bot only ever run on their shard's thread,
+* so a bot's moves and its reads of the board never need a lock. Every move puts the bot at the back of its shard's
+* queue, so thousands of bots on a shard take turns a move at a time. Editor tables play MineSweeperBoard on the game
+* thread, one move every MineSweeper.Bot.PaceMs.
+*
+* Tables are created, and bots spawned and stopped, from the game thread.
+*/
+class GAMEWINDOW_API MineSweeperBotScheduler
+{
+public:
+	~MineSweeperBotScheduler();
+
+	/** NumThreads worker threads for headless tables, 0 for one per core */
+	void Start(int32 NumThreads = 0);
+
+	/** Stops the workers and throws away any bot that hasn't finished */
+	void Stop();
+
+	MineSweeperBotTable& CreateHeadlessTable();
+	MineSweeperBotTable& CreateEditorTable(TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> Board);
+
+	/** Starts Bot on Table, which mustn't already have a bot on it */
+	void Spawn(MineSweeperBotTable& Table, MineSweeperBot Bot);
+
+	int32 GetNumRunning() const { return NumRunning.load(std::memory_order_acquire); }
+	int64 GetNumMoves() const;
+
+	/** Called from ShutdownModule, and by MineSweeper.Bot.Stop. Stops every bot the console commands started. */
+	static void StopAll();
+
+private:
+	friend class MineSweeperBotTable;
+	friend class HeadlessBotTable;
+	friend class EditorBotTable;
+
+	struct Shard
+	{
+		TQueue<std::coroutine_handle<>, EQueueMode::Mpsc> Ready;
+		FEvent* Wake = nullptr;
+		TFuture<void> Thread;
+		std::atomic<int64> NumMoves = 0;
+	};
+
+	void RunShard(Shard& InShard);
+
+	TArray<TUniquePtr<Shard>> Shards;
+	TArray<TUniquePtr<MineSweeperBotTable>> Tables;
+	int32 NextShard = 0;
+	std::atomic<bool> bStopShards = false;
+	std::atomic<int32> NumRunning = 0;
+	std::atomic<int64> NumEditorMoves = 0;
+};
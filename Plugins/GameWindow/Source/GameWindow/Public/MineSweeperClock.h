@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+class STextBlock;
+
+/**
+* The game clock for one board.
+*
+* Time comes from FPlatformTime::Cycles64, which is monotonic and far finer than a second, and is added up across
+* pauses. The clock doesn't tick itself. While it's running it's on the shared MineSweeperClockTicker, which only wakes
+* up when some clock's displayed second is about to change, and a paused or stopped clock isn't on it at all.
+*/
+class GAMEWINDOW_API MineSweeperClock : public TSharedFromThis<MineSweeperClock>
+{
+public:
+	enum class EState : uint8
+	{
+		Stopped,
+		Running,
+		Paused,
+	};
+
+	/** Resets to zero and starts counting, showing the time in InText */
+	void Start(TSharedPtr<STextBlock> InText);
+	void Pause();
+	void Resume();
+
+	/** The game is over. The text keeps showing the final time. */
+	void Stop();
+
+	EState GetState() const { return State; }
+	double GetElapsedSeconds() const;
+
+private:
+	friend class MineSweeperClockTicker;
+
+	/**
+	* Sets the text if the displayed second has changed, and returns how long until it changes again.
+	*/
+	double Refresh();
+
+	EState State = EState::Stopped;
+	uint64 RunningSinceCycles = 0; // When the current stretch of running began
+	uint64 AccumulatedCycles = 0; // Everything from before the last pause
+	int64 DisplayedSeconds = -1;
+	TWeakPtr<STextBlock> Text;
+};
+
+/**
+* One ticker shared by every running clock. Instead of ticking every frame (or every second whether anything changed
+* or not) it schedules a single one-shot tick for the next time any clock's display changes, and goes away entirely
+* when nothing is running. Game thread only.
+*/
+class GAMEWINDOW_API MineSweeperClockTicker
+{
+public:
+	static MineSweeperClockTicker& Get();
+
+	void Add(const TSharedRef<MineSweeperClock>& Clock);
+	void Remove(const MineSweeperClock& Clock);
+
+	int32 NumRunning() const { return Running.Num(); }
+
+private:
+	bool Tick(float DeltaTime);
+	void Schedule();
+
+	TArray<TWeakPtr<MineSweeperClock>> Running;
+	FTSTicker::FDelegateHandle Handle;
+};
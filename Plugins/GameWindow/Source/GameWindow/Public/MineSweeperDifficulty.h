@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include <vector>
+
+/**
+* How hard one board is, for tuning the presets.
+*/
+struct MineSweeperDifficulty
+{
+	int32 ThreeBV = 0; // Fewest clicks that clear the board without flagging: one per opening plus one per number not touching one
+	int32 NumOpenings = 0;
+	int32 NumGuesses = 0; // Times the solver got stuck after the first click, see MineSweeperDifficultyAnalyzer
+	int32 NumIslands = 0; // Groups of touching numbers that no opening reaches, each has to be cleared a tile at a time
+	int32 LargestIsland = 0;
+};
+
+/**
+* Works out the difficulty of boards one after another, and is the scratch for doing it. It owns a grid and every buffer
+* the measuring needs, all sized once in the constructor, so analysing a board after that doesn't allocate. Give each
+* thread its own.
+*
+* Guesses come from a solver that knows the two basic rules (a number with all its flags makes its other neighbors
+* safe, a number with as many hidden neighbors as mines makes them all mines), which is exactly what auto play does,
+* plus the subset rule for pairs of numbers (a 1-2 against a wall and the like). Whenever those run out it counts a
+* guess and clicks a safe tile, preferring an opening, so the count is how often a player needs luck and not how often
+* they'd lose. Boards that need whole-frontier reasoning score a little higher than a strong player would find them.
+*/
+class GAMEWINDOW_API MineSweeperDifficultyAnalyzer
+{
+public:
+	MineSweeperDifficultyAnalyzer(int32 InWidth, int32 InHeight, int32 InNumMines);
+
+	/**
+	* Places mines exactly the way RandomBoardGenerator does for the same seed, so a seed here is the same board a
+	* seeded game gets, and measures it.
+	*/
+	MineSweeperDifficulty Analyze(int32 Seed);
+
+private:
+	void PlaceMines(int32 Seed);
+	void MeasureOpenings(MineSweeperDifficulty& Out);
+	void Solve(MineSweeperDifficulty& Out);
+
+	/**
+	* Looks for two numbers where the unknown tiles of one are all unknown tiles of the other, in which case the mines
+	* left over have to be in the difference. Plays whatever that proves in one pass over the board and returns whether it found anything.
+	*/
+	bool ApplySubsetRule();
+
+	/** The hidden, unflagged neighbors of Tile, and how many mines are still among them */
+	int32 GetUnknownNeighbors(int32 Tile, int32* OutUnknown, int32& OutMinesLeft) const;
+
+	/** The next tile the solver clicks when it's stuck, or INDEX_NONE once the board is clear */
+	int32 FindGuess();
+
+	int32 Width;
+	int32 Height;
+	int32 NumMines;
+	TSharedRef<MineSweeperGrid> Grid;
+	FRandomStream Stream;
+	std::vector<bool> Mines;
+	std::vector<bool> Visited;
+	std::vector<int32> RevealedTiles;
+	std::vector<int32> FlaggedTiles;
+	std::vector<int32> ChangedTiles;
+	std::vector<int32> IslandStack;
+	int32 OpeningCursor = 0; // Tiles only ever get revealed, so the guess searches never have to look back
+	int32 SafeCursor = 0;
+};
+
+/**
+* Results for a batch of seeds, one column per measurement with a row per seed.
+*
+* Written to disk as a little endian columnar file: a header of magic "MSDA", format version, width, height, mines
+* (uint32 each), the row count (uint64) and the column count (uint32), then for each column a 16 byte zero padded name
+* and its element size in bytes (uint32), then each column's rows back to back in the same order. Any column can be
+* read, or memory mapped, without touching the others.
+*/
+struct GAMEWINDOW_API MineSweeperDifficultyColumns
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 NumMines = 0;
+	std::vector<int32> Seeds;
+	std::vector<uint16> ThreeBV;
+	std::vector<uint16> NumOpenings;
+	std::vector<uint16> NumGuesses;
+	std::vector<uint16> NumIslands;
+	std::vector<uint16> LargestIsland;
+
+	void Reset(int32 NumRows);
+	int32 Num() const { return int32(Seeds.size()); }
+	void Set(int32 Row, int32 Seed, const MineSweeperDifficulty& Difficulty);
+	bool Write(const FString& Path) const;
+};
+
+namespace MineSweeperAnalysis
+{
+	/**
+	* Measures NumSeeds boards starting at FirstSeed, spread over every worker thread. Each worker keeps one analyzer
+	* and takes seeds in chunks, and rows are written straight into their slot in the columns so nothing is shared
+	* between workers but the chunk counter. Blocks until the batch is done, so call it from a worker of your own if
+	* the game thread shouldn't wait.
+	*/
+	GAMEWINDOW_API void AnalyzeDifficulty(int32 Width, int32 Height, int32 NumMines, int32 FirstSeed, int32 NumSeeds, MineSweeperDifficultyColumns& Out);
+}
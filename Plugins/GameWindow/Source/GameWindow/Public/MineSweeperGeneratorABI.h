@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+* The C ABI for board generators that live in their own shared library, see NativeBoardGenerator for the Unreal side.
+*
+* This header is plain C on purpose. A generator only has to include it, export MineSweeperGetGeneratorApi, and can be
+* built with any compiler, standard library or language that can produce a C shared library. Nothing that crosses the
+* boundary is a C++ type, and nothing allocated on one side is freed on the other.
+*
+* Boards are bitsets: tile Row * Width + Column is a mine if bit (Tile % 64) of word (Tile / 64) is set. A batch of
+* boards is one caller owned buffer with WordsPerBoard words per board, back to back, so a generator writes K boards
+* without a single allocation.
+*
+* Structs start with their size so either side can add fields on the end later without breaking the other. Anything
+* that changes the meaning of an existing field bumps MINESWEEPER_GENERATOR_ABI_VERSION instead.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MINESWEEPER_GENERATOR_ABI_VERSION 1
+#define MINESWEEPER_GENERATOR_ENTRY_POINT "MineSweeperGetGeneratorApi"
+
+typedef struct MineSweeperGeneratorRequest
+{
+	uint32_t StructSize;
+	int32_t Width;
+	int32_t Height;
+	int32_t NumMines;
+	uint64_t FirstSeed; /* Board i of the batch is generated from FirstSeed + i, and the same seed always gives the same board */
+	int32_t NumBoards;
+	int32_t Reserved;
+	uint64_t WordsPerBoard; /* At least (Width * Height + 63) / 64, the caller may pad boards to a larger stride */
+} MineSweeperGeneratorRequest;
+
+/** Return values of GenerateBatch. Anything not negative is the number of boards written. */
+#define MINESWEEPER_GENERATOR_ERROR_INVALID_REQUEST (-1)
+#define MINESWEEPER_GENERATOR_ERROR_BUFFER_TOO_SMALL (-2)
+
+typedef struct MineSweeperGeneratorApi
+{
+	uint32_t StructSize;
+	uint32_t AbiVersion;
+	const char* Name; /* Owned by the library, valid until it's unloaded */
+
+	/**
+	* Per caller state, e.g. scratch the generator wants to keep between batches. A context is only ever used by one
+	* thread at a time, so a host generating on several threads creates one each. May return NULL if the generator has
+	* no state, and NULL is what gets passed back in.
+	*/
+	void* (*CreateContext)(void);
+	void (*DestroyContext)(void* Context);
+
+	/**
+	* Writes Request->NumBoards boards into OutBits, which holds OutNumWords words. Every board's words are written in
+	* full, padding included, so the caller doesn't need to clear the buffer first.
+	*/
+	int32_t (*GenerateBatch)(void* Context, const MineSweeperGeneratorRequest* Request, uint64_t* OutBits, uint64_t OutNumWords);
+} MineSweeperGeneratorApi;
+
+/**
+* The one symbol a generator library exports. Returns NULL if it can't work with a host on HostAbiVersion.
+*/
+typedef const MineSweeperGeneratorApi* (*MineSweeperGetGeneratorApiFunc)(uint32_t HostAbiVersion);
+
+#ifdef __cplusplus
+}
+#endif
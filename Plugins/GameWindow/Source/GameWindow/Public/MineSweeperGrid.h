@@ -0,0 +1,500 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperTopologyPolicy.h"
+#include <array>
+#include <vector>
+
+class MineSweeperNeighborTable;
+
+/**
+* The packed state of a Minesweeper board, with no widgets attached.
+*
+* Tiles are addressed by a flat index (Row * Width + Column). Internally every implementation stores the board
+* with a one tile sentinel border around it, so neighbor lookups never need to check for the edge of the board.
+* The sentinels are marked as revealed, which is what stops the flood fill from walking off the board.
+*
+* Boards that aren't a square grid (hexagons, triangles, 3D) implement the same interface on top of a precomputed
+* neighbor table, see MineSweeperTopology.h.
+*/
+class GAMEWINDOW_API MineSweeperGrid
+{
+public:
+	virtual ~MineSweeperGrid() = default;
+
+	/** The most neighbors any topology can have, which is the 26 surrounding cubes of a 3D board */
+	static constexpr int32 MaxNeighbors = 26;
+
+	virtual int32 GetWidth() const = 0;
+	virtual int32 GetHeight() const = 0;
+	virtual int32 GetDepth() const { return 1; }
+	virtual EMineSweeperTopology GetTopology() const { return EMineSweeperTopology::Square; }
+	int32 Num() const { return GetWidth() * GetHeight() * GetDepth(); }
+
+	/** Rows as they're laid out on screen, where a 3D board stacks its layers one under the other */
+	int32 GetRows() const { return GetHeight() * GetDepth(); }
+	int32 ToTile(int32 Row, int32 Column) const { return Row * GetWidth() + Column; }
+
+	/**
+	* Clears the board and places the mines from a generator, then works out every adjacency count in one pass.
+	*/
+	virtual void SetMines(const std::vector<std::vector<bool>>& Board) = 0;
+
+	/**
+	* Same as above, but with one entry per tile index. This is what non-square boards are generated with.
+	*/
+	virtual void SetMines(const std::vector<bool>& Tiles) = 0;
+
+	/**
+	* Writes the neighbors of a tile into OutNeighbors, which needs room for MaxNeighbors, and returns how many there are.
+	*/
+	virtual int32 GetNeighbors(int32 Tile, int32* OutNeighbors) const = 0;
+
+	virtual bool IsMine(int32 Tile) const = 0;
+	virtual bool IsRevealed(int32 Tile) const = 0;
+	virtual int32 GetAdjacentMines(int32 Tile) const = 0;
+
+	/**
+	* Reveals a tile, and if it has no neighboring mines keeps going until the whole opening is revealed.
+	* Every tile that changed is appended to OutRevealed so the caller only has to repaint those.
+	*/
+	virtual int32 Reveal(int32 Tile, std::vector<int32>& OutRevealed) = 0;
+
+	virtual int32 GetNumMines() const = 0;
+	virtual int32 GetRemainingSafeTiles() const = 0;
+
+	/**
+	* Flags. Every tile keeps how many of its neighbors are flagged and how many are still hidden, and both are updated
+	* in place whenever a flag is toggled or a tile is revealed, so nothing ever has to rescan a neighborhood to find out.
+	* Flagged tiles are never revealed, not by a click and not by an opening flooding into them.
+	*/
+	virtual bool IsFlagged(int32 Tile) const = 0;
+	virtual int32 GetAdjacentFlags(int32 Tile) const = 0;
+	virtual int32 GetAdjacentHidden(int32 Tile) const = 0;
+	virtual int32 GetNumFlags() const = 0;
+
+	/**
+	* Flags or unflags a hidden tile and fixes up the counters of its neighbors. Returns false if nothing changed,
+	* which is the case for revealed tiles.
+	*/
+	virtual bool SetFlagged(int32 Tile, bool bFlagged) = 0;
+	bool ToggleFlag(int32 Tile) { return SetFlagged(Tile, !IsFlagged(Tile)); }
+
+	/**
+	* Clicking a revealed number that already has that many flags around it reveals all of its other neighbors.
+	* If one of the flags was wrong this reveals a mine, so the caller still has to check what came back.
+	*/
+	int32 Chord(int32 Tile, std::vector<int32>& OutRevealed);
+
+	/**
+	* Plays everything that follows from the counters, starting from the tiles in Changed and spreading out from
+	* whatever it changes. A number with as many flags as mines gets chorded, and a number with as many hidden neighbors
+	* as mines gets all of them flagged. Each tile is only looked at again when one of its neighbors changes, so the
+	* work is linear in what gets touched rather than in the size of the board. Stops as soon as a mine is revealed.
+	*/
+	int32 AutoPlay(const std::vector<int32>& Changed, bool bAutoFlag, bool bAutoReveal, std::vector<int32>& OutRevealed, std::vector<int32>& OutFlagged);
+
+	/**
+	* Moves a single mine and fixes up the adjacency counts around both tiles, so it costs O(neighbors) whatever the board size.
+	*/
+	virtual void MoveMine(int32 From, int32 To) = 0;
+
+	/**
+	* First click safety. Any mine on Tile (and on its neighbors too if bClearNeighbors, which guarantees the first click
+	* opens up an area) is moved to a uniformly random free tile somewhere else. Only the few mines that move are touched,
+	* so this is O(1) in the size of the board rather than regenerating until we get lucky, and a seeded Stream keeps
+	* the result reproducible. Returns how many mines were moved.
+	*
+	* OutMoves, if given, needs room for 2 * (MaxNeighbors + 1) entries and gets each move as a from, to pair, for
+	* anything that keeps its own counts of where the mines are.
+	*/
+	int32 RelocateMinesAround(int32 Tile, bool bClearNeighbors, FRandomStream& Stream, int32* OutMoves = nullptr);
+
+	/** The neighbor table this grid runs on, or null for the padded square grids, which don't need one */
+	virtual TSharedPtr<const MineSweeperNeighborTable> GetNeighborTable() const { return nullptr; }
+
+	/** Bytes owned by this grid, including its own size. Shared neighbor tables aren't counted. */
+	virtual SIZE_T GetAllocatedSize() const = 0;
+
+	/**
+	* The most the scratch counted by GetAllocatedSize can grow to: the flood fill stack, reserved for the whole board up
+	* front, and AutoPlay's queue and queued bits, which can end up holding every tile.
+	*/
+	static SIZE_T EstimateScratchSize(int32 NumTiles) { return SIZE_T(NumTiles) * 2 * sizeof(int32) + SIZE_T(NumTiles) / 8; }
+
+protected:
+	SIZE_T GetAutoPlayAllocatedSize() const { return AutoPlayQueue.capacity() * sizeof(int32) + AutoPlayQueued.capacity() / 8; }
+
+	// Scratch for AutoPlay, kept around so a long run of auto play doesn't allocate every move
+	std::vector<int32> AutoPlayQueue;
+	std::vector<bool> AutoPlayQueued;
+};
+
+namespace MineSweeperBits
+{
+	template<typename PlaneType>
+	FORCEINLINE bool Test(const PlaneType& Plane, int32 Index)
+	{
+		return (Plane[Index >> 6] >> (Index & 63)) & 1;
+	}
+
+	template<typename PlaneType>
+	FORCEINLINE void Set(PlaneType& Plane, int32 Index)
+	{
+		Plane[Index >> 6] |= uint64(1) << (Index & 63);
+	}
+
+	template<typename PlaneType>
+	FORCEINLINE void Clear(PlaneType& Plane, int32 Index)
+	{
+		Plane[Index >> 6] &= ~(uint64(1) << (Index & 63));
+	}
+
+	template<int32 Width, int32 Height>
+	constexpr std::array<int32, Width * Height> MakePaddedIndex()
+	{
+		std::array<int32, Width * Height> Table{};
+		for (int32 Tile = 0; Tile < Width * Height; Tile++)
+		{
+			Table[Tile] = (Tile / Width + 1) * (Width + 2) + Tile % Width + 1;
+		}
+		return Table;
+	}
+}
+
+/**
+* Storage for the standard presets, where everything is known at compile time.
+*
+* The index and offset tables are constexpr, so converting a tile into its padded index and walking its neighbors
+* compiles down to constant adds. Even the expert board (30x16) is only nine 64 bit words per bitplane.
+*/
+template<int32 InWidth, int32 InHeight>
+struct FixedGridLayout
+{
+	static constexpr int32 Width = InWidth;
+	static constexpr int32 Height = InHeight;
+	static constexpr int32 Stride = Width + 2;
+	static constexpr int32 PaddedNum = Stride * (Height + 2);
+	static constexpr int32 Words = (PaddedNum + 63) / 64;
+
+	static constexpr std::array<int32, 8> Offsets = SquareTopology::GetPaddedOffsets(Stride);
+
+	static constexpr std::array<int32, Width * Height> PaddedIndex = MineSweeperBits::MakePaddedIndex<Width, Height>();
+
+	std::array<uint64, Words> Mines{};
+	std::array<uint64, Words> Revealed{};
+	std::array<uint64, Words> Flagged{};
+	std::array<uint8, PaddedNum> Counts{};
+	std::array<uint8, PaddedNum> FlagCounts{};
+	std::array<uint8, PaddedNum> HiddenCounts{};
+
+	constexpr int32 GetWidth() const { return Width; }
+	constexpr int32 GetHeight() const { return Height; }
+	constexpr int32 GetStride() const { return Stride; }
+	constexpr int32 GetPaddedNum() const { return PaddedNum; }
+	constexpr const std::array<int32, 8>& GetOffsets() const { return Offsets; }
+	FORCEINLINE int32 ToPadded(int32 Tile) const { return PaddedIndex[Tile]; }
+	FORCEINLINE int32 ToTile(int32 Padded) const { return (Padded / Stride - 1) * Width + Padded % Stride - 1; }
+
+	// Everything is inline in the layout itself
+	SIZE_T GetAllocatedSize() const { return 0; }
+
+	void Clear()
+	{
+		Mines.fill(0);
+		Revealed.fill(0);
+		Flagged.fill(0);
+		Counts.fill(0);
+		FlagCounts.fill(0);
+		HiddenCounts.fill(0);
+	}
+};
+
+/**
+* Storage for any other size of board. Same padded layout as the presets, but the strides are only known at runtime.
+*/
+struct DynamicGridLayout
+{
+	DynamicGridLayout(int32 InWidth, int32 InHeight)
+		: Width(InWidth), Height(InHeight), Stride(InWidth + 2), PaddedNum((InWidth + 2) * (InHeight + 2))
+	{
+		Offsets = SquareTopology::GetPaddedOffsets(Stride);
+		Mines.resize((PaddedNum + 63) / 64);
+		Revealed.resize((PaddedNum + 63) / 64);
+		Flagged.resize((PaddedNum + 63) / 64);
+		Counts.resize(PaddedNum);
+		FlagCounts.resize(PaddedNum);
+		HiddenCounts.resize(PaddedNum);
+	}
+
+	int32 Width, Height, Stride, PaddedNum;
+	std::array<int32, 8> Offsets;
+	std::vector<uint64> Mines;
+	std::vector<uint64> Revealed;
+	std::vector<uint64> Flagged;
+	std::vector<uint8> Counts;
+	std::vector<uint8> FlagCounts;
+	std::vector<uint8> HiddenCounts;
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+	int32 GetStride() const { return Stride; }
+	int32 GetPaddedNum() const { return PaddedNum; }
+	const std::array<int32, 8>& GetOffsets() const { return Offsets; }
+	FORCEINLINE int32 ToPadded(int32 Tile) const { return (Tile / Width + 1) * Stride + Tile % Width + 1; }
+	FORCEINLINE int32 ToTile(int32 Padded) const { return (Padded / Stride - 1) * Width + Padded % Stride - 1; }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return (Mines.capacity() + Revealed.capacity() + Flagged.capacity()) * sizeof(uint64) + Counts.capacity() + FlagCounts.capacity() + HiddenCounts.capacity();
+	}
+
+	/** What GetAllocatedSize will come to for a board this size, before there is one */
+	static SIZE_T EstimateAllocatedSize(int32 Width, int32 Height)
+	{
+		const SIZE_T Padded = SIZE_T(Width + 2) * SIZE_T(Height + 2);
+		return (Padded + 63) / 64 * 3 * sizeof(uint64) + Padded * 3;
+	}
+
+	void Clear()
+	{
+		std::fill(Mines.begin(), Mines.end(), 0);
+		std::fill(Revealed.begin(), Revealed.end(), 0);
+		std::fill(Flagged.begin(), Flagged.end(), 0);
+		std::fill(Counts.begin(), Counts.end(), 0);
+		std::fill(FlagCounts.begin(), FlagCounts.end(), 0);
+		std::fill(HiddenCounts.begin(), HiddenCounts.end(), 0);
+	}
+};
+
+/**
+* All of the game logic lives here once, and the layout decides whether the strides are constants or not.
+*/
+template<typename LayoutType>
+class MineSweeperGridImpl final : public MineSweeperGrid
+{
+public:
+	template<typename... ArgTypes>
+	explicit MineSweeperGridImpl(ArgTypes... Args) : Layout(Args...)
+	{
+		Stack.reserve(Layout.GetWidth() * Layout.GetHeight());
+		Clear();
+	}
+
+	int32 GetWidth() const override { return Layout.GetWidth(); }
+	int32 GetHeight() const override { return Layout.GetHeight(); }
+
+	void SetMines(const std::vector<std::vector<bool>>& Board) override
+	{
+		Clear();
+		for (int32 Row = 0; Row < Layout.GetHeight(); Row++)
+		{
+			for (int32 Column = 0; Column < Layout.GetWidth(); Column++)
+			{
+				if (Board[Row][Column])
+				{
+					MineSweeperBits::Set(Layout.Mines, Layout.ToPadded(Row * Layout.GetWidth() + Column));
+					NumMines++;
+				}
+			}
+		}
+		CountAdjacentMines();
+	}
+
+	void SetMines(const std::vector<bool>& Tiles) override
+	{
+		Clear();
+		for (int32 Tile = 0; Tile < Layout.GetWidth() * Layout.GetHeight(); Tile++)
+		{
+			if (Tiles[Tile])
+			{
+				MineSweeperBits::Set(Layout.Mines, Layout.ToPadded(Tile));
+				NumMines++;
+			}
+		}
+		CountAdjacentMines();
+	}
+
+	int32 GetNeighbors(int32 Tile, int32* OutNeighbors) const override
+	{
+		// Chords, auto play, the analyzer, the server and the bots call this for every tile they look at. Only the flood fill
+		// walks the offsets directly. Here we need to leave the sentinels out.
+		int32 NumNeighbors = 0;
+		const int32 Padded = Layout.ToPadded(Tile);
+		for (int32 Offset : Layout.GetOffsets())
+		{
+			const int32 Next = Padded + Offset;
+			const int32 Row = Next / Layout.GetStride();
+			const int32 Column = Next % Layout.GetStride();
+			if (Row >= 1 && Row <= Layout.GetHeight() && Column >= 1 && Column <= Layout.GetWidth())
+			{
+				OutNeighbors[NumNeighbors++] = Layout.ToTile(Next);
+			}
+		}
+		return NumNeighbors;
+	}
+
+	void MoveMine(int32 From, int32 To) override
+	{
+		// The sentinels get their counts bumped too, which is harmless and saves a branch per neighbor
+		const int32 PaddedFrom = Layout.ToPadded(From);
+		const int32 PaddedTo = Layout.ToPadded(To);
+		MineSweeperBits::Clear(Layout.Mines, PaddedFrom);
+		for (int32 Offset : Layout.GetOffsets())
+		{
+			Layout.Counts[PaddedFrom + Offset]--;
+		}
+		MineSweeperBits::Set(Layout.Mines, PaddedTo);
+		for (int32 Offset : Layout.GetOffsets())
+		{
+			Layout.Counts[PaddedTo + Offset]++;
+		}
+	}
+
+	bool IsMine(int32 Tile) const override { return MineSweeperBits::Test(Layout.Mines, Layout.ToPadded(Tile)); }
+	bool IsRevealed(int32 Tile) const override { return MineSweeperBits::Test(Layout.Revealed, Layout.ToPadded(Tile)); }
+	int32 GetAdjacentMines(int32 Tile) const override { return Layout.Counts[Layout.ToPadded(Tile)]; }
+	int32 GetNumMines() const override { return NumMines; }
+	int32 GetRemainingSafeTiles() const override { return Layout.GetWidth() * Layout.GetHeight() - NumMines - NumRevealedSafe; }
+	bool IsFlagged(int32 Tile) const override { return MineSweeperBits::Test(Layout.Flagged, Layout.ToPadded(Tile)); }
+	int32 GetAdjacentFlags(int32 Tile) const override { return Layout.FlagCounts[Layout.ToPadded(Tile)]; }
+	int32 GetAdjacentHidden(int32 Tile) const override { return Layout.HiddenCounts[Layout.ToPadded(Tile)]; }
+	int32 GetNumFlags() const override { return NumFlags; }
+
+	SIZE_T GetAllocatedSize() const override
+	{
+		return sizeof(*this) + Layout.GetAllocatedSize() + Stack.capacity() * sizeof(int32) + GetAutoPlayAllocatedSize();
+	}
+
+	bool SetFlagged(int32 Tile, bool bFlagged) override
+	{
+		const int32 Padded = Layout.ToPadded(Tile);
+		if (MineSweeperBits::Test(Layout.Revealed, Padded) || MineSweeperBits::Test(Layout.Flagged, Padded) == bFlagged)
+		{
+			return false;
+		}
+		const int32 Delta = bFlagged ? 1 : -1;
+		bFlagged ? MineSweeperBits::Set(Layout.Flagged, Padded) : MineSweeperBits::Clear(Layout.Flagged, Padded);
+		for (int32 Offset : Layout.GetOffsets())
+		{
+			Layout.FlagCounts[Padded + Offset] += Delta;
+		}
+		NumFlags += Delta;
+		return true;
+	}
+
+	int32 Reveal(int32 Tile, std::vector<int32>& OutRevealed) override
+	{
+		const int32 Start = Layout.ToPadded(Tile);
+		if (MineSweeperBits::Test(Layout.Revealed, Start) || MineSweeperBits::Test(Layout.Flagged, Start))
+		{
+			return 0;
+		}
+		MarkRevealed(Start);
+		OutRevealed.push_back(Tile);
+		if (MineSweeperBits::Test(Layout.Mines, Start))
+		{
+			return 1;
+		}
+		NumRevealedSafe++;
+		int32 NumChanged = 1;
+
+		// A tile with no adjacent mines can't have a mine next to it, so the only thing to check is whether a neighbor is
+		// already revealed. The sentinel border counts as revealed, so there's no bounds check either.
+		Stack.clear();
+		if (Layout.Counts[Start] == 0)
+		{
+			Stack.push_back(Start);
+		}
+		while (!Stack.empty())
+		{
+			const int32 Current = Stack.back();
+			Stack.pop_back();
+			for (int32 Offset : Layout.GetOffsets())
+			{
+				const int32 Next = Current + Offset;
+				if (!MineSweeperBits::Test(Layout.Revealed, Next) && !MineSweeperBits::Test(Layout.Flagged, Next))
+				{
+					MarkRevealed(Next);
+					OutRevealed.push_back(Layout.ToTile(Next));
+					NumRevealedSafe++;
+					NumChanged++;
+					if (Layout.Counts[Next] == 0)
+					{
+						Stack.push_back(Next);
+					}
+				}
+			}
+		}
+		return NumChanged;
+	}
+
+private:
+	void CountAdjacentMines()
+	{
+		// Only the sentinels are revealed at this point, so the hidden count is just the neighbors that are on the board
+		for (int32 Tile = 0; Tile < Layout.GetWidth() * Layout.GetHeight(); Tile++)
+		{
+			const int32 Padded = Layout.ToPadded(Tile);
+			int32 Count = 0;
+			int32 Hidden = 0;
+			for (int32 Offset : Layout.GetOffsets())
+			{
+				Count += MineSweeperBits::Test(Layout.Mines, Padded + Offset);
+				Hidden += !MineSweeperBits::Test(Layout.Revealed, Padded + Offset);
+			}
+			Layout.Counts[Padded] = uint8(Count);
+			Layout.HiddenCounts[Padded] = uint8(Hidden);
+		}
+	}
+
+	FORCEINLINE void MarkRevealed(int32 Padded)
+	{
+		MineSweeperBits::Set(Layout.Revealed, Padded);
+		for (int32 Offset : Layout.GetOffsets())
+		{
+			Layout.HiddenCounts[Padded + Offset]--;
+		}
+	}
+
+	void Clear()
+	{
+		Layout.Clear();
+		NumMines = 0;
+		NumRevealedSafe = 0;
+		NumFlags = 0;
+		const int32 Stride = Layout.GetStride();
+		const int32 Rows = Layout.GetHeight() + 2;
+		for (int32 Column = 0; Column < Stride; Column++)
+		{
+			MineSweeperBits::Set(Layout.Revealed, Column);
+			MineSweeperBits::Set(Layout.Revealed, (Rows - 1) * Stride + Column);
+		}
+		for (int32 Row = 1; Row < Rows - 1; Row++)
+		{
+			MineSweeperBits::Set(Layout.Revealed, Row * Stride);
+			MineSweeperBits::Set(Layout.Revealed, Row * Stride + Stride - 1);
+		}
+	}
+
+	LayoutType Layout;
+	std::vector<int32> Stack;
+	int32 NumMines = 0;
+	int32 NumRevealedSafe = 0;
+	int32 NumFlags = 0;
+};
+
+template<int32 Width, int32 Height>
+using FixedMineSweeperGrid = MineSweeperGridImpl<FixedGridLayout<Width, Height>>;
+using DynamicMineSweeperGrid = MineSweeperGridImpl<DynamicGridLayout>;
+
+using BeginnerGrid = FixedMineSweeperGrid<9, 9>;
+using IntermediateGrid = FixedMineSweeperGrid<16, 16>;
+using ExpertGrid = FixedMineSweeperGrid<30, 16>;
+
+/**
+* Picks the compile time specialization when the size matches one of the standard presets, and the dynamic grid otherwise.
+*/
+GAMEWINDOW_API TSharedRef<MineSweeperGrid> MakeMineSweeperGrid(int32 Width, int32 Height);
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+* The log bucketed latency histogram the server and the performance panel both keep. Four buckets to every doubling
+* of microseconds, so a percentile read back is within about 20% of the real one. Whoever keeps the counts decides
+* how they're stored and who may touch them, these only do the maths.
+*/
+namespace MineSweeperLatencyHistogram
+{
+	/** Where Microseconds goes, anything at or under 1 us in the first bucket and anything too slow in the last */
+	inline int32 GetBucket(double Microseconds, int32 NumBuckets)
+	{
+		return Microseconds <= 1.0 ? 0 : FMath::Min(int32(FMath::Log2(Microseconds) * 4.0) + 1, NumBuckets - 1);
+	}
+
+	/** The top of the bucket, so percentiles err on the slow side */
+	inline double GetBucketMicroseconds(int32 Bucket)
+	{
+		return FMath::Pow(2.0, Bucket / 4.0);
+	}
+
+	/** The latency at Percentile (0 to 1) of what's been counted in Buckets, or 0 if nothing has. 1 gives the slowest bucket used. */
+	template<typename CountType>
+	double GetPercentileMicroseconds(const CountType* Buckets, int32 NumBuckets, double Percentile)
+	{
+		uint64 Total = 0;
+		for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+		{
+			Total += Buckets[Bucket];
+		}
+		const uint64 Wanted = FMath::Max<uint64>(uint64(FMath::CeilToDouble(Total * Percentile)), 1);
+		uint64 Seen = 0;
+		for (int32 Bucket = 0; Bucket < NumBuckets && Total > 0; Bucket++)
+		{
+			Seen += Buckets[Bucket];
+			if (Seen >= Wanted)
+			{
+				return GetBucketMicroseconds(Bucket);
+			}
+		}
+		return 0.0;
+	}
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperBoard.h"
+#include "MineSweeperGeneratorABI.h"
+#include <vector>
+
+/**
+* A GenerateBoard backed by a generator in a shared library, loaded at runtime through the C ABI in
+* MineSweeperGeneratorABI.h. This is the loading mechanism the GenerateBoard comment always had in mind: the generator
+* can be written in anything, and it never sees a C++ type from this side.
+*
+* Besides the usual Generate, GenerateBatch passes straight through to the library, writing a whole batch of boards
+* into one buffer the caller owns.
+*
+* Each instance has its own generator context, so an instance is for one thread at a time. Load it once per thread,
+* the library itself is only loaded once.
+*/
+class GAMEWINDOW_API NativeBoardGenerator : public GenerateBoard
+{
+public:
+	/** Loads the library and checks it speaks our ABI version. Returns null, and logs why, if it can't be used. */
+	static TSharedPtr<NativeBoardGenerator> Load(const FString& LibraryPath);
+
+	/** The library named by MineSweeper.Generator.Library, loaded on first use. Null when the cvar is empty. */
+	static TSharedPtr<NativeBoardGenerator> GetConfigured();
+
+	virtual ~NativeBoardGenerator();
+
+	/** Same as RandomBoardGenerator, a seeded generator gives the same board every time and an unseeded one never does */
+	void SetSeed(bool bInIsSeeded, int32 InSeed);
+
+	std::vector<std::vector<bool>> Generate(int Width, int Height, int NumMines) override;
+
+	/**
+	* Generates NumBoards boards from consecutive seeds into OutBits, GetWordsPerBoard words each. Returns the number of
+	* boards written, or a negative MINESWEEPER_GENERATOR_ERROR code.
+	*/
+	int32 GenerateBatch(int32 Width, int32 Height, int32 NumMines, uint64 FirstSeed, int32 NumBoards, uint64* OutBits, uint64 OutNumWords);
+
+	static uint64 GetWordsPerBoard(int32 Width, int32 Height) { return (uint64(Width) * uint64(Height) + 63) / 64; }
+	static bool IsMine(const uint64* Board, int32 Tile) { return (Board[Tile >> 6] >> (Tile & 63)) & 1; }
+
+	const FString& GetName() const { return Name; }
+	const FString& GetLibraryPath() const { return LibraryPath; }
+
+private:
+	NativeBoardGenerator() = default;
+
+	void* DllHandle = nullptr;
+	const MineSweeperGeneratorApi* Api = nullptr;
+	void* Context = nullptr;
+	FString Name;
+	FString LibraryPath;
+	bool bIsSeeded = false;
+	int32 Seed = 0;
+	std::vector<uint64> Scratch; // Generate's one board, reused
+};
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <array>
+
+/**
+* The parts of making a new board, in the order they happen.
+*/
+enum class EMineSweeperGenerationPhase : uint8
+{
+	Mines, // The generator placing mines
+	Counts, // Bitplanes and adjacency counts
+	Caches, // The pyramid, scratch lists and snapshot state
+	Widgets, // Creating the buttons or the board view, not laying them out, Slate does that on the next paint
+	Num,
+};
+
+/**
+* One move, as kept in the rolling history.
+*/
+struct MineSweeperPerfMove
+{
+	enum class EKind : uint8
+	{
+		Reveal,
+		Chord,
+		Flag,
+	};
+
+	uint32 Game = 0; // Counts up with every board, so a dump can be split by game
+	EKind Kind = EKind::Reveal;
+	int32 Tile = 0;
+	int32 Cascade = 0; // Tiles revealed or flagged, auto play included
+	int32 Widgets = 0; // Widgets updated by the move
+	float RevealUs = 0.0f; // Input to the move being applied and the widgets updated
+	float PaintMs = 0.0f; // Input to the next paint, 0 until it has happened
+	double Seconds = 0.0; // Since the board was made
+};
+
+/**
+* What the performance panel shows, for one board.
+*
+* Everything is written on the game thread as moves happen, with no locks and no allocation, so keeping count costs a
+* handful of stores a move whether the panel is open or not. It's read on the game thread too, by the panel and
+* MineSweeper.Perf.Dump, and nothing else may touch it. The history is a fixed ring that keeps the last HistorySize moves.
+*/
+class GAMEWINDOW_API MineSweeperPerfCounters
+{
+public:
+	static constexpr int32 HistorySize = 4096;
+
+	/** A new board. The history keeps rolling across boards, everything else starts again. */
+	void Reset();
+
+	void RecordGeneration(EMineSweeperGenerationPhase Phase, uint64 StartCycles);
+	void RecordMove(MineSweeperPerfMove::EKind Kind, int32 Tile, int32 Cascade, uint64 InputCycles);
+	void RecordPaint(double InputToPaintMs);
+
+	/** Called by anything that changes what a widget shows. Counted per frame. */
+	void RecordWidgetUpdates(int32 NumWidgets);
+
+	double GetGenerationMs(EMineSweeperGenerationPhase Phase) const { return GenerationMs[int32(Phase)]; }
+	MineSweeperPerfMove GetLastMove() const;
+	int32 GetNumMoves() const { return NumMoves; }
+
+	/** Input to paint at Percentile (0 to 1), from a histogram with four buckets per doubling, so within about 20% */
+	double GetPaintPercentileMs(double Percentile) const;
+	int32 GetNumPaints() const { return NumPaints; }
+
+	/** Widgets updated in the frame before this one */
+	int32 GetWidgetsLastFrame() const;
+
+	/** Writes the history, oldest move first, as CSV */
+	bool DumpHistory(const FString& Path) const;
+
+private:
+	static constexpr int32 NumPaintBuckets = 128;
+
+	double GenerationMs[int32(EMineSweeperGenerationPhase::Num)] = {};
+	uint32 PaintBuckets[NumPaintBuckets] = {};
+	int32 NumPaints = 0;
+	int32 NumMoves = 0;
+	uint32 Game = 0;
+	uint64 StartCycles = 0;
+
+	/** Two frames' worth of widget counts, so the one before the current frame can always be read back */
+	uint64 CountingFrame = 0;
+	int32 CountingWidgets = 0;
+	uint64 PreviousFrame = 0;
+	int32 PreviousWidgets = 0;
+	int32 MoveWidgets = 0; // Widget updates since the last move was recorded
+
+	std::array<MineSweeperPerfMove, HistorySize> History;
+	uint32 NextHistory = 0;
+};
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include <vector>
+
+/**
+* A mip pyramid of the board for drawing it zoomed out. Each level splits the board into square blocks twice the size
+* of the level below, and keeps how many tiles in each block are revealed, flagged and mines.
+*
+* The finest level has 8x8 blocks rather than single tiles, since the grid already answers per-tile questions and
+* a 5000x5000 board would otherwise spend hundreds of megabytes repeating it. Levels keep going until a single block
+* covers the whole board.
+*
+* Only the tiles that change are pushed up the pyramid, which costs one increment per level, so a reveal costs the
+* same here as it does in the grid times the number of levels.
+*/
+class GAMEWINDOW_API MineSweeperPyramid
+{
+public:
+	static constexpr int32 BaseShift = 3;
+
+	struct Block
+	{
+		uint32 Tiles = 0; // Blocks on the right and bottom edges can be cut short
+		uint32 Revealed = 0;
+		uint32 Flagged = 0;
+		uint32 Mines = 0;
+	};
+
+	/**
+	* Counts everything from scratch, for a new board.
+	*/
+	void Build(const MineSweeperGrid& Grid);
+
+	void OnRevealed(const std::vector<int32>& Tiles);
+	void OnFlagChanged(int32 Tile, bool bFlagged);
+
+	/** First click safety moved a mine, which only changes the blocks the two tiles are in */
+	void OnMineMoved(int32 From, int32 To);
+
+	int32 NumLevels() const { return int32(Levels.size()); }
+
+	/** Width of one block at Level, in tiles */
+	int32 GetBlockSize(int32 Level) const { return 1 << (BaseShift + Level); }
+	int32 GetLevelWidth(int32 Level) const { return Levels[Level].Width; }
+	int32 GetLevelHeight(int32 Level) const { return Levels[Level].Height; }
+	Block GetBlock(int32 Level, int32 BlockX, int32 BlockY) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct Level
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		std::vector<uint32> Revealed;
+		std::vector<uint32> Flagged;
+		std::vector<uint32> Mines;
+	};
+
+	template<typename FuncType>
+	void ForEachLevel(int32 Tile, FuncType&& Func)
+	{
+		const int32 Row = Tile / BoardWidth;
+		const int32 Column = Tile % BoardWidth;
+		for (int32 Index = 0; Index < int32(Levels.size()); Index++)
+		{
+			const int32 Shift = BaseShift + Index;
+			Func(Levels[Index], (Row >> Shift) * Levels[Index].Width + (Column >> Shift));
+		}
+	}
+
+	int32 BoardWidth = 0;
+	int32 BoardHeight = 0;
+	std::vector<Level> Levels;
+};
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include "Async/Future.h"
+#include "Misc/ScopeRWLock.h"
+#include <atomic>
+#include <vector>
+
+/**
+* The wire format of MineSweeperServer. Everything is little endian and fixed size, so a client in any language is a
+* couple of structs and a socket.
+*
+* A request is a uint32 command count followed by that many Commands, and the reply is a uint32 count followed by one
+* Result per command in the same order. Commands in a batch can be for any mix of sessions, and each session sees its
+* commands in the order they were sent.
+*/
+namespace MineSweeperProtocol
+{
+	enum class EOp : uint8
+	{
+		Create, // Starts (or restarts) the session as a new Width x Height board with NumMines, placed from the seed in Arg
+		Reveal, // Arg is the tile. Revealing a revealed number chords it, same as clicking it in the editor
+		Flag, // Arg is the tile, toggles its flag
+		Close,
+	};
+
+	enum class EStatus : uint8
+	{
+		Ok,
+		Lost,
+		Won,
+		NoSession,
+		GameOver, // The session's game has already been won or lost, Create it again to keep playing
+		Invalid,
+	};
+
+	struct Command
+	{
+		uint32 SessionId = 0;
+		EOp Op = EOp::Reveal;
+		uint8 Reserved = 0;
+		uint16 NumMines = 0;
+		uint16 Width = 0;
+		uint16 Height = 0;
+		int32 Arg = 0;
+	};
+	static_assert(sizeof(Command) == 16, "Commands go over the wire as they are");
+
+	struct Result
+	{
+		uint32 SessionId = 0;
+		EOp Op = EOp::Reveal;
+		EStatus Status = EStatus::Ok;
+		uint16 NumChanged = 0; // Tiles revealed or flagged by the command, clamped
+		int32 RemainingSafeTiles = 0;
+	};
+	static_assert(sizeof(Result) == 12, "Results go over the wire as they are");
+
+	constexpr uint32 MaxBatch = 1 << 16;
+}
+
+/**
+* Latency and throughput of a server since it started or since the last ResetStats.
+*/
+struct MineSweeperServerStats
+{
+	int64 NumCommands = 0;
+	int32 NumSessions = 0;
+	double Seconds = 0.0;
+	double P50Us = 0.0;
+	double P90Us = 0.0;
+	double P99Us = 0.0;
+	double MaxUs = 0.0;
+
+	double GetCommandsPerSecond() const { return Seconds > 0.0 ? NumCommands / Seconds : 0.0; }
+};
+
+/**
+* Hosts any number of independent games for bots and load tests, without any widgets.
+*
+* Sessions are spread over worker threads by id, and a session only ever lives on its shard's thread, so nothing about
+* a session is ever locked. Each shard has its own lock-free multiple producer ring, allocated once when the server
+* starts. Connections push commands onto the shards they're for, and the shard's thread drains its ring in order, so a
+* session's commands stay in sequence.
+* Nothing is shared between shards but the stats counters. A batch waits for all its commands to come back and then
+* answers them together.
+*
+* The front end is a Unix domain socket (Linux and Mac only), with a thread per connection. Connections are expected to
+* be a handful of bots or load generators each driving lots of sessions, not a connection per session.
+*/
+class GAMEWINDOW_API MineSweeperServer
+{
+public:
+	MineSweeperServer() = default;
+	~MineSweeperServer();
+
+	/** Listens on SocketPath with NumShards worker threads, 0 for one per core. Returns false if the socket can't be opened. */
+	bool Start(const FString& SocketPath, int32 NumShards = 0);
+	void Stop();
+	bool IsRunning() const { return bRunning; }
+
+	/**
+	* Runs a batch and blocks until every command has been answered. The socket front end uses this, and anything in
+	* process can call it directly from any thread, even while another thread stops the server: Stop waits for batches
+	* already in, and a batch sent once the server is stopped gets NoSession for every command.
+	*/
+	void Execute(const MineSweeperProtocol::Command* Commands, int32 NumCommands, MineSweeperProtocol::Result* OutResults);
+
+	/** Safe from any thread, the same as Execute */
+	MineSweeperServerStats GetStats() const;
+	void ResetStats();
+
+	/** Where the last Start listened, which is only the default if it was given the default */
+	const FString& GetSocketPath() const { return Path; }
+	static FString GetDefaultSocketPath();
+
+	/**
+	* Called at startup. With -MineSweeperServer[=<socket path>] on the command line, starts a server that runs until
+	* the module shuts down.
+	*/
+	static void StartIfRequested();
+
+	/** Called from ShutdownModule. Stops the server started from the command line or the console, if there is one. */
+	static void StopRunning();
+
+private:
+	/** Latency histogram buckets, four to every doubling of microseconds */
+	static constexpr int32 NumLatencyBuckets = 160;
+
+	struct Batch
+	{
+		const MineSweeperProtocol::Command* Commands = nullptr;
+		MineSweeperProtocol::Result* Results = nullptr;
+		std::atomic<int32> Remaining = 0;
+		FEvent* Done = nullptr;
+	};
+
+	struct Pending
+	{
+		Batch* Owner = nullptr;
+		int32 Index = 0;
+		uint64 EnqueueCycles = 0;
+	};
+
+	/**
+	* A bounded queue of Pending for many producers and one consumer, with a sequence number per slot (Vyukov's) so
+	* neither side ever takes a lock or allocates. A producer claims a slot by moving Tail along, fills it in and then
+	* publishes it by bumping its sequence, and the shard's thread only reads slots that have been published.
+	*/
+	class PendingRing
+	{
+	public:
+		explicit PendingRing(int32 Capacity);
+
+		/** False if the ring is full, in which case the caller has to wait for the shard to catch up */
+		bool Enqueue(const Pending& Item);
+
+		/** Only ever called by the shard's own thread */
+		bool Dequeue(Pending& OutItem);
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint64> Sequence = 0;
+			Pending Item;
+		};
+
+		TUniquePtr<Slot[]> Slots;
+		uint64 Mask = 0;
+		alignas(64) std::atomic<uint64> Tail = 0; // Kept off the consumer's line, producers hammer it
+		alignas(64) uint64 Head = 0;
+	};
+
+	/** Commands each shard can have queued before producers wait, 128KB of slots per shard */
+	static constexpr int32 QueueCapacity = 4096;
+
+	struct Session
+	{
+		TSharedPtr<MineSweeperGrid> Grid;
+		std::vector<int32> RevealedTiles;
+		bool bOver = false;
+	};
+
+	struct Shard
+	{
+		PendingRing Queue{ QueueCapacity };
+		FEvent* Wake = nullptr;
+		TMap<uint32, Session> Sessions; // Only ever touched by this shard's thread
+		TFuture<void> Thread;
+		std::atomic<int64> NumCommands = 0;
+		std::atomic<int32> NumSessions = 0;
+		std::atomic<uint64> Latency[NumLatencyBuckets] = {};
+	};
+
+	void RunShard(Shard& InShard);
+	MineSweeperProtocol::Result RunCommand(Shard& InShard, const MineSweeperProtocol::Command& InCommand);
+	void AcceptConnections();
+	void ServeConnection(int32 Connection);
+
+	/** Held for reading for the whole of every batch and stats read, and for writing while Start and Stop change the shards */
+	mutable FRWLock ShardsLock;
+	TArray<TUniquePtr<Shard>> Shards;
+	std::atomic<bool> bRunning = false;
+	std::atomic<bool> bStopShards = false;
+	int32 ListenSocket = -1;
+	FString Path;
+	TFuture<void> AcceptThread;
+
+	/** Open connections, so Stop can close them. Only touched on connect and disconnect, never per command. */
+	FCriticalSection ConnectionsLock;
+	TArray<int32> Connections;
+	std::atomic<int32> NumConnectionThreads = 0;
+
+	std::atomic<uint64> StatsStartCycles = 0;
+};
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include "MineSweeperTopology.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+* A read only copy of what the player can see of a board, for hints and analysis running on worker threads.
+*
+* A snapshot never changes once it's published, so any number of workers can read one without locks while the game
+* thread keeps applying moves to the real grid. They're copy on write: the revealed and flagged bitplanes are cut into
+* pages, and a new snapshot shares every page with the one before it except the pages a move actually touched.
+*
+* Every move bumps the version. A worker can call IsStale() to give up early, and whoever gets its result back
+* compares versions to decide whether the result can still be used.
+*/
+class GAMEWINDOW_API MineSweeperSnapshot
+{
+public:
+	static constexpr int32 PageShift = 12;
+	static constexpr int32 PageTiles = 1 << PageShift; // 4096 tiles, so half a kilobyte per bitplane per page
+	static constexpr int32 PageWords = PageTiles / 64;
+
+	struct Page
+	{
+		std::array<uint64, PageWords> Revealed{};
+		std::array<uint64, PageWords> Flagged{};
+	};
+
+	/**
+	* Everything that stays the same for a whole game. The adjacency counts can only change on the first click, and
+	* that starts a new game as far as snapshots are concerned.
+	*/
+	struct Game
+	{
+		uint32 GameId = 0;
+		MineSweeperDimensions Dims;
+		int32 NumMines = 0;
+		TSharedPtr<const MineSweeperNeighborTable> Table; // Null for square boards, whose neighbors are worked out from Dims
+		std::vector<uint8> Counts;
+	};
+
+	uint64 GetVersion() const { return Version; }
+	uint32 GetGameId() const { return SharedGame->GameId; }
+	int32 GetWidth() const { return SharedGame->Dims.Width; }
+	int32 GetHeight() const { return SharedGame->Dims.Height; }
+	int32 Num() const { return SharedGame->Dims.Num(); }
+	int32 GetNumMines() const { return SharedGame->NumMines; }
+
+	/**
+	* Calls Func with every neighbor of Tile. Other topologies walk the board's own table, square boards work their
+	* neighbors out from the row and column, so a snapshot never needs a table the board itself didn't have.
+	*/
+	template<typename FuncType>
+	FORCEINLINE void ForEachNeighbor(int32 Tile, FuncType&& Func) const
+	{
+		if (const MineSweeperNeighborTable* Table = SharedGame->Table.Get())
+		{
+			for (const int32* Neighbor = Table->Begin(Tile); Neighbor != Table->End(Tile); ++Neighbor)
+			{
+				Func(*Neighbor);
+			}
+		}
+		else
+		{
+			SquareTopology::ForEachNeighbor(SharedGame->Dims, Tile, Func);
+		}
+	}
+
+	bool IsRevealed(int32 Tile) const { return MineSweeperBits::Test(Pages[Tile >> PageShift]->Revealed, Tile & (PageTiles - 1)); }
+	bool IsFlagged(int32 Tile) const { return MineSweeperBits::Test(Pages[Tile >> PageShift]->Flagged, Tile & (PageTiles - 1)); }
+
+	/** Only revealed tiles have a number the player can see, every other tile gives INDEX_NONE so analysis can't cheat */
+	int32 GetAdjacentMines(int32 Tile) const { return IsRevealed(Tile) ? SharedGame->Counts[Tile] : INDEX_NONE; }
+
+	/** True once the game thread has moved on past this snapshot. Safe to call from any thread. */
+	bool IsStale() const { return LatestVersion->load(std::memory_order_relaxed) != Version; }
+
+	/**
+	* Whether the page holding Tile is the same page in both snapshots, which means nothing in it has changed between
+	* them. Lets analysis of a small area survive moves made somewhere else on the board.
+	*/
+	bool SharesPage(const MineSweeperSnapshot& Other, int32 Tile) const
+	{
+		return SharedGame == Other.SharedGame && Pages[Tile >> PageShift] == Other.Pages[Tile >> PageShift];
+	}
+
+	SIZE_T GetAllocatedSize() const { return sizeof(*this) + Pages.capacity() * sizeof(TSharedPtr<const Page, ESPMode::ThreadSafe>); }
+
+private:
+	friend class MineSweeperSnapshotPublisher;
+
+	uint64 Version = 0;
+	TSharedPtr<const Game, ESPMode::ThreadSafe> SharedGame;
+	std::vector<TSharedPtr<const Page, ESPMode::ThreadSafe>> Pages;
+	TSharedPtr<const std::atomic<uint64>, ESPMode::ThreadSafe> LatestVersion;
+};
+
+using MineSweeperSnapshotRef = TSharedRef<const MineSweeperSnapshot, ESPMode::ThreadSafe>;
+
+/**
+* Lives on the game thread next to the grid and turns it into snapshots. Moves only mark tiles dirty, and nothing is
+* copied until someone actually asks for a snapshot, so a game with no analysis running pays for a version bump per move.
+*/
+class GAMEWINDOW_API MineSweeperSnapshotPublisher
+{
+public:
+	MineSweeperSnapshotPublisher();
+
+	/**
+	* A new board, or mines that moved on the first click. The next snapshot is built from scratch.
+	*/
+	void Invalidate();
+
+	/**
+	* Records tiles whose revealed or flagged state just changed and bumps the version.
+	*/
+	void MarkDirty(const std::vector<int32>& Tiles);
+
+	/**
+	* Returns a snapshot of the grid as it is now. Only pages with dirty tiles are copied, the rest are shared with the
+	* last snapshot, so this costs the number of pages plus the tiles changed since then rather than the size of the board.
+	*/
+	MineSweeperSnapshotRef Publish(const MineSweeperGrid& Grid);
+
+	uint64 GetVersion() const { return LatestVersion->load(std::memory_order_relaxed); }
+	uint32 GetGameId() const { return GameId; }
+
+	/** The latest snapshot with all of its pages, whether or not older snapshots still share them, plus pending dirty tiles */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void Rebuild(const MineSweeperGrid& Grid);
+
+	TSharedRef<std::atomic<uint64>, ESPMode::ThreadSafe> LatestVersion;
+	TSharedPtr<const MineSweeperSnapshot, ESPMode::ThreadSafe> Latest;
+	std::vector<int32> DirtyTiles;
+	uint32 GameId = 0;
+	bool bNeedsRebuild = true;
+};
@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperDifficulty.h"
+#include "HAL/PlatformProcess.h"
+#include <atomic>
+
+/**
+* One headless game as it comes back from a sweep worker. Twelve bytes, so a shard of a million games is 12MB of
+* shared memory and nothing else.
+*/
+struct MineSweeperGameRecord
+{
+	int32 Seed = 0;
+	uint16 ThreeBV = 0;
+	uint16 NumOpenings = 0;
+	uint16 NumGuesses = 0;
+	uint8 NumIslands = 0; // Both clamped to 255, an island count or size past that is off the end of any histogram we'd draw
+	uint8 LargestIsland = 0;
+
+	static MineSweeperGameRecord Make(int32 Seed, const MineSweeperDifficulty& Difficulty);
+};
+static_assert(sizeof(MineSweeperGameRecord) == 12, "Workers and the runner share these through memory, keep them packed");
+
+/**
+* The merged results of a sweep, as histograms so any number of games fits in the same space and merging two of them is
+* just adding bins. Small enough to write out whole every checkpoint.
+*/
+struct GAMEWINDOW_API MineSweeperSweepStats
+{
+	int64 NumGames = 0;
+	int64 NumNoGuessGames = 0;
+	TArray<int64> ThreeBV;
+	TArray<int64> NumOpenings;
+	TArray<int64> NumGuesses;
+	TArray<int64> NumIslands;
+
+	void Add(const MineSweeperGameRecord& Record);
+	void Merge(const MineSweeperSweepStats& Other);
+
+	static double GetMean(const TArray<int64>& Histogram);
+	static int32 GetPercentile(const TArray<int64>& Histogram, double Percentile);
+
+	friend FArchive& operator<<(FArchive& Ar, MineSweeperSweepStats& Stats);
+};
+
+/**
+* What a sweep worker process reads its orders from and writes its games into. It sits at the start of a named shared
+* memory region with the records right after it. The runner fills in everything but NumWritten and State before it
+* launches the worker.
+*
+* The worker writes a record and only then bumps NumWritten with release ordering, so everything below NumWritten is
+* safe for the runner to read while the worker carries on. Nothing is ever written twice, so there are no locks.
+*/
+struct MineSweeperShardHeader
+{
+	enum EState : int32
+	{
+		Starting,
+		Running,
+		Done,
+		Failed,
+	};
+
+	uint32 Magic = 0;
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 NumMines = 0;
+	int32 FirstSeed = 0;
+	int32 NumSeeds = 0;
+	std::atomic<int32> NumWritten = 0;
+	std::atomic<int32> State = Starting;
+
+	static constexpr uint32 ExpectedMagic = 'M' | ('S' << 8) | ('S' << 16) | ('H' << 24);
+
+	MineSweeperGameRecord* GetRecords() { return reinterpret_cast<MineSweeperGameRecord*>(this + 1); }
+	static SIZE_T GetRegionSize(int32 NumSeeds) { return sizeof(MineSweeperShardHeader) + SIZE_T(NumSeeds) * sizeof(MineSweeperGameRecord); }
+};
+static_assert(std::atomic<int32>::is_always_lock_free, "Shard progress is shared between processes, the atomics can't hide a lock");
+
+/**
+* Runs headless games over a range of seeds across several worker processes on this machine.
+*
+* One process running every game ends up fighting itself over memory bandwidth and the allocator, so each shard of the
+* range goes to its own process instead: the editor binary started again, headless, with -MineSweeperShard=<region>.
+* Workers stream records back through shared memory, and the runner folds them into one MineSweeperSweepStats as they
+* arrive.
+*
+* Every few seconds the runner writes a checkpoint with the merged stats and how far each shard has got. Starting the
+* same sweep again picks up from the checkpoint, and a worker that dies is started again from where it stopped.
+*/
+class GAMEWINDOW_API MineSweeperSweepRunner
+{
+public:
+	struct Settings
+	{
+		int32 Width = 30;
+		int32 Height = 16;
+		int32 NumMines = 99;
+		int32 FirstSeed = 0;
+		int32 NumSeeds = 0;
+		int32 NumWorkers = 0; // 0 uses one per core
+	};
+
+	explicit MineSweeperSweepRunner(const Settings& InSettings);
+	~MineSweeperSweepRunner();
+
+	/**
+	* Runs the whole sweep and blocks until it's done or cancelled. Returns false if it stopped before every game was in.
+	*/
+	bool Run();
+
+	/** Safe from any thread. Stops the workers, and the checkpoint keeps everything they got through. */
+	void Cancel() { bCancelled = true; }
+
+	const MineSweeperSweepStats& GetStats() const { return Stats; }
+	FString GetCheckpointPath() const;
+
+	/**
+	* Called at startup. If this process was launched as a sweep worker, runs its shard once the engine is up and then
+	* exits. Otherwise does nothing. A worker also gives up if the process that launched it goes away.
+	*/
+	static void RunWorkerIfRequested();
+
+	/**
+	* Called from ShutdownModule. Cancels the sweep started from the console, if there is one, and waits for it to
+	* stop, which terminates its workers. The checkpoint keeps what they got through.
+	*/
+	static void ShutdownActiveSweep();
+
+private:
+	struct Shard
+	{
+		int32 FirstSeed = 0;
+		int32 NumSeeds = 0;
+		int32 NumDone = 0; // Games already merged into Stats, from this run or an earlier one
+		int32 NumLaunches = 0;
+		int32 NumConsumed = 0; // Records read from the current worker
+		FProcHandle Process;
+		FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+
+		bool IsComplete() const { return NumDone >= NumSeeds; }
+		MineSweeperShardHeader* GetHeader() const { return Region ? static_cast<MineSweeperShardHeader*>(Region->GetAddress()) : nullptr; }
+	};
+
+	bool Launch(int32 ShardIndex);
+	void Release(Shard& InShard, bool bTerminate);
+
+	/** Merges any new records from a shard's worker, and returns true once that worker is finished one way or another */
+	bool Poll(Shard& InShard);
+
+	bool LoadCheckpoint();
+	void SaveCheckpoint();
+	void SerializeCheckpoint(FArchive& Ar);
+
+	Settings SweepSettings;
+	TArray<Shard> Shards;
+	MineSweeperSweepStats Stats;
+	std::atomic<bool> bCancelled = false;
+};
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MineSweeperGrid.h"
+#include "MineSweeperTopologyPolicy.h"
+#include <vector>
+
+/**
+* Every tile's neighbors flattened into one array (compressed sparse rows). Neighbors of Tile are
+* Neighbors[Starts[Tile]] up to Neighbors[Starts[Tile + 1]], so walking them is a plain loop over contiguous memory
+* whatever the shape of the board.
+*/
+class GAMEWINDOW_API MineSweeperNeighborTable
+{
+public:
+	template<typename TopologyType>
+	static TSharedRef<const MineSweeperNeighborTable> Build(const MineSweeperDimensions& Dims)
+	{
+		TSharedRef<MineSweeperNeighborTable> Table = MakeShared<MineSweeperNeighborTable>();
+		Table->Dims = Dims;
+		Table->Topology = TopologyType::Topology;
+		Table->MaxNeighbors = TopologyType::MaxNeighbors;
+		Table->Starts.reserve(Dims.Num() + 1);
+		Table->Neighbors.reserve(size_t(Dims.Num()) * TopologyType::MaxNeighbors);
+		for (int32 Tile = 0; Tile < Dims.Num(); Tile++)
+		{
+			Table->Starts.push_back(int32(Table->Neighbors.size()));
+			TopologyType::ForEachNeighbor(Dims, Tile, [&Table](int32 Neighbor) { Table->Neighbors.push_back(Neighbor); });
+		}
+		Table->Starts.push_back(int32(Table->Neighbors.size()));
+		Table->Neighbors.shrink_to_fit();
+		return Table;
+	}
+
+	/**
+	* Builds, or reuses, the table for a topology. Tables are immutable so every board with the same shape shares one,
+	* and the cache only holds weak references, so a table is freed with the last board that uses it.
+	*/
+	static TSharedRef<const MineSweeperNeighborTable> Get(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims);
+
+	/** Everything the tables still alive in the cache take up, counting each shared table once */
+	static SIZE_T GetCachedSize();
+
+	SIZE_T GetAllocatedSize() const { return sizeof(*this) + (Starts.capacity() + Neighbors.capacity()) * sizeof(int32); }
+
+	/** What the table for a board would take up, before it's built. Padded square boards don't have one, so 0. */
+	static SIZE_T EstimateAllocatedSize(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims);
+
+	FORCEINLINE const int32* Begin(int32 Tile) const { return Neighbors.data() + Starts[Tile]; }
+	FORCEINLINE const int32* End(int32 Tile) const { return Neighbors.data() + Starts[Tile + 1]; }
+	FORCEINLINE int32 NumNeighbors(int32 Tile) const { return Starts[Tile + 1] - Starts[Tile]; }
+
+	MineSweeperDimensions Dims;
+	EMineSweeperTopology Topology = EMineSweeperTopology::Square;
+	int32 MaxNeighbors = 0;
+	std::vector<int32> Starts;
+	std::vector<int32> Neighbors;
+};
+
+/**
+* A board of any topology, running on a neighbor table. The state is the same flat bitplanes and count array as the
+* square grids, so hexagons and cubes don't pay for anything the square boards don't.
+*/
+class GAMEWINDOW_API TopologyMineSweeperGrid final : public MineSweeperGrid
+{
+public:
+	explicit TopologyMineSweeperGrid(TSharedRef<const MineSweeperNeighborTable> InTable);
+
+	int32 GetWidth() const override { return Table->Dims.Width; }
+	int32 GetHeight() const override { return Table->Dims.Height; }
+	int32 GetDepth() const override { return Table->Dims.Depth; }
+	EMineSweeperTopology GetTopology() const override { return Table->Topology; }
+
+	void SetMines(const std::vector<std::vector<bool>>& Board) override;
+	void SetMines(const std::vector<bool>& Tiles) override;
+	int32 GetNeighbors(int32 Tile, int32* OutNeighbors) const override;
+	void MoveMine(int32 From, int32 To) override;
+
+	bool IsMine(int32 Tile) const override { return MineSweeperBits::Test(Mines, Tile); }
+	bool IsRevealed(int32 Tile) const override { return MineSweeperBits::Test(Revealed, Tile); }
+	int32 GetAdjacentMines(int32 Tile) const override { return Counts[Tile]; }
+	int32 GetNumMines() const override { return NumMines; }
+	int32 GetRemainingSafeTiles() const override { return Num() - NumMines - NumRevealedSafe; }
+	bool IsFlagged(int32 Tile) const override { return MineSweeperBits::Test(Flagged, Tile); }
+	int32 GetAdjacentFlags(int32 Tile) const override { return FlagCounts[Tile]; }
+	int32 GetAdjacentHidden(int32 Tile) const override { return HiddenCounts[Tile]; }
+	int32 GetNumFlags() const override { return NumFlags; }
+	TSharedPtr<const MineSweeperNeighborTable> GetNeighborTable() const override { return Table; }
+	SIZE_T GetAllocatedSize() const override
+	{
+		return sizeof(*this) + (Mines.capacity() + Revealed.capacity() + Flagged.capacity()) * sizeof(uint64)
+			+ Counts.capacity() + FlagCounts.capacity() + HiddenCounts.capacity()
+			+ Stack.capacity() * sizeof(int32) + GetAutoPlayAllocatedSize();
+	}
+
+	/** The bitplanes and counts GetAllocatedSize will count for a board with this many tiles */
+	static SIZE_T EstimateStateSize(int32 NumTiles) { return SIZE_T(NumTiles + 63) / 64 * 3 * sizeof(uint64) + SIZE_T(NumTiles) * 3; }
+
+	bool SetFlagged(int32 Tile, bool bFlagged) override;
+	int32 Reveal(int32 Tile, std::vector<int32>& OutRevealed) override;
+
+private:
+	void Clear();
+	void CountAdjacentMines();
+	void MarkRevealed(int32 Tile);
+
+	TSharedRef<const MineSweeperNeighborTable> Table;
+	std::vector<uint64> Mines;
+	std::vector<uint64> Revealed;
+	std::vector<uint64> Flagged;
+	std::vector<uint8> Counts;
+	std::vector<uint8> FlagCounts;
+	std::vector<uint8> HiddenCounts;
+	std::vector<int32> Stack;
+	int32 NumMines = 0;
+	int32 NumRevealedSafe = 0;
+	int32 NumFlags = 0;
+};
+
+/**
+* Square boards still go to the padded grids (and the presets to their compile time versions), every other topology
+* gets a TopologyMineSweeperGrid sharing a cached neighbor table.
+*/
+GAMEWINDOW_API TSharedRef<MineSweeperGrid> MakeMineSweeperGrid(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims);
+
+/**
+* What the grid MakeMineSweeperGrid would make reports from GetAllocatedSize once its scratch has grown as far as it
+* can, so a budget can be checked before anything is allocated. The neighbor table is shared, so it isn't included.
+*/
+GAMEWINDOW_API SIZE_T EstimateMineSweeperGridSize(EMineSweeperTopology Topology, const MineSweeperDimensions& Dims);
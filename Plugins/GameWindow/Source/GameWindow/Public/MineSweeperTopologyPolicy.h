@@ -0,0 +1,167 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <array>
+
+/**
+* The shapes of board we know how to lay out. Square boards get the padded grids from MineSweeperGrid.h, everything
+* else goes through a precomputed neighbor table.
+*/
+enum class EMineSweeperTopology : uint8
+{
+	Square,
+	Hex,
+	Triangle,
+	Cube,
+};
+
+struct MineSweeperDimensions
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 Depth = 1;
+
+	int32 Num() const { return Width * Height * Depth; }
+	bool operator==(const MineSweeperDimensions& Other) const { return Width == Other.Width && Height == Other.Height && Depth == Other.Depth; }
+};
+
+/**
+* Topology policies. Each one only has to answer "who are the neighbors of this tile", and is only ever asked once per
+* tile when the neighbor table is built, so they're written for clarity rather than speed.
+*
+* Tiles are numbered ((Layer * Height) + Row) * Width + Column for all of them.
+*/
+
+/**
+* The square board doesn't need a table. The padded grids walk the same eight neighbors as fixed offsets, which is what
+* GetPaddedOffsets gives them, and snapshots ask ForEachNeighbor directly.
+*/
+struct SquareTopology
+{
+	static constexpr EMineSweeperTopology Topology = EMineSweeperTopology::Square;
+	static constexpr int32 MaxNeighbors = 8;
+
+	/** The neighbors in the same order as ForEachNeighbor, as offsets on a board with a one tile border, Stride tiles wide */
+	static constexpr std::array<int32, MaxNeighbors> GetPaddedOffsets(int32 Stride)
+	{
+		return { -Stride - 1, -Stride, -Stride + 1, -1, 1, Stride - 1, Stride, Stride + 1 };
+	}
+
+	template<typename FuncType>
+	static void ForEachNeighbor(const MineSweeperDimensions& Dims, int32 Tile, FuncType&& Func)
+	{
+		const int32 Row = Tile / Dims.Width;
+		const int32 Column = Tile % Dims.Width;
+		for (int32 DeltaRow = -1; DeltaRow <= 1; DeltaRow++)
+		{
+			for (int32 DeltaColumn = -1; DeltaColumn <= 1; DeltaColumn++)
+			{
+				const int32 NextRow = Row + DeltaRow;
+				const int32 NextColumn = Column + DeltaColumn;
+				if ((DeltaRow != 0 || DeltaColumn != 0) && NextRow >= 0 && NextRow < Dims.Height && NextColumn >= 0 && NextColumn < Dims.Width)
+				{
+					Func(NextRow * Dims.Width + NextColumn);
+				}
+			}
+		}
+	}
+};
+
+/**
+* Pointy topped hexagons in "odd row" offset coordinates, so every odd row is pushed half a tile to the right.
+*/
+struct HexTopology
+{
+	static constexpr EMineSweeperTopology Topology = EMineSweeperTopology::Hex;
+	static constexpr int32 MaxNeighbors = 6;
+
+	template<typename FuncType>
+	static void ForEachNeighbor(const MineSweeperDimensions& Dims, int32 Tile, FuncType&& Func)
+	{
+		const int32 Row = Tile / Dims.Width;
+		const int32 Column = Tile % Dims.Width;
+		const int32 Shift = Row & 1; // Odd rows lean right, so their diagonal neighbors are one column further along
+		const int32 Deltas[6][2] = { { 0, -1 }, { 0, 1 }, { -1, Shift - 1 }, { -1, Shift }, { 1, Shift - 1 }, { 1, Shift } };
+		for (const auto& Delta : Deltas)
+		{
+			const int32 NextRow = Row + Delta[0];
+			const int32 NextColumn = Column + Delta[1];
+			if (NextRow >= 0 && NextRow < Dims.Height && NextColumn >= 0 && NextColumn < Dims.Width)
+			{
+				Func(NextRow * Dims.Width + NextColumn);
+			}
+		}
+	}
+};
+
+/**
+* Alternating up and down triangles, where (Row + Column) even points up. Any triangle touching a corner counts as a
+* neighbor, which gives the usual twelve: five on the flat side, three on the pointy side and two each way in the row.
+*/
+struct TriangleTopology
+{
+	static constexpr EMineSweeperTopology Topology = EMineSweeperTopology::Triangle;
+	static constexpr int32 MaxNeighbors = 12;
+
+	template<typename FuncType>
+	static void ForEachNeighbor(const MineSweeperDimensions& Dims, int32 Tile, FuncType&& Func)
+	{
+		const int32 Row = Tile / Dims.Width;
+		const int32 Column = Tile % Dims.Width;
+		const bool bPointsUp = ((Row + Column) & 1) == 0;
+		for (int32 DeltaRow = -1; DeltaRow <= 1; DeltaRow++)
+		{
+			// Up triangles have their flat side at the bottom, so the wide row is below them. Down triangles are the mirror image.
+			const bool bWideRow = DeltaRow == 0 || (DeltaRow == 1) == bPointsUp;
+			const int32 Reach = bWideRow ? 2 : 1;
+			for (int32 DeltaColumn = -Reach; DeltaColumn <= Reach; DeltaColumn++)
+			{
+				const int32 NextRow = Row + DeltaRow;
+				const int32 NextColumn = Column + DeltaColumn;
+				if ((DeltaRow != 0 || DeltaColumn != 0) && NextRow >= 0 && NextRow < Dims.Height && NextColumn >= 0 && NextColumn < Dims.Width)
+				{
+					Func(NextRow * Dims.Width + NextColumn);
+				}
+			}
+		}
+	}
+};
+
+/**
+* Stacked layers of square boards, where a cube touches all 26 cubes around it.
+*/
+struct CubeTopology
+{
+	static constexpr EMineSweeperTopology Topology = EMineSweeperTopology::Cube;
+	static constexpr int32 MaxNeighbors = 26;
+
+	template<typename FuncType>
+	static void ForEachNeighbor(const MineSweeperDimensions& Dims, int32 Tile, FuncType&& Func)
+	{
+		const int32 LayerSize = Dims.Width * Dims.Height;
+		const int32 Layer = Tile / LayerSize;
+		const int32 Row = (Tile % LayerSize) / Dims.Width;
+		const int32 Column = Tile % Dims.Width;
+		for (int32 DeltaLayer = -1; DeltaLayer <= 1; DeltaLayer++)
+		{
+			for (int32 DeltaRow = -1; DeltaRow <= 1; DeltaRow++)
+			{
+				for (int32 DeltaColumn = -1; DeltaColumn <= 1; DeltaColumn++)
+				{
+					const int32 NextLayer = Layer + DeltaLayer;
+					const int32 NextRow = Row + DeltaRow;
+					const int32 NextColumn = Column + DeltaColumn;
+					if ((DeltaLayer != 0 || DeltaRow != 0 || DeltaColumn != 0)
+						&& NextLayer >= 0 && NextLayer < Dims.Depth
+						&& NextRow >= 0 && NextRow < Dims.Height
+						&& NextColumn >= 0 && NextColumn < Dims.Width)
+					{
+						Func((NextLayer * Dims.Height + NextRow) * Dims.Width + NextColumn);
+					}
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Widgets/SLeafWidget.h"
+
+class MineSweeperBoard;
+
+/**
+* Draws a whole board as one widget, for boards far too big to give every tile its own button.
+*
+* Zoomed in it draws every visible tile. Once tiles get smaller than MineSweeper.View.MinTilePixels it switches to the
+* board's MineSweeperPyramid and draws one box per block instead, picking the level whose blocks come out at least that
+* many pixels across. Either way only what's on screen gets drawn, so the cost of a paint is bounded by the size of the
+* widget and not by the size of the board.
+*
+* Left click reveals, right click flags, middle drag pans and the mouse wheel zooms around the cursor.
+*/
+class GAMEWINDOW_API SMineSweeperBoardView : public SLeafWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SMineSweeperBoardView)
+		: _ViewSize(FVector2D(800.0f, 600.0f))
+	{}
+		SLATE_ARGUMENT(FVector2D, ViewSize)
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs, TSharedRef<MineSweeperBoard, ESPMode::ThreadSafe> InBoard);
+
+	virtual int32 OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect,
+		FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const override;
+	virtual FVector2D ComputeDesiredSize(float LayoutScaleMultiplier) const override { return ViewSize; }
+	virtual void Tick(const FGeometry& AllottedGeometry, const double InCurrentTime, const float InDeltaTime) override;
+
+	virtual FReply OnMouseButtonDown(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent) override;
+	virtual FReply OnMouseButtonUp(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent) override;
+	virtual FReply OnMouseMove(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent) override;
+	virtual FReply OnMouseWheel(const FGeometry& MyGeometry, const FPointerEvent& MouseEvent) override;
+
+	/** How many boxes the last paint drew, which is what the LOD is there to keep down */
+	int32 GetLastPaintElements() const { return LastPaintElements; }
+
+private:
+	/** The tile under a point in local space, or INDEX_NONE if it's off the board */
+	int32 GetTileAt(const FVector2D& LocalPosition) const;
+
+	int32 PaintTiles(const FGeometry& AllottedGeometry, FSlateWindowElementList& OutDrawElements, int32 LayerId) const;
+	int32 PaintBlocks(const FGeometry& AllottedGeometry, FSlateWindowElementList& OutDrawElements, int32 LayerId) const;
+
+	TWeakPtr<MineSweeperBoard, ESPMode::ThreadSafe> Board;
+	FVector2D ViewSize; // Only what we ask the layout for, the zoom goes by the size we actually get
+	float TilePixels = 24.0f;
+	bool bNeedsFit = true; // Zoom out to the whole board once we know how big the view really is
+	FVector2D Origin = FVector2D::ZeroVector; // The tile position at the top left corner of the view, in tiles
+	int32 PressedTile = INDEX_NONE;
+	bool bPanning = false;
+	mutable int32 LastPaintElements = 0;
+};
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+/**
+* The reference generator for MineSweeperGeneratorABI.h, and a starting point for anyone writing their own.
+*
+* It's plain C99 with no dependencies, and isn't built by Unreal. On Linux:
+*     cc -O2 -shared -fPIC -I../../GameWindow/Public MineSweeperReferenceGenerator.c -o libMineSweeperReferenceGenerator.so
+* then point MineSweeper.Generator.Library at the .so.
+*
+* Mines are placed with Floyd's algorithm, which picks NumMines distinct tiles uniformly in exactly NumMines random
+* draws and uses the output bitset itself to remember what's taken, so it needs no scratch and no context. The random
+* numbers come from SplitMix64 seeded with the board's seed, so a seed gives the same board on every machine. They are
+* not the same boards RandomBoardGenerator makes for that seed.
+*/
+
+#include "MineSweeperGeneratorABI.h"
+
+#if defined(_WIN32)
+#define MINESWEEPER_EXPORT __declspec(dllexport)
+#else
+#define MINESWEEPER_EXPORT __attribute__((visibility("default")))
+#endif
+
+static uint64_t NextRandom(uint64_t* State)
+{
+	uint64_t Value = (*State += 0x9E3779B97F4A7C15ull);
+	Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+	return Value ^ (Value >> 31);
+}
+
+/** A uniform number in [0, Bound), by multiplying rather than dividing. Bound is never more than 2^31 here. */
+static uint32_t RandomBelow(uint64_t* State, uint32_t Bound)
+{
+	return (uint32_t)(((NextRandom(State) >> 32) * (uint64_t)Bound) >> 32);
+}
+
+static int32_t GenerateBatch(void* Context, const MineSweeperGeneratorRequest* Request, uint64_t* OutBits, uint64_t OutNumWords)
+{
+	(void)Context;
+	if (Request == NULL || Request->StructSize < sizeof(MineSweeperGeneratorRequest) || Request->Width <= 0 || Request->Height <= 0
+		|| Request->NumMines < 0 || (int64_t)Request->NumMines > (int64_t)Request->Width * Request->Height || Request->NumBoards < 0)
+	{
+		return MINESWEEPER_GENERATOR_ERROR_INVALID_REQUEST;
+	}
+	const uint64_t NumTiles = (uint64_t)Request->Width * (uint64_t)Request->Height;
+	if (NumTiles > 0x7FFFFFFFull || Request->WordsPerBoard < (NumTiles + 63) / 64)
+	{
+		return MINESWEEPER_GENERATOR_ERROR_INVALID_REQUEST;
+	}
+	if (OutBits == NULL || OutNumWords / Request->WordsPerBoard < (uint64_t)Request->NumBoards)
+	{
+		return MINESWEEPER_GENERATOR_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	for (int32_t BoardIndex = 0; BoardIndex < Request->NumBoards; BoardIndex++)
+	{
+		uint64_t* Board = OutBits + (uint64_t)BoardIndex * Request->WordsPerBoard;
+		for (uint64_t Word = 0; Word < Request->WordsPerBoard; Word++)
+		{
+			Board[Word] = 0;
+		}
+		uint64_t State = Request->FirstSeed + (uint64_t)BoardIndex;
+		for (uint32_t Last = (uint32_t)(NumTiles - (uint64_t)Request->NumMines); Last < (uint32_t)NumTiles; Last++)
+		{
+			// Pick from [0, Last]. If that's taken, Last itself can't be yet, and taking it keeps every set equally likely.
+			uint32_t Tile = RandomBelow(&State, Last + 1);
+			if ((Board[Tile >> 6] >> (Tile & 63)) & 1)
+			{
+				Tile = Last;
+			}
+			Board[Tile >> 6] |= 1ull << (Tile & 63);
+		}
+	}
+	return Request->NumBoards;
+}
+
+static const MineSweeperGeneratorApi ReferenceApi = {
+	sizeof(MineSweeperGeneratorApi),
+	MINESWEEPER_GENERATOR_ABI_VERSION,
+	"Reference (Floyd, SplitMix64)",
+	NULL,
+	NULL,
+	GenerateBatch,
+};
+
+MINESWEEPER_EXPORT const MineSweeperGeneratorApi* MineSweeperGetGeneratorApi(uint32_t HostAbiVersion)
+{
+	return HostAbiVersion == MINESWEEPER_GENERATOR_ABI_VERSION ? &ReferenceApi : NULL;
+}